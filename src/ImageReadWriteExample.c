@@ -11,7 +11,7 @@ void error(char *name);
 int main(int argc, char **argv) {
   FILE *fp;
   struct TIFF_img input_img, green_img, color_img;
-  double **img1, **img2;
+  double **img1, **img2, *noise;
   int32_t i, j, pixel;
 
   if (argc != 2) error(argv[0]);
@@ -62,11 +62,19 @@ int main(int argc, char **argv) {
   /* Set seed for random noise generator */
   srandom2(1);
 
-  /* Add noise to image */
-  for (i = 0; i < input_img.height; i++)
-    for (j = 1; j < input_img.width - 1; j++) {
-      img2[i][j] += 32 * normal();
+  /* Add noise to image, one row of variates at a time.  The legacy mode */
+  /* produces the same values as calling normal() once per pixel.        */
+  /* An image less than 3 pixels wide has no interior pixels.            */
+  noise = (double *)get_spc(input_img.width, sizeof(double));
+  if (input_img.width > 2) {
+    for (i = 0; i < input_img.height; i++) {
+      normal_fill(noise, input_img.width - 2, RAND_FILL_LEGACY);
+      for (j = 1; j < input_img.width - 1; j++) {
+        img2[i][j] += 32 * noise[j - 1];
+      }
     }
+  }
+  free(noise);
 
   /* set up structure for output achromatic image */
   /* to allocate a full color image use type 'c' */
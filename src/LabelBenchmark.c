@@ -0,0 +1,207 @@
+
+#ifdef __linux__
+#define _GNU_SOURCE /* syscall() */
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "neighborhood.h"
+#include "parlabel.h"
+#include "randlib.h"
+#include "seqlabel.h"
+#include "typeutil.h"
+
+/* Benchmarks the labeling engines on a synthetic image.
+ *
+ * The image is a mosaic of 24 x 24 cells with random gray levels plus a
+ * small amount of noise, which gives a large number of irregular regions
+ * at threshold 2.  The single-threaded DFS engine is compared with the
+ * tiled engine for several tile sizes; on Linux the last-level cache
+ * misses of every run are read with perf_event_open() when the kernel
+ * allows it.  Run with size 8192 to see the effect of an image that is
+ * much larger than the cache.  The parallel union-find engine is then
+ * timed from 1 thread up to the number of processors.  Every result is
+ * checked against the first one.
+ *
+ * The neighborhood is 4 by default; any argument accepted by
+ * ParseNeighborhood() may be given instead.
+ *
+ * usage: LabelBenchmark [size] [repeats] [max threads] [neighborhood] */
+
+static void MakeTestImage(unsigned char **img, int width, int height);
+static int CacheCounterOpen(void);
+static void CacheCounterStart(int fd);
+static long long CacheCounterStop(int fd);
+static int SameLabels(unsigned int **a, unsigned int **b, int width,
+                      int height);
+
+int main(int argc, char **argv) {
+  int size = (argc > 1) ? atoi(argv[1]) : 4096;
+  int repeats = (argc > 2) ? atoi(argv[2]) : 3;
+  int max_threads = (argc > 3) ? atoi(argv[3]) : omp_get_num_procs();
+  unsigned int nb = NB_4;
+  unsigned char **img;
+  unsigned int **ref, **seg, nlabels;
+  double threshold = 2.0, start, seconds, base = 0;
+  int threads, r, fd;
+  long long misses;
+  static const int tile_sizes[] = {0, 32, 64, 128, 256, 512};
+  char window[12];
+
+  if (argc > 4 && ParseNeighborhood(argv[4], &nb)) {
+    fprintf(stderr, "Error: bad neighborhood %s\n", argv[4]);
+    return (1);
+  }
+  FormatNeighborhood(nb, window);
+
+  img = (unsigned char **)get_img(size, size, sizeof(unsigned char));
+  ref = (unsigned int **)get_img(size, size, sizeof(unsigned int));
+  seg = (unsigned int **)get_img(size, size, sizeof(unsigned int));
+  MakeTestImage(img, size, size);
+
+  printf("%d x %d image, threshold %g, neighborhood %s, %d processors\n",
+         size, size, threshold, window, omp_get_num_procs());
+
+  omp_set_num_threads(1);
+  LabelDFS(img, size, size, threshold, nb, 100, ref, &nlabels);
+  printf("%u labels\n\n", nlabels);
+
+  // tile size 0 stands for the DFS engine
+  fd = CacheCounterOpen();
+  printf("single-threaded engines\n");
+  printf("%8s %6s %12s %14s %6s\n", "engine", "tile", "ms", "cache misses",
+         "check");
+  for (int t = 0; t < (int)(sizeof(tile_sizes) / sizeof(tile_sizes[0]));
+       t++) {
+    seconds = 1e30;
+    misses = -1;
+    for (r = 0; r < repeats; r++) {
+      long long m;
+      CacheCounterStart(fd);
+      start = omp_get_wtime();
+      if (tile_sizes[t] == 0) {
+        LabelDFS(img, size, size, threshold, nb, 100, seg, &nlabels);
+      } else {
+        LabelTiled(img, size, size, threshold, nb, 100, tile_sizes[t], seg,
+                   &nlabels);
+      }
+      if (omp_get_wtime() - start < seconds) seconds = omp_get_wtime() - start;
+      m = CacheCounterStop(fd);
+      if (misses < 0 || m < misses) misses = m;
+    }
+    if (tile_sizes[t] == 0) {
+      printf("%8s %6s %12.1f", "dfs", "-", 1e3 * seconds);
+    } else {
+      printf("%8s %6d %12.1f", "tiled", tile_sizes[t], 1e3 * seconds);
+    }
+    if (misses >= 0) {
+      printf(" %14lld", misses);
+    } else {
+      printf(" %14s", "n/a");
+    }
+    printf(" %6s\n", SameLabels(ref, seg, size, size) ? "ok" : "FAIL");
+  }
+#ifdef __linux__
+  if (fd >= 0) close(fd);
+#endif
+  printf("\n");
+
+  printf("parallel union-find engine\n");
+  printf("%8s %12s %8s %6s\n", "threads", "ms", "speedup", "check");
+  for (threads = 1; threads <= max_threads;
+       threads = (threads < max_threads && 2 * threads > max_threads)
+                     ? max_threads
+                     : 2 * threads) {
+    omp_set_num_threads(threads);
+    seconds = 1e30;
+    for (r = 0; r < repeats; r++) {
+      start = omp_get_wtime();
+      LabelParallel(img, size, size, threshold, nb, 100, seg, &nlabels);
+      if (omp_get_wtime() - start < seconds) seconds = omp_get_wtime() - start;
+    }
+    if (threads == 1) base = seconds;
+    printf("%8d %12.1f %8.2f %6s\n", threads, 1e3 * seconds, base / seconds,
+           SameLabels(ref, seg, size, size) ? "ok" : "FAIL");
+    if (threads == max_threads) break;
+  }
+
+  free_img((void **)img);
+  free_img((void **)ref);
+  free_img((void **)seg);
+  return (0);
+}
+
+static void MakeTestImage(unsigned char **img, int width, int height) {
+  int cw = 24, ncol = (width + cw - 1) / cw;
+  int nrow = (height + cw - 1) / cw;
+  double *level, *noise;
+  int i, j;
+
+  level = (double *)get_spc(ncol * nrow, sizeof(double));
+  noise = (double *)get_spc(width, sizeof(double));
+  srandom2(1);
+  random2_fill(level, ncol * nrow);
+  for (i = 0; i < height; i++) {
+    normal_fill(noise, width, RAND_FILL_FAST);
+    for (j = 0; j < width; j++) {
+      double v = 16 * floor(16 * level[(i / cw) * ncol + j / cw]) + noise[j];
+      img[i][j] = (v < 0) ? 0 : (v > 255) ? 255 : (unsigned char)v;
+    }
+  }
+  free(level);
+  free(noise);
+}
+
+static int SameLabels(unsigned int **a, unsigned int **b, int width,
+                      int height) {
+  for (int i = 0; i < height; i++)
+    for (int j = 0; j < width; j++)
+      if (a[i][j] != b[i][j]) return 0;
+  return 1;
+}
+
+/* Last-level cache misses of this process, or -1 where unavailable */
+#ifdef __linux__
+static int CacheCounterOpen(void) {
+  struct perf_event_attr pe;
+
+  memset(&pe, 0, sizeof(pe));
+  pe.type = PERF_TYPE_HARDWARE;
+  pe.size = sizeof(pe);
+  pe.config = PERF_COUNT_HW_CACHE_MISSES;
+  pe.disabled = 1;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  return (int)syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+}
+
+static void CacheCounterStart(int fd) {
+  if (fd < 0) return;
+  ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static long long CacheCounterStop(int fd) {
+  long long count;
+
+  if (fd < 0) return -1;
+  ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+  return count;
+}
+#else
+static int CacheCounterOpen(void) { return -1; }
+static void CacheCounterStart(int fd) { (void)fd; }
+static long long CacheCounterStop(int fd) {
+  (void)fd;
+  return -1;
+}
+#endif
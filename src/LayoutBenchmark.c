@@ -0,0 +1,112 @@
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "randlib.h"
+#include "typeutil.h"
+#include "zlayout.h"
+
+/* Times the conversion kernels of the tiled Z-order layout.
+ *
+ * The test image is the mosaic of LabelBenchmark; the 32-bit kernels
+ * convert a label image of the same size.  Each conversion is checked by
+ * converting back.  The kernels are what a caller that keeps its images
+ * row-major pays to use the layout.
+ *
+ * usage: LayoutBenchmark [size] [repeats] */
+
+static void MakeTestImage(unsigned char **img, int width, int height);
+
+int main(int argc, char **argv) {
+  int size = (argc > 1) ? atoi(argv[1]) : 4096;
+  int repeats = (argc > 2) ? atoi(argv[2]) : 3;
+  struct zlayout zl;
+  unsigned char **img, **back;
+  unsigned int **seg, **seg_back;
+  uint8_t *zimg;
+  uint32_t *zseg;
+  double start, t_from, t_to;
+  size_t npix = (size_t)size * size;
+  int r, ok;
+
+  omp_set_num_threads(1);
+  zl_init(&zl, size, size);
+  img = (unsigned char **)get_img(size, size, sizeof(unsigned char));
+  back = (unsigned char **)get_img(size, size, sizeof(unsigned char));
+  seg = (unsigned int **)get_img(size, size, sizeof(unsigned int));
+  seg_back = (unsigned int **)get_img(size, size, sizeof(unsigned int));
+  zimg = (uint8_t *)get_spc(zl.size, sizeof(uint8_t));
+  zseg = (uint32_t *)get_spc(zl.size, sizeof(uint32_t));
+  MakeTestImage(img, size, size);
+  for (size_t i = 0; i < npix; i++) seg[0][i] = (unsigned int)(i / 97);
+
+#ifdef __BMI2__
+  printf("%d x %d image, %d x %d tiles, BMI2 pdep/pext\n\n", size, size,
+         ZL_TILE, ZL_TILE);
+#else
+  printf("%d x %d image, %d x %d tiles, portable Morton codes\n\n", size,
+         size, ZL_TILE, ZL_TILE);
+#endif
+
+  printf("%-28s %10s %10s %6s\n", "conversion", "ms", "MB/s", "check");
+  t_from = t_to = 1e30;
+  for (r = 0; r < repeats; r++) {
+    start = omp_get_wtime();
+    zl_from_rows_u8(&zl, img, zimg);
+    if (omp_get_wtime() - start < t_from) t_from = omp_get_wtime() - start;
+    start = omp_get_wtime();
+    zl_to_rows_u8(&zl, zimg, back);
+    if (omp_get_wtime() - start < t_to) t_to = omp_get_wtime() - start;
+  }
+  ok = (memcmp(img[0], back[0], npix) == 0);
+  printf("%-28s %10.1f %10.0f %6s\n", "8-bit row-major to z", 1e3 * t_from,
+         (double)npix / t_from / 1e6, ok ? "ok" : "FAIL");
+  printf("%-28s %10.1f %10.0f %6s\n", "8-bit z to row-major", 1e3 * t_to,
+         (double)npix / t_to / 1e6, ok ? "ok" : "FAIL");
+
+  t_from = t_to = 1e30;
+  for (r = 0; r < repeats; r++) {
+    start = omp_get_wtime();
+    zl_from_rows_u32(&zl, seg, zseg);
+    if (omp_get_wtime() - start < t_from) t_from = omp_get_wtime() - start;
+    start = omp_get_wtime();
+    zl_to_rows_u32(&zl, zseg, seg_back);
+    if (omp_get_wtime() - start < t_to) t_to = omp_get_wtime() - start;
+  }
+  ok = (memcmp(seg[0], seg_back[0], npix * sizeof(unsigned int)) == 0);
+  printf("%-28s %10.1f %10.0f %6s\n", "32-bit row-major to z",
+         1e3 * t_from, 4.0 * npix / t_from / 1e6, ok ? "ok" : "FAIL");
+  printf("%-28s %10.1f %10.0f %6s\n", "32-bit z to row-major", 1e3 * t_to,
+         4.0 * npix / t_to / 1e6, ok ? "ok" : "FAIL");
+
+  free_img((void **)img);
+  free_img((void **)back);
+  free_img((void **)seg);
+  free_img((void **)seg_back);
+  free(zimg);
+  free(zseg);
+  return (0);
+}
+
+static void MakeTestImage(unsigned char **img, int width, int height) {
+  int cw = 24, ncol = (width + cw - 1) / cw;
+  int nrow = (height + cw - 1) / cw;
+  double *level, *noise;
+  int i, j;
+
+  level = (double *)get_spc(ncol * nrow, sizeof(double));
+  noise = (double *)get_spc(width, sizeof(double));
+  srandom2(1);
+  random2_fill(level, ncol * nrow);
+  for (i = 0; i < height; i++) {
+    normal_fill(noise, width, RAND_FILL_FAST);
+    for (j = 0; j < width; j++) {
+      double v = 16 * floor(16 * level[(i / cw) * ncol + j / cw]) + noise[j];
+      img[i][j] = (v < 0) ? 0 : (v > 255) ? 255 : (unsigned char)v;
+    }
+  }
+  free(level);
+  free(noise);
+}
@@ -0,0 +1,106 @@
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+
+#include "allocate.h"
+#include "qGGMRF.h"
+#include "randlib.h"
+#include "typeutil.h"
+
+/* Times the table-driven qGGMRF evaluator against get_rho() and
+ * get_btilde(), which call pow() for every difference.
+ *
+ * The differences are normal with a standard deviation of sigma_x, as
+ * between the neighbors of a noisy image, with one in eight scaled up
+ * by 100 as at the edges.  Every evaluation is compared with the pow()
+ * path and the largest relative error is printed with the times.
+ *
+ * usage: PriorBenchmark [n] [repeats] */
+
+static double MaxRelErr(const double *a, const double *b, int n);
+
+int main(int argc, char **argv) {
+  int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+  int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+  /* p, q of the potentials; b, sigma_x and T are the defaults of the */
+  /* MAP denoiser, with b the weight of one of its four neighbors       */
+  double shape[][2] = {{1.2, 2.0}, {1.0, 2.0}, {1.1, 1.5}};
+  int nshape = sizeof(shape) / sizeof(shape[0]);
+  double b = 0.25, sigma_x = 10.0, T = 1.0;
+  struct qggmrf_table t;
+  double *delta, *exact, *fast, start, t_pow, t_tab;
+  int i, k, r;
+
+  omp_set_num_threads(1);
+  delta = (double *)get_spc(n, sizeof(double));
+  exact = (double *)get_spc(n, sizeof(double));
+  fast = (double *)get_spc(n, sizeof(double));
+  srandom2(1);
+  normal_fill(delta, n, RAND_FILL_FAST);
+  for (i = 0; i < n; i++) {
+    delta[i] *= (i % 8 == 0) ? 100 * sigma_x : sigma_x;
+  }
+
+  printf("%d differences, best of %d runs\n\n", n, repeats);
+  printf("%-8s %-8s %10s %10s %8s %10s\n", "p, q", "function", "pow ns",
+         "table ns", "speedup", "rel err");
+  for (k = 0; k < nshape; k++) {
+    double p = shape[k][0], q = shape[k][1];
+    char name[16];
+
+    if (qggmrf_table_init(&t, b, sigma_x, p, q, T)) {
+      fprintf(stderr, "error building the table for p = %g, q = %g\n", p, q);
+      exit(1);
+    }
+    snprintf(name, sizeof(name), "%.1f, %.1f", p, q);
+
+    t_pow = t_tab = 1e30;
+    for (r = 0; r < repeats; r++) {
+      start = omp_get_wtime();
+      for (i = 0; i < n; i++) {
+        exact[i] = get_rho(delta[i], b, sigma_x, p, q, T);
+      }
+      if (omp_get_wtime() - start < t_pow) t_pow = omp_get_wtime() - start;
+      start = omp_get_wtime();
+      qggmrf_rho_array(&t, delta, fast, n);
+      if (omp_get_wtime() - start < t_tab) t_tab = omp_get_wtime() - start;
+    }
+    printf("%-8s %-8s %10.1f %10.1f %7.1fx %10.1e\n", name, "rho",
+           1e9 * t_pow / n, 1e9 * t_tab / n, t_pow / t_tab,
+           MaxRelErr(exact, fast, n));
+
+    t_pow = t_tab = 1e30;
+    for (r = 0; r < repeats; r++) {
+      start = omp_get_wtime();
+      for (i = 0; i < n; i++) {
+        exact[i] = get_btilde(delta[i], b, sigma_x, p, q, T);
+      }
+      if (omp_get_wtime() - start < t_pow) t_pow = omp_get_wtime() - start;
+      start = omp_get_wtime();
+      qggmrf_btilde_array(&t, delta, fast, n);
+      if (omp_get_wtime() - start < t_tab) t_tab = omp_get_wtime() - start;
+    }
+    printf("%-8s %-8s %10.1f %10.1f %7.1fx %10.1e\n", name, "btilde",
+           1e9 * t_pow / n, 1e9 * t_tab / n, t_pow / t_tab,
+           MaxRelErr(exact, fast, n));
+
+    qggmrf_table_free(&t);
+  }
+
+  free(delta);
+  free(exact);
+  free(fast);
+  return (0);
+}
+
+static double MaxRelErr(const double *a, const double *b, int n) {
+  double err = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (a[i] != 0 && fabs(b[i] - a[i]) / fabs(a[i]) > err) {
+      err = fabs(b[i] - a[i]) / fabs(a[i]);
+    }
+  }
+  return (err);
+}
@@ -0,0 +1,169 @@
+
+#include "allocate.h"
+#include "labelfile.h"
+#include "neighborhood.h"
+#include "pixelindex.h"
+#include "rtree.h"
+#include "seqlabel.h"
+#include "tiff.h"
+#include "typeutil.h"
+
+void error(char *name);
+
+int main(int argc, char **argv) {
+  FILE *fp;
+  struct TIFF_img input_img;
+  struct pixel_index pi, mpi;
+  struct region_stats *stats;
+  struct label_file lf;
+  struct region_box box;
+  struct rtree t, mt;
+  unsigned int **seg, nlabels;
+  uint32_t hits[16], nearest[3], n, k;
+  double dist[3];
+  double threshold;
+  int32_t x, y;
+  uint32_t label;
+
+  if (argc != 3) error(argv[0]);
+  threshold = atof(argv[2]);
+
+  /* open image file */
+  if ((fp = fopen(argv[1], "rb")) == NULL) {
+    fprintf(stderr, "cannot open file %s\n", argv[1]);
+    exit(1);
+  }
+
+  /* read image */
+  if (read_TIFF(fp, &input_img)) {
+    fprintf(stderr, "error reading file %s\n", argv[1]);
+    exit(1);
+  }
+
+  /* close image file */
+  fclose(fp);
+
+  /* check the type of image data */
+  if (input_img.TIFF_type != 'g') {
+    fprintf(stderr, "error:  image must be 8-bit grayscale\n");
+    exit(1);
+  }
+
+  /* label the image, keeping every region */
+  seg = (unsigned int **)get_img(input_img.width, input_img.height,
+                                 sizeof(unsigned int));
+  LabelDFS(input_img.mono, input_img.width, input_img.height, threshold,
+           NB_4, 0, seg, &nlabels);
+  printf("%u regions\n", nlabels);
+
+  /* the region queried below is the one under the center pixel */
+  x = input_img.width / 2;
+  y = input_img.height / 2;
+  label = seg[y][x];
+
+  /* write the pixel index */
+  if (BuildPixelIndex(seg, input_img.width, input_img.height, nlabels, &pi)) {
+    fprintf(stderr, "error building the pixel index\n");
+    exit(1);
+  }
+  if ((fp = fopen("regions.pix", "wb")) == NULL) {
+    fprintf(stderr, "cannot open file regions.pix\n");
+    exit(1);
+  }
+  if (WritePixelIndex(fp, &pi)) {
+    fprintf(stderr, "error writing file regions.pix\n");
+    exit(1);
+  }
+  fclose(fp);
+
+  /* write the label file, with a run-length coded raster */
+  stats = (struct region_stats *)get_spc(nlabels + 1,
+                                         sizeof(struct region_stats));
+  RegionStats(input_img.mono, seg, input_img.width, input_img.height,
+              nlabels, stats);
+  if ((fp = fopen("regions.lbl", "wb")) == NULL) {
+    fprintf(stderr, "cannot open file regions.lbl\n");
+    exit(1);
+  }
+  if (WriteLabelFile(fp, seg, input_img.width, input_img.height, nlabels,
+                     stats, &pi, 1)) {
+    fprintf(stderr, "error writing file regions.lbl\n");
+    exit(1);
+  }
+  fclose(fp);
+  free(stats);
+  FreePixelIndex(&pi);
+
+  /* map the index back; it is checked, then used in place */
+  if (MapPixelIndex("regions.pix", &mpi)) {
+    fprintf(stderr, "error mapping file regions.pix\n");
+    exit(1);
+  }
+  RegionBox(&mpi, label, &box);
+  printf("pixel index: region %u at (%d, %d) has %u pixels in a %d x %d "
+         "box at (%d, %d)\n",
+         label, x, y, region_size(&mpi, label), box.width, box.height,
+         box.x0, box.y0);
+  FreePixelIndex(&mpi);
+
+  /* open the label file, checking every section */
+  if (OpenLabelFile("regions.lbl", 1, &lf)) {
+    fprintf(stderr, "error opening file regions.lbl\n");
+    exit(1);
+  }
+  label = LabelFileAt(&lf, x, y);
+  printf("label file: region %u at (%d, %d) has %u pixels of mean %.1f "
+         "in [%.0f, %.0f]\n",
+         label, x, y, lf.stats[label].size, lf.stats[label].mean,
+         lf.stats[label].min, lf.stats[label].max);
+
+  /* write the R-tree of the region boxes kept in the label file */
+  if (BuildRTree(lf.boxes, lf.stats, lf.nlabels, &t)) {
+    fprintf(stderr, "error building the R-tree\n");
+    exit(1);
+  }
+  CloseLabelFile(&lf);
+  if ((fp = fopen("regions.rtree", "wb")) == NULL) {
+    fprintf(stderr, "cannot open file regions.rtree\n");
+    exit(1);
+  }
+  if (WriteRTree(fp, &t)) {
+    fprintf(stderr, "error writing file regions.rtree\n");
+    exit(1);
+  }
+  fclose(fp);
+  FreeRTree(&t);
+
+  /* map it back and ask which boxes hold the center pixel, and which */
+  /* regions have the nearest centroids                               */
+  if (MapRTree("regions.rtree", &mt)) {
+    fprintf(stderr, "error mapping file regions.rtree\n");
+    exit(1);
+  }
+  n = RTreeQueryPoint(&mt, x, y, hits, 16);
+  printf("R-tree: %u region boxes hold (%d, %d)", n, x, y);
+  for (k = 0; k < n && k < 16; k++) printf(" %u", hits[k]);
+  printf("\n");
+  n = RTreeNearest(&mt, x, y, 3, nearest, dist);
+  printf("R-tree: nearest centroids");
+  for (k = 0; k < n; k++) printf(" %u (%.1f)", nearest[k], dist[k]);
+  printf("\n");
+  FreeRTree(&mt);
+
+  /* de-allocate space which was used for the images */
+  free_TIFF(&(input_img));
+  free_img((void **)seg);
+
+  return (0);
+}
+
+void error(char *name) {
+  printf("usage:  %s  image.tiff threshold\n\n", name);
+  printf("this program labels an 8-bit grayscale TIFF image\n");
+  printf("at the given threshold, writes the pixel index of the\n");
+  printf("regions to 'regions.pix', a label file to 'regions.lbl'\n");
+  printf("and an R-tree of the regions to 'regions.rtree', maps the\n");
+  printf("files back and prints what each knows about the region\n");
+  printf("under the center pixel and its neighbors.\n");
+  exit(1);
+}
@@ -0,0 +1,182 @@
+
+#include <math.h>
+#include <omp.h>
+#include <time.h>
+
+#include "allocate.h"
+#include "randlib.h"
+#include "solve.h"
+#include "typeutil.h"
+
+/* Compares the number of function evaluations and the run time of the
+ * bisection, Brent and Illinois solvers on SolveExample.c-style problems.
+ *
+ * Note that the cubic of SolveExample.c has a triple root, where f' = 0
+ * and the interpolating methods converge only linearly; bisection is the
+ * better choice there.  On simple roots Brent needs a fraction of the
+ * evaluations of bisection.
+ *
+ * EXAMPLE */
+
+typedef struct {
+  double theta1, theta2;
+} Parameters;
+
+typedef struct {
+  const char *name;
+  double (*f)(double x, void *pblock);
+} TestFunction;
+
+typedef double (*Solver)(double (*f)(double x, void *pblock), void *pblock,
+                         double a, double b, double err, int *code,
+                         struct solve_stats *stats);
+
+static double Cubic(double x, void *pblock);
+static double Polynomial(double x, void *pblock);
+static double Exponential(double x, void *pblock);
+static double Arctangent(double x, void *pblock);
+static void PolynomialBatch(const double *x, double *fx, const int *idx,
+                            int K, void *pblock);
+static void BenchmarkBatch(int n, double min_solution, double max_solution,
+                           double epsilon);
+
+int main(int argc, char **argv) {
+  TestFunction tests[] = {{"theta2 * (x - theta1)^3", Cubic},
+                          {"x^3 - theta2 * x - theta1", Polynomial},
+                          {"exp(x / 100) - theta1", Exponential},
+                          {"atan(x - theta1) + x / theta2", Arctangent}};
+  Solver solvers[] = {solve_bisection, solve_brent, solve_illinois};
+  const char *solver_names[] = {"bisection", "brent", "illinois"};
+  int ntests = sizeof(tests) / sizeof(tests[0]);
+  int nsolvers = sizeof(solvers) / sizeof(solvers[0]);
+  int repeats = 100000;
+  Parameters p;
+  struct solve_stats stats;
+  int i, j, r, error_code;
+  double root, min_solution, max_solution, epsilon, seconds;
+  clock_t start;
+
+  p.theta1 = 10.0;
+  p.theta2 = 3.0;
+  min_solution = -1e3;
+  max_solution = 1e3;
+  epsilon = 1e-10;
+
+  printf("Lower bound = %g; upper bound = %g; precision = %g; \n",
+         min_solution, max_solution, epsilon);
+  printf("%-32s %-10s %18s %5s %6s %12s\n", "function", "solver", "root",
+         "code", "evals", "ns/solve");
+
+  for (i = 0; i < ntests; i++) {
+    for (j = 0; j < nsolvers; j++) {
+      root = solvers[j](tests[i].f, &p, min_solution, max_solution, epsilon,
+                        &error_code, &stats);
+
+      start = clock();
+      for (r = 0; r < repeats; r++) {
+        solvers[j](tests[i].f, &p, min_solution, max_solution, epsilon,
+                   &error_code, NULL);
+      }
+      seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+      printf("%-32s %-10s %18.10f %5d %6ld %12.1f\n", tests[i].name,
+             solver_names[j], root, error_code, stats.evaluations,
+             1e9 * seconds / repeats);
+    }
+  }
+
+  BenchmarkBatch(200000, min_solution, max_solution, epsilon);
+
+  return (0);
+}
+
+/* Solves n equations x^3 - 3 * x - theta1[i] = 0, one scalar solve at a
+ * time and with solve_batch(). */
+static void BenchmarkBatch(int n, double min_solution, double max_solution,
+                           double epsilon) {
+  double *a, *b, *root, *theta1, start, seconds;
+  int *code, i, nfail;
+  Parameters p;
+  struct solve_stats stats;
+  long evaluations = 0;
+
+  a = (double *)get_spc(n, sizeof(double));
+  b = (double *)get_spc(n, sizeof(double));
+  root = (double *)get_spc(n, sizeof(double));
+  theta1 = (double *)get_spc(n, sizeof(double));
+  code = (int *)get_spc(n, sizeof(int));
+
+  srandom2(1);
+  random2_fill(theta1, n);
+  for (i = 0; i < n; i++) {
+    theta1[i] = 100 * theta1[i];
+    a[i] = min_solution;
+    b[i] = max_solution;
+  }
+
+  printf("\n%d independent problems, %d threads\n", n, omp_get_max_threads());
+  printf("%-32s %10s %12s\n", "solver", "evals", "ns/problem");
+
+  p.theta2 = 3.0;
+  start = omp_get_wtime();
+  for (i = 0; i < n; i++) {
+    p.theta1 = theta1[i];
+    root[i] = solve_brent(Polynomial, &p, a[i], b[i], epsilon, &code[i],
+                          &stats);
+    evaluations += stats.evaluations;
+  }
+  seconds = omp_get_wtime() - start;
+  printf("%-32s %10ld %12.1f\n", "solve_brent, one at a time", evaluations,
+         1e9 * seconds / n);
+
+  start = omp_get_wtime();
+  nfail = solve_batch(PolynomialBatch, theta1, a, b, n, epsilon,
+                      SOLVE_BISECTION, root, code, &stats);
+  seconds = omp_get_wtime() - start;
+  printf("%-32s %10ld %12.1f  (%d failed)\n", "solve_batch, bisection",
+         stats.evaluations, 1e9 * seconds / n, nfail);
+
+  start = omp_get_wtime();
+  nfail = solve_batch(PolynomialBatch, theta1, a, b, n, epsilon, SOLVE_BRENT,
+                      root, code, &stats);
+  seconds = omp_get_wtime() - start;
+  printf("%-32s %10ld %12.1f  (%d failed)\n", "solve_batch, brent",
+         stats.evaluations, 1e9 * seconds / n, nfail);
+
+  free(a);
+  free(b);
+  free(root);
+  free(theta1);
+  free(code);
+}
+
+/* Batched form of Polynomial with theta2 = 3; pblock points to theta1[] */
+static void PolynomialBatch(const double *x, double *fx, const int *idx,
+                            int K, void *pblock) {
+  const double *theta1 = (const double *)pblock;
+  int k;
+
+  for (k = 0; k < K; k++) {
+    fx[k] = x[k] * x[k] * x[k] - 3.0 * x[k] - theta1[idx[k]];
+  }
+}
+
+static double Cubic(double x, void *pblock) {
+  Parameters *p = (Parameters *)pblock;
+  return (pow(x - p->theta1, 3) * (p->theta2));
+}
+
+static double Polynomial(double x, void *pblock) {
+  Parameters *p = (Parameters *)pblock;
+  return (x * x * x - p->theta2 * x - p->theta1);
+}
+
+static double Exponential(double x, void *pblock) {
+  Parameters *p = (Parameters *)pblock;
+  return (exp(x / 100) - p->theta1);
+}
+
+static double Arctangent(double x, void *pblock) {
+  Parameters *p = (Parameters *)pblock;
+  return (atan(x - p->theta1) + x / p->theta2);
+}
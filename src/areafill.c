@@ -0,0 +1,305 @@
+#include "areafill.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "unionfind.h"
+
+void index_stack_grow(struct index_stack *st) {
+  st->cap = st->cap ? 2 * st->cap : 1024;
+  st->v = (uint32_t *)realloc(st->v, st->cap * sizeof(uint32_t));
+  if (st->v == NULL) {
+    fprintf(stderr, "index_stack_grow(): realloc() error\n");
+    exit(-1);
+  }
+}
+
+/**
+ * @brief Fills the region of one seed, claiming pixels for task t
+ *
+ * Every pixel is claimed with a compare-and-swap on owner[], so fills of
+ * different seeds can run concurrently.  A fill stops at pixels claimed
+ * by another task and records that the two tasks are in the same region
+ * by merging them in the task union-find.
+ */
+static void FillTask(unsigned char **img, int width, int height, double T,
+                     uint32_t *owner, uint32_t *task_parent, uint32_t t,
+                     uint32_t start, struct index_stack *st) {
+  uint32_t expected = 0, o;
+
+  if (!__atomic_compare_exchange_n(&owner[start], &expected, t, 0,
+                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    uf_union_atomic(task_parent, t, expected); /* already filled */
+    return;
+  }
+
+  st->n = 0;
+  index_stack_push(st, start);
+  while (st->n > 0) {
+    uint32_t s = st->v[--st->n];
+    int row = s / width, col = s % width;
+    int v = img[row][col];
+    uint32_t nb[4];
+    int m = 0;
+
+    if (row > 0 && abs(v - img[row - 1][col]) <= T) nb[m++] = s - width;
+    if (row < height - 1 && abs(v - img[row + 1][col]) <= T)
+      nb[m++] = s + width;
+    if (col > 0 && abs(v - img[row][col - 1]) <= T) nb[m++] = s - 1;
+    if (col < width - 1 && abs(v - img[row][col + 1]) <= T) nb[m++] = s + 1;
+
+    for (int k = 0; k < m; k++) {
+      o = __atomic_load_n(&owner[nb[k]], __ATOMIC_RELAXED);
+      if (o == 0) {
+        if (__atomic_compare_exchange_n(&owner[nb[k]], &o, t, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          index_stack_push(st, nb[k]);
+          continue;
+        }
+      }
+      if (o != t) uf_union_atomic(task_parent, t, o);
+    }
+  }
+}
+
+int MultiSeedAreaFill(unsigned char **img, int width, int height,
+                      double threshold, const pixel_t *seeds, int nseeds,
+                      struct seed_fill *fill) {
+  size_t npix = (size_t)width * height;
+  uint32_t *owner, *task_parent, *region_of_task;
+  int k;
+
+  fill->width = width;
+  fill->height = height;
+  fill->nseeds = nseeds;
+  fill->seed_region =
+      (unsigned int *)get_spc(nseeds > 0 ? nseeds : 1, sizeof(unsigned int));
+  fill->label = (unsigned int **)get_img(width, height, sizeof(unsigned int));
+  owner = (uint32_t *)fill->label[0];
+  memset(owner, 0, npix * sizeof(uint32_t));
+
+  // task t = k + 1 fills seed k; task 0 is unused
+  task_parent = (uint32_t *)mget_spc(nseeds + 1, sizeof(uint32_t));
+  region_of_task = (uint32_t *)get_spc(nseeds + 1, sizeof(uint32_t));
+  for (k = 0; k <= nseeds; k++) task_parent[k] = k;
+
+#pragma omp parallel
+  {
+    struct index_stack st = {NULL, 0, 0};
+
+#pragma omp for schedule(dynamic)
+    for (k = 0; k < nseeds; k++) {
+      if (seeds[k].row < 0 || seeds[k].row >= height || seeds[k].col < 0 ||
+          seeds[k].col >= width) {
+        continue;
+      }
+      FillTask(img, width, height, threshold, owner, task_parent, k + 1,
+               (uint32_t)seeds[k].row * width + seeds[k].col, &st);
+    }
+    free(st.v);
+  }
+
+  // number the regions in order of their first seed
+  fill->nregions = 0;
+  for (k = 0; k < nseeds; k++) {
+    if (seeds[k].row < 0 || seeds[k].row >= height || seeds[k].col < 0 ||
+        seeds[k].col >= width) {
+      fprintf(stderr, "Warning: seed %d (%d, %d) is outside the image\n", k,
+              seeds[k].col, seeds[k].row);
+      fill->seed_region[k] = 0;
+      continue;
+    }
+    uint32_t r = uf_find(task_parent, k + 1);
+    if (region_of_task[r] == 0) region_of_task[r] = ++fill->nregions;
+    fill->seed_region[k] = region_of_task[r];
+  }
+  for (k = 1; k <= nseeds; k++) {
+    region_of_task[k] = region_of_task[uf_find(task_parent, k)];
+  }
+
+  // replace task ids by region ids and count the region sizes
+  fill->region_size = (unsigned int *)get_spc(
+      fill->nregions > 0 ? fill->nregions : 1, sizeof(unsigned int));
+  {
+    long i;
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < (long)npix; i++) {
+      owner[i] = region_of_task[owner[i]];
+    }
+  }
+  for (size_t i = 0; i < npix; i++) {
+    if (owner[i]) fill->region_size[owner[i] - 1]++;
+  }
+
+  free(task_parent);
+  free(region_of_task);
+  return 0;
+}
+
+void free_seed_fill(struct seed_fill *fill) {
+  free(fill->seed_region);
+  free(fill->region_size);
+  free_img((void **)fill->label);
+}
+
+int ReadSeedFile(const char *path, pixel_t **seeds) {
+  FILE *fp;
+  char line[256];
+  int n = 0, cap = 64, col, row;
+
+  if ((fp = fopen(path, "r")) == NULL) {
+    fprintf(stderr, "Error: failed to open seed file %s\n", path);
+    return -1;
+  }
+
+  *seeds = (pixel_t *)mget_spc(cap, sizeof(pixel_t));
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (sscanf(line, "%d %d", &col, &row) != 2) {
+      fprintf(stderr, "Error: bad line in seed file %s: %s", path, line);
+      fclose(fp);
+      free(*seeds);
+      return -1;
+    }
+    if (n == cap) {
+      cap *= 2;
+      *seeds = (pixel_t *)realloc(*seeds, cap * sizeof(pixel_t));
+      if (*seeds == NULL) {
+        fprintf(stderr, "ReadSeedFile(): realloc() error\n");
+        exit(-1);
+      }
+    }
+    (*seeds)[n].col = col;
+    (*seeds)[n].row = row;
+    n++;
+  }
+
+  fclose(fp);
+  return n;
+}
+
+int WriteSeedMasksRLE(FILE *fp, const struct seed_fill *fill,
+                      const pixel_t *seeds) {
+  struct index_stack *runs; /* (row, col, length) triples per region */
+  int r, k;
+
+  // collect the runs of every region in one raster scan
+  runs = (struct index_stack *)get_spc(fill->nregions + 1,
+                                       sizeof(struct index_stack));
+  for (int i = 0; i < fill->height; i++) {
+    int j = 0;
+    while (j < fill->width) {
+      unsigned int id = fill->label[i][j];
+      int start = j;
+      while (j < fill->width && fill->label[i][j] == id) j++;
+      if (id) {
+        index_stack_push(&runs[id], i);
+        index_stack_push(&runs[id], start);
+        index_stack_push(&runs[id], j - start);
+      }
+    }
+  }
+
+  for (k = 0; k < fill->nseeds; k++) {
+    r = fill->seed_region[k];
+    fprintf(fp, "seed %d %d %d %d %u %lu\n", k, seeds[k].col, seeds[k].row, r,
+            r ? fill->region_size[r - 1] : 0,
+            (unsigned long)(runs[r].n / 3));
+    if (r == 0) continue;
+    for (size_t i = 0; i < runs[r].n; i += 3) {
+      fprintf(fp, "%u %u %u\n", runs[r].v[i], runs[r].v[i + 1],
+              runs[r].v[i + 2]);
+    }
+  }
+
+  for (r = 0; r <= fill->nregions; r++) free(runs[r].v);
+  free(runs);
+  return ferror(fp) ? 1 : 0;
+}
+
+int ProgressiveFillInit(struct progressive_fill *pf, unsigned char **img,
+                        int width, int height, pixel_t seed) {
+  memset(pf, 0, sizeof(*pf));
+  if (seed.row < 0 || seed.row >= height || seed.col < 0 ||
+      seed.col >= width) {
+    fprintf(stderr, "Error: seed (%d, %d) is outside the image\n", seed.col,
+            seed.row);
+    return 1;
+  }
+  pf->img = img;
+  pf->width = width;
+  pf->height = height;
+  pf->threshold = -1;
+  pf->mask = (uint8_t *)get_spc((size_t)width * height, sizeof(uint8_t));
+
+  // the seed is in the region at every threshold
+  uint32_t s = (uint32_t)seed.row * width + seed.col;
+  pf->mask[s] = 1;
+  pf->npixels = 1;
+  index_stack_push(&pf->todo, s);
+  return 0;
+}
+
+unsigned int ProgressiveFillGrow(struct progressive_fill *pf,
+                                 double threshold) {
+  int width = pf->width, height = pf->height;
+  unsigned char **img = pf->img;
+  int d, limit;
+
+  if (threshold < pf->threshold) {
+    fprintf(stderr, "Warning: threshold %g is below the previous one %g\n",
+            threshold, pf->threshold);
+  }
+  pf->threshold = threshold;
+
+  // release the rejected edges that the new threshold accepts
+  limit = (threshold >= FILL_BUCKETS - 1) ? FILL_BUCKETS - 1
+                                          : (int)floor(threshold);
+  for (d = 0; d <= limit; d++) {
+    struct index_stack *b = &pf->bucket[d];
+    while (b->n > 0) {
+      uint32_t t = b->v[--b->n];
+      if (!pf->mask[t]) {
+        pf->mask[t] = 1;
+        pf->npixels++;
+        index_stack_push(&pf->todo, t);
+      }
+    }
+  }
+
+  // continue the fill; edges above the threshold go into their bucket
+  while (pf->todo.n > 0) {
+    uint32_t s = pf->todo.v[--pf->todo.n];
+    int row = s / width, col = s % width;
+    int v = img[row][col];
+    uint32_t nb[4];
+    int m = 0;
+
+    if (row > 0) nb[m++] = s - width;
+    if (row < height - 1) nb[m++] = s + width;
+    if (col > 0) nb[m++] = s - 1;
+    if (col < width - 1) nb[m++] = s + 1;
+
+    for (int k = 0; k < m; k++) {
+      if (pf->mask[nb[k]]) continue;
+      d = abs(v - img[nb[k] / width][nb[k] % width]);
+      if (d <= threshold) {
+        pf->mask[nb[k]] = 1;
+        pf->npixels++;
+        index_stack_push(&pf->todo, nb[k]);
+      } else {
+        index_stack_push(&pf->bucket[d], nb[k]);
+      }
+    }
+  }
+
+  return pf->npixels;
+}
+
+void ProgressiveFillFree(struct progressive_fill *pf) {
+  free(pf->mask);
+  free(pf->todo.v);
+  for (int d = 0; d < FILL_BUCKETS; d++) free(pf->bucket[d].v);
+}
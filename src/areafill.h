@@ -0,0 +1,85 @@
+#ifndef _AREAFILL_H_
+#define _AREAFILL_H_
+
+#include <stdio.h>
+
+#include "typeutil.h"
+
+typedef struct pixel {
+  int row, col;
+} pixel_t;
+
+/* Growable stack of pixel indices (row * width + col) */
+struct index_stack {
+  uint32_t *v;
+  size_t n, cap;
+};
+
+/* Doubles the room of st; exits if there is no memory */
+void index_stack_grow(struct index_stack *st);
+
+static inline void index_stack_push(struct index_stack *st, uint32_t i) {
+  if (st->n == st->cap) index_stack_grow(st);
+  st->v[st->n++] = i;
+}
+
+/* Result of a multi-seed area fill.  Seeds lying in the same connected
+ * region share one region id; ids are numbered 1, 2, ... in order of the
+ * first seed of each region, and 0 marks pixels outside every region and
+ * seeds outside the image. */
+struct seed_fill {
+  int width, height;
+  int nseeds;
+  unsigned int *seed_region; /* region id of every seed                */
+  int nregions;
+  unsigned int *region_size; /* pixels per region, indexed by id - 1   */
+  unsigned int **label;      /* height x width region id image         */
+};
+
+/* Fills the threshold-connected region of every seed with one shared
+ * traversal.  Returns 0 on success; free the result with
+ * free_seed_fill(). */
+int MultiSeedAreaFill(unsigned char **img, int width, int height,
+                      double threshold, const pixel_t *seeds, int nseeds,
+                      struct seed_fill *fill);
+void free_seed_fill(struct seed_fill *fill);
+
+/* Reads seeds from a text file with one "col row" pair per line; lines
+ * starting with '#' are comments.  Returns the number of seeds, or -1 on
+ * error; *seeds must be freed by the caller. */
+int ReadSeedFile(const char *path, pixel_t **seeds);
+
+/* Writes the mask of every seed as row runs:
+ *   seed <index> <col> <row> <region> <pixels> <runs>
+ *   <row> <first col> <length>      (one line per run)  */
+int WriteSeedMasksRLE(FILE *fp, const struct seed_fill *fill,
+                      const pixel_t *seeds);
+
+/* Progressive area fill of one seed over an ascending sequence of
+ * thresholds.  The region at threshold T1 is contained in the region at
+ * T2 > T1, so instead of refilling from the seed, every rejected boundary
+ * edge is kept in a bucket indexed by its |delta|.  Raising the threshold
+ * releases the buckets up to the new threshold and continues the fill only
+ * from those edges, so a whole sequence costs about one fill. */
+
+#define FILL_BUCKETS 256 /* one bucket per |delta| of 8-bit pixels */
+
+struct progressive_fill {
+  unsigned char **img;
+  int width, height;
+  double threshold;        /* threshold of the current region      */
+  unsigned int npixels;    /* number of pixels in the region       */
+  uint8_t *mask;           /* 1 for pixels in the region           */
+  struct index_stack todo; /* pixels whose neighbors are unvisited */
+  struct index_stack bucket[FILL_BUCKETS]; /* rejected edge targets */
+};
+
+int ProgressiveFillInit(struct progressive_fill *pf, unsigned char **img,
+                        int width, int height, pixel_t seed);
+/* Grows the region to the given threshold, which must not be below the
+ * previous one.  Returns the number of pixels in the region. */
+unsigned int ProgressiveFillGrow(struct progressive_fill *pf,
+                                 double threshold);
+void ProgressiveFillFree(struct progressive_fill *pf);
+
+#endif /* _AREAFILL_H_ */
@@ -0,0 +1,91 @@
+#include "colorize.h"
+
+#include <stdlib.h>
+
+#include "allocate.h"
+#include "randlib.h"
+#include "tiff.h"
+
+#define RAND_MODULUS 0x7fffffffu /* of the generator of randlib.c */
+#define RAND_WARMUP 3
+
+void ScrambledColorMap(uint32_t seed, unsigned int nlabels, uint32_t *lut) {
+  struct rand_state st;
+
+  seed %= RAND_MODULUS;
+  rand_init_r(&st, seed ? seed : 1);
+  // the first variates of a small seed are small too
+  rand_jump_r(&st, RAND_WARMUP);
+  lut[0] = 0;
+  // the top 24 of the 31 bits of a variate make a color
+  for (unsigned int l = 1; l <= nlabels; l++)
+    lut[l] = (uint32_t)random3_r(&st) >> 7;
+}
+
+/* Palette color: the labels are the indices into the color map */
+static int WritePalette(FILE *fp, unsigned int **seg, int width, int height,
+                        unsigned int nlabels, const uint32_t *lut) {
+  struct TIFF_img img;
+  long npix = (long)width * height, i;
+  int ret;
+
+  if (get_TIFF(&img, height, width, 'p')) return -1;
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < npix; i++) {
+    img.mono[0][i] = (uint8_t)seg[0][i];
+  }
+  for (int k = 0; k < 256; k++) {
+    uint32_t c = (k <= (int)nlabels) ? lut[k] : 0;
+    img.cmap[k][0] = COLOR_R(c);
+    img.cmap[k][1] = COLOR_G(c);
+    img.cmap[k][2] = COLOR_B(c);
+  }
+  ret = write_TIFF(fp, &img);
+  free_TIFF(&img);
+  return ret ? -1 : 0;
+}
+
+/* Looks up the colors of n labels, split into their planes */
+static void GatherRow(const unsigned int *restrict seg,
+                      const uint32_t *restrict lut, uint8_t *restrict r,
+                      uint8_t *restrict g, uint8_t *restrict b, int n) {
+  for (int x = 0; x < n; x++) {
+    uint32_t c = lut[seg[x]];
+    r[x] = COLOR_R(c);
+    g[x] = COLOR_G(c);
+    b[x] = COLOR_B(c);
+  }
+}
+
+/* Full color: every pixel is looked up in the table */
+static int WriteRGB(FILE *fp, unsigned int **seg, int width, int height,
+                    const uint32_t *lut) {
+  struct TIFF_img img;
+  int ret;
+
+  if (get_TIFF(&img, height, width, 'c')) return -1;
+#pragma omp parallel for schedule(static)
+  for (int y = 0; y < height; y++) {
+    GatherRow(seg[y], lut, img.color[0][y], img.color[1][y], img.color[2][y],
+              width);
+  }
+  ret = write_TIFF(fp, &img);
+  free_TIFF(&img);
+  return ret ? -1 : 0;
+}
+
+int WriteColorizedTIFF(FILE *fp, unsigned int **seg, int width, int height,
+                       unsigned int nlabels, uint32_t seed) {
+  uint32_t *lut;
+  int ret;
+
+  lut = (uint32_t *)mget_spc((size_t)nlabels + 1, sizeof(uint32_t));
+  ScrambledColorMap(seed, nlabels, lut);
+  if (nlabels <= COLORIZE_PALETTE_MAX)
+    ret = WritePalette(fp, seg, width, height, nlabels, lut);
+  else
+    ret = WriteRGB(fp, seg, width, height, lut);
+  free(lut);
+  if (ret) fprintf(stderr, "WriteColorizedTIFF(): failed to write TIFF\n");
+  return ret;
+}
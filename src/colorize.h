@@ -0,0 +1,35 @@
+#ifndef _COLORIZE_H_
+#define _COLORIZE_H_
+
+#include <stdio.h>
+
+#include "typeutil.h"
+
+/* Colorized rendering of label images.
+ *
+ * Every label gets a random color from the generator of randlib.h started
+ * at a given seed, so the same seed colors the same labels the same way
+ * from image to image, and label 0, the background, is black.  Images of
+ * up to COLORIZE_PALETTE_MAX labels are written as palette-color TIFF
+ * files whose color map is the table of label colors; larger ones as RGB
+ * TIFF files, every pixel looked up in the table.  The table is kept as
+ * one 32-bit word per label, so the lookup is a 32-bit gather that the
+ * compiler vectorizes where the target has one. */
+
+#define COLORIZE_PALETTE_MAX 255
+
+/* Red, green and blue of a color of the table */
+#define COLOR_R(c) ((uint8_t)(c))
+#define COLOR_G(c) ((uint8_t)((c) >> 8))
+#define COLOR_B(c) ((uint8_t)((c) >> 16))
+
+/* Fills lut[0 .. nlabels] with the colors of the labels for seed; a seed
+ * of 0 is taken as 1 */
+void ScrambledColorMap(uint32_t seed, unsigned int nlabels, uint32_t *lut);
+
+/* Writes seg, with labels 0 .. nlabels, colored by the table of seed to
+ * fp.  Returns 0 on success. */
+int WriteColorizedTIFF(FILE *fp, unsigned int **seg, int width, int height,
+                       unsigned int nlabels, uint32_t seed);
+
+#endif /* _COLORIZE_H_ */
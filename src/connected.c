@@ -1,24 +1,153 @@
+#include <limits.h>
 #include <math.h>
 
 #include "allocate.h"
+#include "areafill.h"
+#include "colorize.h"
+#include "contour.h"
+#include "euler.h"
+#include "labelfile.h"
+#include "mapdenoise.h"
+#include "merge.h"
+#include "neighborhood.h"
+#include "parlabel.h"
+#include "pixelindex.h"
+#include "rag.h"
 #include "randlib.h"
+#include "relabel.h"
+#include "rtree.h"
+#include "seqlabel.h"
+#include "streamlabel.h"
 #include "tiff.h"
 #include "typeutil.h"
+#include "volumelabel.h"
 
-typedef struct pixel {
-  int row, col;
-} pixel_t;
+/* Outputs made from a segmentation besides its label image */
+struct region_outputs {
+  int rag;                    /* write rag_<T>.bin                     */
+  int merge;                  /* merge regions into merged_<T>.tif     */
+  unsigned int merge_regions; /* stop merging at this many regions     */
+  double merge_cost;          /* stop before a merge of higher cost    */
+  double size_penalty;        /* weight of log2(size) in the cost      */
+  int contours;               /* trace the region boundaries           */
+  int polygon_format;         /* POLY_WKT or POLY_GEOJSON              */
+  double simplify;            /* Douglas-Peucker tolerance in pixels   */
+  int pixel_index;            /* write segmentation_<T>.pix            */
+  int label_file;             /* write segmentation_<T>.lbl            */
+  int label_rle;              /* with a run-length coded raster        */
+  int region_tree;            /* write segmentation_<T>.rtree          */
+  int render;                 /* write scrambled_segmentation_<T>.tif  */
+  uint32_t render_seed;       /* seed of its colors                    */
+  const struct TIFF_img *image; /* pixels the labels were made from    */
+};
 
 void print_usage(const char *program_name);
 void ConnectedNeighbors(pixel_t s, double T, unsigned char **img, int width,
-                        int height, int *M, pixel_t c[4]);
+                        int height, unsigned int nb, int *M, pixel_t c[8]);
 void ConnectedSet(pixel_t s, double T, unsigned char **img, int width,
-                  int height, int ClassLabel, unsigned int **seg,
-                  int *NumConPixels);
+                  int height, unsigned int nb, int ClassLabel,
+                  unsigned int **seg, int *NumConPixels, pixel_t *B);
 int AreaFill(unsigned char **img, int width, int height, double threshold,
-             pixel_t s);
+             unsigned int nb, pixel_t s);
 int GetAllConnectedSets(unsigned char **input_img, int width, int height,
-                        double threshold, int min_connected_pixels);
+                        double threshold, unsigned int nb,
+                        int min_connected_pixels,
+                        const struct region_outputs *ro);
+int WriteSegmentation(unsigned int **seg, int width, int height,
+                      double threshold, unsigned int nlabels,
+                      const struct region_outputs *ro);
+int WriteSegmentationIndex(unsigned int **seg, int width, int height,
+                           double threshold, unsigned int nlabels,
+                           const struct region_outputs *ro);
+int WriteRendering(unsigned int **seg, int width, int height,
+                   double threshold, unsigned int nlabels,
+                   const struct region_outputs *ro);
+struct region_stats *SegmentationStats(unsigned int **seg, int width,
+                                       int height, unsigned int nlabels,
+                                       const struct region_outputs *ro);
+int WriteLabelFileOutput(unsigned int **seg, int width, int height,
+                         double threshold, unsigned int nlabels,
+                         const struct region_stats *stats,
+                         const struct pixel_index *pi,
+                         const struct region_outputs *ro);
+int WriteRegionTree(double threshold, unsigned int nlabels,
+                    const struct region_stats *stats,
+                    const struct pixel_index *pi);
+int WriteRegionOutputs(struct rag *g, unsigned int **seg, int width,
+                       int height, double threshold,
+                       const struct region_outputs *ro);
+int WriteAdjacency(const struct rag *g, double threshold);
+int WriteMergedRegions(const struct rag *g, unsigned int **seg, int width,
+                       int height, double threshold,
+                       const struct region_outputs *ro);
+int WriteContours(unsigned int **seg, int width, int height,
+                  unsigned int nb, double threshold, unsigned int nlabels,
+                  const struct region_outputs *ro);
+int LabelBits(unsigned int nlabels);
+void PrintFillHoles(unsigned char **mask, int width, int height,
+                    unsigned int nb);
+int GetAllConnectedSetsParallel(unsigned char **input_img, int width,
+                                int height, double threshold, unsigned int nb,
+                                int min_connected_pixels,
+                                const struct region_outputs *ro);
+int GetAllConnectedSetsTiled(unsigned char **input_img, int width, int height,
+                             double threshold, unsigned int nb,
+                             int min_connected_pixels, int tile_size,
+                             const struct region_outputs *ro);
+int LabelNative(const struct TIFF_img *img, const char *engine,
+                double threshold, unsigned int nb, int min_connected_pixels,
+                int tile_size, unsigned int **seg, unsigned int *nlabels);
+int AreaFillNative(const struct TIFF_img *img, double threshold,
+                   unsigned int nb, pixel_t s);
+int GetAllConnectedSetsNative(const struct TIFF_img *img, const char *engine,
+                              double threshold, unsigned int nb,
+                              int min_connected_pixels, int tile_size,
+                              const struct region_outputs *ro);
+int LabelVolume(FILE *fp, double threshold, int connectivity,
+                int min_connected_pixels);
+int DenoiseImage(struct TIFF_img *img, const struct map_params *mp);
+int SeedFill(unsigned char **img, int width, int height, double threshold,
+             const char *seed_file, int rle_output);
+int ProgressiveAreaFill(unsigned char **img, int width, int height,
+                        const double *thresholds, int nthresholds, pixel_t s);
+int ParseThresholdList(const char *list, double **thresholds);
+int CountOnly(unsigned char **img, int width, int height, double threshold,
+              int min_connected_pixels);
+void MakeOutputPath(char *path, size_t size, const char *prefix,
+                    double threshold, const char *extension);
+
+/* Appends neighbor (col, row) of s to c if it is within the threshold */
+NB_KERNEL void AddNeighbor(pixel_t s, int col, int row, double T,
+                           unsigned char **img, int *M, pixel_t c[8]) {
+  if (abs(img[s.row][s.col] - img[row][col]) <= T) {
+    c[*M].col = col;
+    c[*M].row = row;
+    (*M)++;
+  }
+}
+
+/* ConnectedNeighbors for one neighborhood; every offset is unrolled, so
+ * with a constant nb only the offsets of the neighborhood are compiled */
+NB_KERNEL void NeighborsKernel(pixel_t s, double T, unsigned char **img,
+                               int width, int height, unsigned int nb, int *M,
+                               pixel_t c[8]) {
+  int up = s.row > 0, down = s.row < height - 1;
+  int left = s.col > 0, right = s.col < width - 1;
+
+  *M = 0;
+  if ((nb & NB_N) && up) AddNeighbor(s, s.col, s.row - 1, T, img, M, c);
+  if ((nb & NB_S) && down) AddNeighbor(s, s.col, s.row + 1, T, img, M, c);
+  if ((nb & NB_W) && left) AddNeighbor(s, s.col - 1, s.row, T, img, M, c);
+  if ((nb & NB_E) && right) AddNeighbor(s, s.col + 1, s.row, T, img, M, c);
+  if ((nb & NB_NW) && up && left)
+    AddNeighbor(s, s.col - 1, s.row - 1, T, img, M, c);
+  if ((nb & NB_NE) && up && right)
+    AddNeighbor(s, s.col + 1, s.row - 1, T, img, M, c);
+  if ((nb & NB_SW) && down && left)
+    AddNeighbor(s, s.col - 1, s.row + 1, T, img, M, c);
+  if ((nb & NB_SE) && down && right)
+    AddNeighbor(s, s.col + 1, s.row + 1, T, img, M, c);
+}
 
 /**
  * @brief Finds the connected neighbors of a pixel
@@ -28,38 +157,29 @@ int GetAllConnectedSets(unsigned char **input_img, int width, int height,
  * @param img a 2D array of pixels
  * @param width the width of the image
  * @param height the height of the image
+ * @param nb the neighborhood, a mask of NB_* offsets
  * @param M a pointer to the number of neighbors connected to the pixels
  * @param c an array containing the M connected neighbors to pixel s, where M <=
- * 4
+ * 8
  *
  * Algorithm:
- * 1. iterate over neighbors in the image
+ * 1. test every neighbor of the neighborhood that is within the image
  * 2. if neighbor is within threshold, add it to list of connected neighbors and
  * increment number of neighbors
+ *
+ * The 4- and 8-neighborhoods run kernels specialized at compile time.
  */
 void ConnectedNeighbors(pixel_t s, double T, unsigned char **img, int width,
-                        int height, int *M, pixel_t c[4]) {
-  // Define directions for neighbors: up, down, left, right
-  int dx[] = {0, 0, -1, 1};
-  int dy[] = {-1, 1, 0, 0};
-
-  *M = 0;  // Initialize the number of connected neighbors
-
-  // Iterate over possible neighbors
-  for (int i = 0; i < 4; i++) {
-    int n_col = s.col + dx[i];  // col coordinate of the neighbor
-    int n_row = s.row + dy[i];  // row coordinate of the neighbor
-
-    // Check if the neighbor is within the boundaries of the image
-    if (n_col >= 0 && n_col < width && n_row >= 0 && n_row < height) {
-      // Check if the difference in intensity is within the threshold
-      if (abs(img[s.row][s.col] - img[n_row][n_col]) <= T) {
-        // Add the connected neighbor to the list
-        c[*M].col = n_col;
-        c[*M].row = n_row;
-        (*M)++;  // Increment the count of connected neighbors
-      }
-    }
+                        int height, unsigned int nb, int *M, pixel_t c[8]) {
+  switch (nb) {
+    case NB_4:
+      NeighborsKernel(s, T, img, width, height, NB_4, M, c);
+      break;
+    case NB_8:
+      NeighborsKernel(s, T, img, width, height, NB_8, M, c);
+      break;
+    default:
+      NeighborsKernel(s, T, img, width, height, nb, M, c);
   }
 }
 
@@ -71,26 +191,31 @@ void ConnectedNeighbors(pixel_t s, double T, unsigned char **img, int width,
  * @param img
  * @param width
  * @param height
+ * @param nb
  * @param ClassLabel
  * @param seg
  * @param NumConPixels
+ * @param B room for width * height pixels; on return the first
+ * NumConPixels of them are the pixels of the set
  */
 void ConnectedSet(pixel_t s, double T, unsigned char **img, int width,
-                  int height, int ClassLabel, unsigned int **seg,
-                  int *NumConPixels) {
-  // add seed pixel to queue
-  pixel_t B[width * height];
-  int B_idx = 0;
-  B[B_idx] = s;
-  while (B_idx >= 0) {
-    // pop a pixel, set it in the output image, and increment connected count
-    pixel_t s = B[B_idx--];
-    seg[s.row][s.col] = ClassLabel;
+                  int height, unsigned int nb, int ClassLabel,
+                  unsigned int **seg, int *NumConPixels, pixel_t *B) {
+  // add seed pixel to queue; popped pixels stay in B, so B ends up
+  // holding the whole set
+  int B_head = 0, B_tail = 0;
+  B[B_tail++] = s;
+  seg[s.row][s.col] = ClassLabel;
+  while (B_head < B_tail) {
+    // pop a pixel and increment connected count; pixels are set in the
+    // output image when pushed, so none is pushed or counted twice
+    pixel_t s = B[B_head++];
     (*NumConPixels)++;
     // get connected neighbors for the popped pixel
-    pixel_t neighbors[4];
+    pixel_t neighbors[8];
     int num_neighbors = 0;
-    ConnectedNeighbors(s, T, img, width, height, &num_neighbors, neighbors);
+    ConnectedNeighbors(s, T, img, width, height, nb, &num_neighbors,
+                       neighbors);
     // printf("num_neighbors: %d\t", num_neighbors);
     // add neighbors to the queue if not already a part of seg
     for (int i = 0; i < num_neighbors; i++) {
@@ -98,15 +223,57 @@ void ConnectedSet(pixel_t s, double T, unsigned char **img, int width,
       if (seg[neighbors[i].row][neighbors[i].col] == 0) {
         // printf("adding neighbor: %d, %d\n", neighbors[i].col,
         // neighbors[i].row);
-        B[++B_idx] = neighbors[i];
+        seg[neighbors[i].row][neighbors[i].col] = ClassLabel;
+        B[B_tail++] = neighbors[i];
       }
     }
-    // printf("B_idx: %d\n", B_idx);
+    // printf("B_tail: %d\n", B_tail);
+  }
+}
+
+/**
+ * @brief Writes a 0/255 fill image to ../img/fill_<threshold>.tif
+ *
+ * Prints the holes of the fill first, and frees output_img.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int WriteFill(struct TIFF_img *output_img, double threshold,
+                     unsigned int nb) {
+  PrintFillHoles(output_img->mono, output_img->width, output_img->height,
+                 nb);
+
+  // Convert double to string
+  char num_str[20];
+  snprintf(num_str, sizeof(num_str), "%.2f", threshold);  // Example format %.2f
+
+  // Construct file name with the double value
+  FILE *fp;
+  char output_file[50];
+  strcpy(output_file, "../img/fill_");
+  strcat(output_file, num_str);
+  strcat(output_file, ".tif");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    return EXIT_FAILURE;
   }
+
+  // write seg image
+  if (write_TIFF(fp, output_img)) {
+    fprintf(stderr, "Error: failed to write TIFF file\n");
+    return EXIT_FAILURE;
+  }
+
+  // close seg image file
+  fclose(fp);
+
+  free_TIFF(output_img);
+
+  return EXIT_SUCCESS;
 }
 
 int AreaFill(unsigned char **img, int width, int height, double threshold,
-             pixel_t s) {
+             unsigned int nb, pixel_t s) {
   // Declare a double pointer
   unsigned int **seg;
 
@@ -134,7 +301,10 @@ int AreaFill(unsigned char **img, int width, int height, double threshold,
 
   // find connected pixels
   int connected_pixels = 0;
-  ConnectedSet(s, threshold, img, width, height, 1, seg, &connected_pixels);
+  pixel_t *set = (pixel_t *)mget_spc((size_t)width * height, sizeof(pixel_t));
+  ConnectedSet(s, threshold, img, width, height, nb, 1, seg,
+               &connected_pixels, set);
+  free(set);
 
   // set output image
   struct TIFF_img output_img;
@@ -148,7 +318,111 @@ int AreaFill(unsigned char **img, int width, int height, double threshold,
       }
     }
   }
+  return WriteFill(&output_img, threshold, nb);
+}
+
+/* An 8-bit TIFF_img over the rows of an unsigned char image */
+#define GRAY_IMG(rows, w, h) \
+  ((struct TIFF_img){.height = (h), .width = (w), .TIFF_type = 'g', \
+                     .mono = (rows)})
+
+/**
+ * @brief Writes everything derived from a labeling of img
+ *
+ * The RAG and merged segmentation, the contours and the segmentation
+ * itself, as asked by ro.  Every engine ends with this; seg is left to
+ * the caller to free.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+static int WriteLabelOutputs(unsigned int **seg, const struct TIFF_img *img,
+                             unsigned int nb, double threshold,
+                             unsigned int nlabels,
+                             const struct region_outputs *ro) {
+  int width = img->width, height = img->height;
+
+  if (ro->rag || ro->merge) {
+    struct rag g;
+    if (img->TIFF_type == 'w')
+      BuildRAG_u16(img->mono16, seg, width, height, nb, nlabels, &g);
+    else if (img->TIFF_type == 'f')
+      BuildRAG_f32(img->monof, seg, width, height, nb, nlabels, &g);
+    else
+      BuildRAG(img->mono, seg, width, height, nb, nlabels, &g);
+    if (WriteRegionOutputs(&g, seg, width, height, threshold, ro) ==
+        EXIT_FAILURE)
+      return EXIT_FAILURE;
+  }
+  if (ro->contours &&
+      WriteContours(seg, width, height, nb, threshold, nlabels, ro) ==
+          EXIT_FAILURE)
+    return EXIT_FAILURE;
+
+  return WriteSegmentation(seg, width, height, threshold, nlabels, ro);
+}
+
+/**
+ * @brief Get all the connected sets
+ *
+ * @param input_img
+ * @param threshold
+ * @param min_connected_pixels
+ * @return int
+ */
+int GetAllConnectedSets(unsigned char **input_img, int width, int height,
+                        double threshold, unsigned int nb,
+                        int min_connected_pixels,
+                        const struct region_outputs *ro) {
+  unsigned int **seg, nlabels;
+  long npix = (long)width * height;
+  int ret;
+
+  seg = (unsigned int **)get_img(width, height, sizeof(unsigned int));
+  memset(seg[0], 0, npix * sizeof(unsigned int));
+  pixel_t *set = (pixel_t *)mget_spc((size_t)width * height, sizeof(pixel_t));
+
+  // Iterate through each pixel in raster order; the first pixel of every
+  // connected set found is its seed, and the set is labeled with the
+  // raster index of the seed plus one
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      // Check if the pixel already belongs to a connected set
+      if (seg[y][x] == 0) {
+        int connected_pixels = 0;
+        struct pixel s = {y, x};
+        ConnectedSet(s, threshold, input_img, width, height, nb,
+                     y * width + x + 1, seg, &connected_pixels, set);
+      }
+    }
+  }
+  free(set);
 
+  // Relabel the kept sets 1, 2, ... in raster order of their seeds
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < npix; i++) {
+    seg[0][i]--;
+  }
+  RelabelRoots((uint32_t *)seg[0], npix, min_connected_pixels, &nlabels);
+  printf("labels: %u\n", nlabels);
+
+  ret = WriteLabelOutputs(seg, &GRAY_IMG(input_img, width, height), nb,
+                          threshold, nlabels, ro);
+  free_img((void **)seg);
+  return ret;
+}
+
+/**
+ * @brief Writes a label buffer to ../img/segmentation_<threshold>.tif
+ *
+ * The image has 8, 16 or 32 bits per pixel, the narrowest that holds
+ * labels up to nlabels, and is written directly from seg.  The pixel
+ * index and the label file of seg are written next to it if ro asks.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteSegmentation(unsigned int **seg, int width, int height,
+                      double threshold, unsigned int nlabels,
+                      const struct region_outputs *ro) {
   // Convert double to string
   char num_str[20];
   snprintf(num_str, sizeof(num_str), "%.2f", threshold);  // Example format %.2f
@@ -156,7 +430,7 @@ int AreaFill(unsigned char **img, int width, int height, double threshold,
   // Construct file name with the double value
   FILE *fp;
   char output_file[50];
-  strcpy(output_file, "../img/fill_");
+  strcpy(output_file, "../img/segmentation_");
   strcat(output_file, num_str);
   strcat(output_file, ".tif");
   if ((fp = fopen(output_file, "wb")) == NULL) {
@@ -165,7 +439,8 @@ int AreaFill(unsigned char **img, int width, int height, double threshold,
   }
 
   // write seg image
-  if (write_TIFF(fp, &output_img)) {
+  if (write_TIFF_u32(fp, (uint32_t **)seg, height, width,
+                     LabelBits(nlabels))) {
     fprintf(stderr, "Error: failed to write TIFF file\n");
     return EXIT_FAILURE;
   }
@@ -173,145 +448,1024 @@ int AreaFill(unsigned char **img, int width, int height, double threshold,
   // close seg image file
   fclose(fp);
 
-  free_TIFF(&(output_img));
-
+  if (ro->render && WriteRendering(seg, width, height, threshold, nlabels,
+                                   ro) == EXIT_FAILURE)
+    return EXIT_FAILURE;
+  if (ro->pixel_index || ro->label_file || ro->region_tree)
+    return WriteSegmentationIndex(seg, width, height, threshold, nlabels, ro);
   return EXIT_SUCCESS;
 }
 
 /**
- * @brief Get all the connected sets
+ * @brief Writes seg in color to ../img/scrambled_segmentation_<threshold>.tif
  *
- * @param input_img
- * @param threshold
- * @param min_connected_pixels
- * @return int
+ * Up to 255 labels make a palette-color image, more an RGB image; the
+ * colors are random for ro->render_seed.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
  */
-int GetAllConnectedSets(unsigned char **input_img, int width, int height,
-                        double threshold, int min_connected_pixels) {
-  // Declare a double pointer
-  unsigned int **seg;
+int WriteRendering(unsigned int **seg, int width, int height,
+                   double threshold, unsigned int nlabels,
+                   const struct region_outputs *ro) {
+  char output_file[64];
+  FILE *fp;
+  int ret;
 
-  // Allocate memory for the array
-  seg = (unsigned int **)malloc(height * sizeof(unsigned int *));
-  if (seg == NULL) {
-    printf("Memory allocation failed.\n");
-    return 1;
+  MakeOutputPath(output_file, sizeof(output_file),
+                 "../img/scrambled_segmentation_", threshold, ".tif");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    return EXIT_FAILURE;
   }
+  ret = WriteColorizedTIFF(fp, seg, width, height, nlabels, ro->render_seed);
+  fclose(fp);
 
-  for (int i = 0; i < height; i++) {
-    seg[i] = (unsigned int *)malloc(width * sizeof(unsigned int));
-    if (seg[i] == NULL) {
-      printf("Memory allocation failed.\n");
-      return 1;
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes the pixel index of seg to ../img/segmentation_<threshold>.pix,
+ * the label file to ../img/segmentation_<threshold>.lbl and the R-tree of
+ * the regions to ../img/segmentation_<threshold>.rtree, as ro asks
+ *
+ * Either of the first two can be mapped to read the pixels of any region
+ * without scanning the label image, the last to find the regions in a
+ * rectangle or near a point.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteSegmentationIndex(unsigned int **seg, int width, int height,
+                           double threshold, unsigned int nlabels,
+                           const struct region_outputs *ro) {
+  struct pixel_index pi;
+  struct region_stats *stats = NULL;
+  char output_file[64];
+  FILE *fp;
+  int ret = 0;
+
+  if (BuildPixelIndex(seg, width, height, nlabels, &pi)) {
+    return EXIT_FAILURE;
+  }
+  if (ro->pixel_index) {
+    MakeOutputPath(output_file, sizeof(output_file), "../img/segmentation_",
+                   threshold, ".pix");
+    if ((fp = fopen(output_file, "wb")) == NULL) {
+      fprintf(stderr, "Error: failed to open output file\n");
+      FreePixelIndex(&pi);
+      return EXIT_FAILURE;
     }
+    ret = WritePixelIndex(fp, &pi);
+    fclose(fp);
   }
+  if (ret == 0 && (ro->label_file || ro->region_tree) &&
+      (stats = SegmentationStats(seg, width, height, nlabels, ro)) == NULL)
+    ret = -1;
+  if (ret == 0 && ro->label_file &&
+      WriteLabelFileOutput(seg, width, height, threshold, nlabels, stats, &pi,
+                           ro) == EXIT_FAILURE)
+    ret = -1;
+  if (ret == 0 && ro->region_tree &&
+      WriteRegionTree(threshold, nlabels, stats, &pi) == EXIT_FAILURE)
+    ret = -1;
+  free(stats);
+  FreePixelIndex(&pi);
 
-  // Initialize the elements of the array
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Statistics of the labels of seg over the pixels of ro->image
+ *
+ * @return struct region_stats* nlabels + 1 entries, or NULL on error
+ */
+struct region_stats *SegmentationStats(unsigned int **seg, int width,
+                                       int height, unsigned int nlabels,
+                                       const struct region_outputs *ro) {
+  const struct TIFF_img *img = ro->image;
+  struct region_stats *stats;
+  int ret;
+
+  stats = (struct region_stats *)mget_spc((size_t)nlabels + 1,
+                                          sizeof(struct region_stats));
+  if (img->TIFF_type == 'w')
+    ret = RegionStats_u16(img->mono16, seg, width, height, nlabels, stats);
+  else if (img->TIFF_type == 'f')
+    ret = RegionStats_f32(img->monof, seg, width, height, nlabels, stats);
+  else
+    ret = RegionStats(img->mono, seg, width, height, nlabels, stats);
+  if (ret) {
+    free(stats);
+    return NULL;
+  }
+  return stats;
+}
+
+/**
+ * @brief Writes the label file of seg to ../img/segmentation_<threshold>.lbl
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteLabelFileOutput(unsigned int **seg, int width, int height,
+                         double threshold, unsigned int nlabels,
+                         const struct region_stats *stats,
+                         const struct pixel_index *pi,
+                         const struct region_outputs *ro) {
+  char output_file[64];
+  FILE *fp;
+  int ret;
+
+  MakeOutputPath(output_file, sizeof(output_file), "../img/segmentation_",
+                 threshold, ".lbl");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    return EXIT_FAILURE;
+  }
+  ret = WriteLabelFile(fp, seg, width, height, nlabels, stats, pi,
+                       ro->label_rle);
+  fclose(fp);
+
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes the R-tree of the region boxes and centroids to
+ * ../img/segmentation_<threshold>.rtree
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteRegionTree(double threshold, unsigned int nlabels,
+                    const struct region_stats *stats,
+                    const struct pixel_index *pi) {
+  struct region_box *boxes;
+  struct rtree t;
+  char output_file[64];
+  FILE *fp;
+  int ret;
+
+  boxes = (struct region_box *)mget_spc((size_t)nlabels + 1,
+                                        sizeof(struct region_box));
+  for (uint32_t l = 0; l <= nlabels; l++) RegionBox(pi, l, boxes + l);
+  ret = BuildRTree(boxes, stats, nlabels, &t);
+  free(boxes);
+  if (ret) return EXIT_FAILURE;
+
+  MakeOutputPath(output_file, sizeof(output_file), "../img/segmentation_",
+                 threshold, ".rtree");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    FreeRTree(&t);
+    return EXIT_FAILURE;
+  }
+  ret = WriteRTree(fp, &t);
+  fclose(fp);
+  printf("region tree: %u regions, %u nodes\n", t.nentries, t.nnodes);
+  FreeRTree(&t);
+
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes the outputs of ro made from the adjacency graph g of seg
+ *
+ * g is freed.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteRegionOutputs(struct rag *g, unsigned int **seg, int width,
+                       int height, double threshold,
+                       const struct region_outputs *ro) {
+  int ret = EXIT_SUCCESS;
+
+  if (ro->rag) ret = WriteAdjacency(g, threshold);
+  if (ret == EXIT_SUCCESS && ro->merge)
+    ret = WriteMergedRegions(g, seg, width, height, threshold, ro);
+  FreeRAG(g);
+  return ret;
+}
+
+/**
+ * @brief Writes a region adjacency graph to ../img/rag_<threshold>.bin
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteAdjacency(const struct rag *g, double threshold) {
+  char output_file[64];
+  FILE *fp;
+  int ret;
+
+  printf("adjacent region pairs: %u\n", g->nedges);
+  MakeOutputPath(output_file, sizeof(output_file), "../img/rag_", threshold,
+                 ".bin");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    return EXIT_FAILURE;
+  }
+  ret = WriteRAG(fp, g);
+  fclose(fp);
+
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief Merges the regions of seg and writes the result
+ *
+ * The whole merge sequence is written to ../img/merge_<threshold>.bin, so
+ * other cuts can be taken from it later.  The cut at ro->merge_regions
+ * regions or ro->merge_cost, whichever comes first, is written as a label
+ * image to ../img/merged_<threshold>.tif.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteMergedRegions(const struct rag *g, unsigned int **seg, int width,
+                       int height, double threshold,
+                       const struct region_outputs *ro) {
+  struct merge_tree t;
+  unsigned int **merged, nlabels;
+  uint32_t *map, steps;
+  char output_file[64];
+  FILE *fp;
+  int ret;
+
+  MergeRegions(g, ro->size_penalty, &t);
+  MakeOutputPath(output_file, sizeof(output_file), "../img/merge_", threshold,
+                 ".bin");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    FreeMergeTree(&t);
+    return EXIT_FAILURE;
+  }
+  ret = WriteMergeTree(fp, &t);
+  fclose(fp);
+  if (ret) {
+    FreeMergeTree(&t);
+    return EXIT_FAILURE;
+  }
+
+  map = (uint32_t *)mget_spc((size_t)t.nlabels + 1, sizeof(uint32_t));
+  steps = CutMergeTree(&t, ro->merge_regions, ro->merge_cost, map, &nlabels);
+  printf("merged regions: %u after %u of %u merges\n", nlabels, steps,
+         t.nsteps);
+  FreeMergeTree(&t);
+
+  merged = (unsigned int **)get_img(width, height, sizeof(unsigned int));
   for (int i = 0; i < height; i++) {
-    for (int j = 0; j < width; j++) {
-      seg[i][j] = 0;
+    for (int j = 0; j < width; j++) merged[i][j] = map[seg[i][j]];
+  }
+  free(map);
+
+  MakeOutputPath(output_file, sizeof(output_file), "../img/merged_",
+                 threshold, ".tif");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    free_img((void **)merged);
+    return EXIT_FAILURE;
+  }
+  ret = write_TIFF_u32(fp, (uint32_t **)merged, height, width,
+                       LabelBits(nlabels));
+  fclose(fp);
+  free_img((void **)merged);
+  if (ret) {
+    fprintf(stderr, "Error: failed to write TIFF file\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Traces the boundaries of every region of seg
+ *
+ * The chain codes are written to ../img/contours_<threshold>.chain and the
+ * simplified polygons to ../img/contours_<threshold>.wkt or .geojson, each
+ * contour as soon as it is traced.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int WriteContours(unsigned int **seg, int width, int height,
+                  unsigned int nb, double threshold, unsigned int nlabels,
+                  const struct region_outputs *ro) {
+  struct contour_tracer ct;
+  struct polygon_writer pw;
+  struct contour c;
+  char chain_file[64], polygon_file[64];
+  FILE *chain, *polygons;
+  long nouter = 0, nholes = 0;
+  int ret = 0;
+
+  MakeOutputPath(chain_file, sizeof(chain_file), "../img/contours_",
+                 threshold, ".chain");
+  MakeOutputPath(polygon_file, sizeof(polygon_file), "../img/contours_",
+                 threshold,
+                 ro->polygon_format == POLY_GEOJSON ? ".geojson" : ".wkt");
+  if ((chain = fopen(chain_file, "w")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    return EXIT_FAILURE;
+  }
+  if ((polygons = fopen(polygon_file, "w")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    fclose(chain);
+    return EXIT_FAILURE;
+  }
+
+  ContourTracerInit(&ct, seg, width, height, nb);
+  PolygonWriterInit(&pw, polygons, ro->polygon_format, ro->simplify, seg,
+                    width, height, nlabels);
+  while (ret == 0 && NextContour(&ct, &c)) {
+    if (c.hole)
+      nholes++;
+    else
+      nouter++;
+    ret = WriteChainCode(chain, &c) || PolygonWriterAdd(&pw, &c);
+  }
+  ContourTracerFree(&ct);
+  if (PolygonWriterFinish(&pw)) ret = -1;
+  fclose(chain);
+  fclose(polygons);
+  printf("contours: %ld outer, %ld holes\n", nouter, nholes);
+
+  return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Bits per pixel of the narrowest label image that holds nlabels labels */
+int LabelBits(unsigned int nlabels) {
+  return (nlabels <= UINT8_MAX) ? 8 : (nlabels <= UINT16_MAX) ? 16 : 32;
+}
+
+/* Prints the holes of the connected region of nonzero pixels of mask,
+ * counted from its Euler number */
+void PrintFillHoles(unsigned char **mask, int width, int height,
+                    unsigned int nb) {
+  long euler;
+
+  // the Euler number needs the 4-neighbors
+  if ((nb & NB_4) == NB_4 &&
+      EulerNumber(mask, width, height, nb, &euler) == 0) {
+    printf("fill holes: %ld\n", 1 - euler);
+  }
+}
+
+/**
+ * @brief Get all the connected sets with the parallel union-find engine
+ *
+ * Produces the same labels as GetAllConnectedSets.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int GetAllConnectedSetsParallel(unsigned char **input_img, int width,
+                                int height, double threshold, unsigned int nb,
+                                int min_connected_pixels,
+                                const struct region_outputs *ro) {
+  unsigned int **seg, nlabels;
+  int ret;
+
+  seg = (unsigned int **)get_img(width, height, sizeof(unsigned int));
+  LabelParallel(input_img, width, height, threshold, nb, min_connected_pixels,
+                seg, &nlabels);
+  printf("labels: %u\n", nlabels);
+
+  ret = WriteLabelOutputs(seg, &GRAY_IMG(input_img, width, height), nb,
+                          threshold, nlabels, ro);
+  free_img((void **)seg);
+  return ret;
+}
+
+/**
+ * @brief Get all the connected sets with the cache-blocked tile engine
+ *
+ * Produces the same labels as GetAllConnectedSets in a single thread.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int GetAllConnectedSetsTiled(unsigned char **input_img, int width, int height,
+                             double threshold, unsigned int nb,
+                             int min_connected_pixels, int tile_size,
+                             const struct region_outputs *ro) {
+  unsigned int **seg, nlabels;
+  int ret;
+
+  seg = (unsigned int **)get_img(width, height, sizeof(unsigned int));
+  LabelTiled(input_img, width, height, threshold, nb, min_connected_pixels,
+             tile_size, seg, &nlabels);
+  printf("labels: %u\n", nlabels);
+
+  ret = WriteLabelOutputs(seg, &GRAY_IMG(input_img, width, height), nb,
+                          threshold, nlabels, ro);
+  free_img((void **)seg);
+  return ret;
+}
+
+/**
+ * @brief Labels a 16-bit or floating-point image at native precision
+ *
+ * Runs the dfs, tile or parallel engine instantiated for the pixel type
+ * of img, so the threshold is compared with the unquantized differences.
+ *
+ * @return int 0 on success
+ */
+int LabelNative(const struct TIFF_img *img, const char *engine,
+                double threshold, unsigned int nb, int min_connected_pixels,
+                int tile_size, unsigned int **seg, unsigned int *nlabels) {
+  int w = img->width, h = img->height, min = min_connected_pixels;
+
+  if (img->TIFF_type == 'w') {
+    if (strcmp(engine, "parallel") == 0)
+      return LabelParallel_u16(img->mono16, w, h, threshold, nb, min, seg,
+                               nlabels);
+    if (strcmp(engine, "tile") == 0)
+      return LabelTiled_u16(img->mono16, w, h, threshold, nb, min, tile_size,
+                            seg, nlabels);
+    return LabelDFS_u16(img->mono16, w, h, threshold, nb, min, seg, nlabels);
+  }
+  if (strcmp(engine, "parallel") == 0)
+    return LabelParallel_f32(img->monof, w, h, threshold, nb, min, seg,
+                             nlabels);
+  if (strcmp(engine, "tile") == 0)
+    return LabelTiled_f32(img->monof, w, h, threshold, nb, min, tile_size,
+                          seg, nlabels);
+  return LabelDFS_f32(img->monof, w, h, threshold, nb, min, seg, nlabels);
+}
+
+/**
+ * @brief AreaFill of a 16-bit or floating-point image
+ *
+ * The fill of s is the region of s in a labeling that keeps every region.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int AreaFillNative(const struct TIFF_img *img, double threshold,
+                   unsigned int nb, pixel_t s) {
+  struct TIFF_img output_img;
+  unsigned int **seg, nlabels, label;
+  char output_file[64];
+  FILE *fp;
+
+  seg = (unsigned int **)get_img(img->width, img->height,
+                                 sizeof(unsigned int));
+  LabelNative(img, "dfs", threshold, nb, 0, 0, seg, &nlabels);
+  label = seg[s.row][s.col];
+
+  get_TIFF(&output_img, img->height, img->width, 'g');
+  for (int i = 0; i < img->height; i++) {
+    for (int j = 0; j < img->width; j++) {
+      output_img.mono[i][j] = (seg[i][j] == label) ? 255 : 0;
     }
   }
+  free_img((void **)seg);
+  PrintFillHoles(output_img.mono, img->width, img->height, nb);
 
-  // Initalize number of regions
-  int total_regions = 0;
+  MakeOutputPath(output_file, sizeof(output_file), "../img/fill_", threshold,
+                 ".tif");
+  if ((fp = fopen(output_file, "wb")) == NULL) {
+    fprintf(stderr, "Error: failed to open output file\n");
+    return EXIT_FAILURE;
+  }
+  if (write_TIFF(fp, &output_img)) {
+    fprintf(stderr, "Error: failed to write TIFF file\n");
+    return EXIT_FAILURE;
+  }
+  fclose(fp);
+  free_TIFF(&(output_img));
 
-  // Iterate through each pixel in raster order
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      // Check if the pixel already belongs to a connected set
-      if (seg[y][x] == 0) {
-        int connected_pixels = 0;
-        struct pixel s = {y, x};
-        // sets a connected set to a static label
-        ConnectedSet(s, threshold, input_img, width, height, 255, seg,
-                     &connected_pixels);
-        total_regions++;
-        // If the connected set has more than min_set_size pixels, assign a
-        // sequential label starting from 1
-        if (connected_pixels > min_connected_pixels) {
-          printf("connected_pixels meets min: %d\n", connected_pixels);
-          static unsigned int label = 1;
-          // Label the connected set sequentially
-          for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-              if (seg[i][j] == 255) {
-                seg[i][j] = label;
-              }
-            }
-          }
-          printf("label: %d\n", label);
-          label++;
-        } else {
-          // Otherwise, label the connected set as 0
-          for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-              if (seg[i][j] == 255) {
-                seg[i][j] = 0;
-              }
-            }
-          }
-        }
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Get all the connected sets of a 16-bit or floating-point image
+ *
+ * Produces the same labels as GetAllConnectedSets at native precision.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int GetAllConnectedSetsNative(const struct TIFF_img *img, const char *engine,
+                              double threshold, unsigned int nb,
+                              int min_connected_pixels, int tile_size,
+                              const struct region_outputs *ro) {
+  unsigned int **seg, nlabels;
+  int ret;
+
+  seg = (unsigned int **)get_img(img->width, img->height,
+                                 sizeof(unsigned int));
+  LabelNative(img, engine, threshold, nb, min_connected_pixels, tile_size,
+              seg, &nlabels);
+  printf("labels: %u\n", nlabels);
+
+  ret = WriteLabelOutputs(seg, img, nb, threshold, nlabels, ro);
+  free_img((void **)seg);
+  return ret;
+}
+
+/**
+ * @brief Labels the slices of a multi-page TIFF file as one volume
+ *
+ * The pages are read one at a time and fed to a volume stream, so only
+ * two slices of pixels are in memory.  Slice k of the labels is written
+ * to ../img/segmentation3d_<threshold>_z<k>.tif.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int LabelVolume(FILE *fp, double threshold, int connectivity,
+                int min_connected_pixels) {
+  struct TIFF_pages pages;
+  struct TIFF_img slice[2];
+  struct volume_stream vs;
+  unsigned int **seg = NULL, nlabels;
+  int held[2] = {0, 0}; /* slice[k] holds pixels to free */
+  int z, bits;
+
+  memset(&vs, 0, sizeof(vs));
+  if (open_TIFF_pages(fp, &pages)) {
+    fprintf(stderr, "Error: failed to read TIFF header\n");
+    return EXIT_FAILURE;
+  }
+
+  // first pass: the slice before the current one is kept for its pixels
+  for (z = 0; pages.next_ifd != 0; z++) {
+    struct TIFF_img *cur = &slice[z % 2], *prev = &slice[(z + 1) % 2];
+    if (read_TIFF_page(&pages, cur)) {
+      fprintf(stderr, "Error: failed to read slice %d\n", z);
+      goto fail;
+    }
+    held[z % 2] = 1;
+    if (z == 0) {
+      if (cur->TIFF_type != 'g' && cur->TIFF_type != 'w' &&
+          cur->TIFF_type != 'f') {
+        fprintf(stderr, "Error: slices must be grayscale\n");
+        goto fail;
       }
+      if (VolumeStreamInit(&vs, cur->width, cur->height, threshold,
+                           connectivity)) {
+        goto fail;
+      }
+    } else if (cur->width != prev->width || cur->height != prev->height ||
+               cur->TIFF_type != prev->TIFF_type) {
+      fprintf(stderr, "Error: slice %d differs in size or type\n", z);
+      goto fail;
     }
+
+    if (cur->TIFF_type == 'g') {
+      VolumeStreamSlice(&vs, z ? prev->mono : NULL, cur->mono);
+    } else if (cur->TIFF_type == 'w') {
+      VolumeStreamSlice_u16(&vs, z ? prev->mono16 : NULL, cur->mono16);
+    } else {
+      VolumeStreamSlice_f32(&vs, z ? prev->monof : NULL, cur->monof);
+    }
+    if (z > 0) {
+      free_TIFF(prev);
+      held[(z + 1) % 2] = 0;
+    }
+  }
+  if (z == 0) {
+    fprintf(stderr, "Error: no slices\n");
+    goto fail;
   }
+  free_TIFF(&slice[(z - 1) % 2]);
+  held[(z - 1) % 2] = 0;
 
-  struct TIFF_img output_img;
-  get_TIFF(&output_img, height, width, 'g');
+  if (VolumeStreamFinish(&vs, min_connected_pixels, &nlabels)) {
+    goto fail;
+  }
+  printf("slices: %d\n", z);
+  printf("labels: %u\n", nlabels);
+
+  // second pass: write the final labels slice by slice
+  bits = LabelBits(nlabels);
+  seg = (unsigned int **)get_img(vs.width, vs.height, sizeof(unsigned int));
+  for (int k = 0; k < z; k++) {
+    char extension[20], output_file[64];
+    FILE *out;
 
-  // set the output image to 0
-  for (int i = 0; i < output_img.height; i++) {
-    for (int j = 0; j < output_img.width; j++) {
-      output_img.mono[i][j] = seg[i][j];
+    if (VolumeStreamLabels(&vs, seg)) {
+      goto fail;
     }
+    snprintf(extension, sizeof(extension), "_z%03d.tif", k);
+    MakeOutputPath(output_file, sizeof(output_file), "../img/segmentation3d_",
+                   threshold, extension);
+    if ((out = fopen(output_file, "wb")) == NULL) {
+      fprintf(stderr, "Error: failed to open output file\n");
+      goto fail;
+    }
+    if (write_TIFF_u32(out, (uint32_t **)seg, vs.height, vs.width, bits)) {
+      fprintf(stderr, "Error: failed to write TIFF file\n");
+      fclose(out);
+      goto fail;
+    }
+    fclose(out);
   }
+  free_img((void **)seg);
+  VolumeStreamFree(&vs);
 
-  // Convert double to string
-  char num_str[20];
-  snprintf(num_str, sizeof(num_str), "%.2f", threshold);  // Example format %.2f
+  return EXIT_SUCCESS;
 
-  // Construct file name with the double value
+fail:
+  for (int k = 0; k < 2; k++) {
+    if (held[k]) free_TIFF(&slice[k]);
+  }
+  if (seg != NULL) free_img((void **)seg);
+  VolumeStreamFree(&vs);
+  return EXIT_FAILURE;
+}
+
+/**
+ * @brief Replaces an 8-bit image by its qGGMRF MAP estimate
+ *
+ * @param img the grayscale image, denoised in place
+ * @param mp parameters of the noise model, prior and iteration
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int DenoiseImage(struct TIFF_img *img, const struct map_params *mp) {
+  double **x, **y;
+  struct map_stats stats;
+  int ret;
+
+  x = (double **)get_img(img->width, img->height, sizeof(double));
+  y = (double **)get_img(img->width, img->height, sizeof(double));
+  for (int i = 0; i < img->height; i++) {
+    for (int j = 0; j < img->width; j++) {
+      x[i][j] = y[i][j] = img->mono[i][j];
+    }
+  }
+
+  ret = qGGMRF_MAP_denoise(x, y, img->width, img->height, mp, &stats);
+  if (ret == 0) {
+    if (stats.iterations > 0)
+      printf("MAP denoising: %d iterations, %.3f ms per iteration\n",
+             stats.iterations, 1e3 * stats.total_seconds / stats.iterations);
+    else
+      printf("MAP denoising: 0 iterations\n");
+    // quantize the estimate back to 8 bits
+    for (int i = 0; i < img->height; i++) {
+      for (int j = 0; j < img->width; j++) {
+        double v = floor(x[i][j] + 0.5);
+        img->mono[i][j] = (v < 0) ? 0 : (v > 255) ? 255 : (unsigned char)v;
+      }
+    }
+  }
+
+  free_img((void **)x);
+  free_img((void **)y);
+  return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Builds an output path of the form <prefix><threshold><extension>
+ */
+void MakeOutputPath(char *path, size_t size, const char *prefix,
+                    double threshold, const char *extension) {
+  snprintf(path, size, "%s%.2f%s", prefix, threshold, extension);
+}
+
+/**
+ * @brief Area fill for every seed listed in a seed file
+ *
+ * All seeds are filled by MultiSeedAreaFill, so each distinct region is
+ * traversed once no matter how many seeds it contains.  The result is
+ * written as one region id image (seedfill_<T>.tif) or, with rle_output,
+ * as per-seed run-length masks (seedfill_<T>.rle).
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int SeedFill(unsigned char **img, int width, int height, double threshold,
+             const char *seed_file, int rle_output) {
+  pixel_t *seeds;
+  struct seed_fill fill;
+  char output_file[256];
   FILE *fp;
-  char output_file[50];
-  strcpy(output_file, "../img/segmentation_");
-  strcat(output_file, num_str);
-  strcat(output_file, ".tif");
+  int nseeds, nholed = 0;
+  long *euler, nholes = 0;
+
+  nseeds = ReadSeedFile(seed_file, &seeds);
+  if (nseeds < 0) {
+    return EXIT_FAILURE;
+  }
+
+  MultiSeedAreaFill(img, width, height, threshold, seeds, nseeds, &fill);
+  printf("%d seeds in %d regions\n", nseeds, fill.nregions);
+
+  // the regions are 4-connected, so each has 1 - euler holes
+  euler = (long *)mget_spc((size_t)fill.nregions + 1, sizeof(long));
+  LabelEulerNumbers(fill.label, width, height, NB_4, NULL,
+                    fill.nregions + 1, euler);
+  for (int r = 1; r <= fill.nregions; r++) {
+    nholed += (euler[r] < 1);
+    nholes += 1 - euler[r];
+  }
+  printf("regions with holes: %d, holes: %ld\n", nholed, nholes);
+  free(euler);
+
+  MakeOutputPath(output_file, sizeof(output_file), "../img/seedfill_",
+                 threshold, rle_output ? ".rle" : ".tif");
   if ((fp = fopen(output_file, "wb")) == NULL) {
     fprintf(stderr, "Error: failed to open output file\n");
     return EXIT_FAILURE;
   }
 
-  // write seg image
-  if (write_TIFF(fp, &output_img)) {
-    fprintf(stderr, "Error: failed to write TIFF file\n");
-    return EXIT_FAILURE;
+  if (rle_output) {
+    if (WriteSeedMasksRLE(fp, &fill, seeds)) {
+      fprintf(stderr, "Error: failed to write %s\n", output_file);
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (write_TIFF_u32(fp, (uint32_t **)fill.label, height, width,
+                       LabelBits(fill.nregions))) {
+      fprintf(stderr, "Error: failed to write TIFF file\n");
+      return EXIT_FAILURE;
+    }
   }
 
-  // close seg image file
   fclose(fp);
+  free_seed_fill(&fill);
+  free(seeds);
 
-  free_TIFF(&(output_img));
+  return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Prints the number of connected sets and their size histogram
+ *
+ * Uses the streaming counter, so no label image is allocated or written.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int CountOnly(unsigned char **img, int width, int height, double threshold,
+              int min_connected_pixels) {
+  struct component_counts cc;
+
+  if (CountConnectedSets(img, width, height, threshold, min_connected_pixels,
+                         &cc)) {
+    return EXIT_FAILURE;
+  }
+
+  printf("regions: %lu\n", cc.nregions);
+  printf("regions with more than %d pixels: %lu\n", min_connected_pixels,
+         cc.nkept);
+  printf("largest region: %lu pixels\n", cc.max_size);
+  printf("size histogram of kept regions:\n");
+  for (int k = 0; k < COUNT_HIST_BINS; k++) {
+    if (cc.histogram[k]) {
+      printf("  [%lu, %lu): %lu\n", 1ul << k, 1ul << (k + 1), cc.histogram[k]);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Parses a comma-separated list of thresholds into ascending order
+ *
+ * @return int the number of thresholds, or -1 on error
+ */
+int ParseThresholdList(const char *list, double **thresholds) {
+  int n = 1;
+  const char *c;
+  char *end;
+
+  for (c = list; *c; c++) {
+    n += (*c == ',');
+  }
+  *thresholds = (double *)mget_spc(n, sizeof(double));
+  for (int i = 0; i < n; i++) {
+    (*thresholds)[i] = strtod(list, &end);
+    if (end == list || (*end != ',' && *end != '\0')) {
+      fprintf(stderr, "Error: bad threshold list %s\n", list);
+      free(*thresholds);
+      return -1;
+    }
+    list = end + 1;
+  }
+  qsort(*thresholds, n, sizeof(double), CompareDoubles);
+  return n;
+}
+
+/**
+ * @brief Area fill of one seed at every threshold of an ascending list
+ *
+ * The fills are nested, so one progressive fill grows the region from
+ * level to level and writes fill_<T>.tif for every threshold T.
+ *
+ * @return int EXIT_SUCCESS or EXIT_FAILURE
+ */
+int ProgressiveAreaFill(unsigned char **img, int width, int height,
+                        const double *thresholds, int nthresholds, pixel_t s) {
+  struct progressive_fill pf;
+  struct TIFF_img output_img;
+  char output_file[256];
+  FILE *fp;
+
+  if (ProgressiveFillInit(&pf, img, width, height, s)) {
+    return EXIT_FAILURE;
+  }
+  get_TIFF(&output_img, height, width, 'g');
+
+  for (int t = 0; t < nthresholds; t++) {
+    unsigned int n = ProgressiveFillGrow(&pf, thresholds[t]);
+    long euler;
+
+    for (int i = 0; i < height; i++) {
+      for (int j = 0; j < width; j++) {
+        output_img.mono[i][j] = pf.mask[(size_t)i * width + j] ? 255 : 0;
+      }
+    }
+    EulerNumber(output_img.mono, width, height, NB_4, &euler);
+    printf("threshold %.2f: %u pixels, %ld holes\n", thresholds[t], n,
+           1 - euler);
 
+    MakeOutputPath(output_file, sizeof(output_file), "../img/fill_",
+                   thresholds[t], ".tif");
+    if ((fp = fopen(output_file, "wb")) == NULL) {
+      fprintf(stderr, "Error: failed to open output file\n");
+      return EXIT_FAILURE;
+    }
+    if (write_TIFF(fp, &output_img)) {
+      fprintf(stderr, "Error: failed to write TIFF file\n");
+      return EXIT_FAILURE;
+    }
+    fclose(fp);
+  }
+
+  free_TIFF(&(output_img));
+  ProgressiveFillFree(&pf);
   return EXIT_SUCCESS;
 }
 
 int main(int argc, char **argv) {
   FILE *fp;
   struct TIFF_img input_img;
+  struct map_params map;
+  int denoise = 0, rle_output = 0, count_only = 0;
+  struct region_outputs ro = {0, 0, 1, HUGE_VAL, 0.0, 0, POLY_WKT, 0.0,
+                              0, 0, 0, 0, 0, 1, NULL};
+  const char *engine = "dfs";
+  const char *seed_file = NULL;
+  double *fill_thresholds = NULL;
+  int nfill_thresholds = 0;
+  int tile_size = TILE_SIZE;
+  unsigned int neighborhood = NB_4;
+  const char *connectivity = NULL;
+  int volume = 0, volume_connectivity = VOL_6;
 
-  if (argc != 3) {
+  if (argc < 3) {
     print_usage(argv[0]);
     return EXIT_FAILURE;
   }
 
   double threshold = atof(argv[2]);
 
+  // parse options
+  map_default_params(&map);
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "--denoise") == 0) {
+      denoise = 1;
+    } else if (strcmp(argv[i], "--count-only") == 0) {
+      count_only = 1;
+    } else if (strcmp(argv[i], "--volume") == 0) {
+      volume = 1;
+    } else if (strcmp(argv[i], "--rag") == 0) {
+      ro.rag = 1;
+    } else if (i + 1 < argc && strcmp(argv[i], "--merge-regions") == 0) {
+      ro.merge = 1;
+      ro.merge_regions = (unsigned int)atoi(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--merge-cost") == 0) {
+      ro.merge = 1;
+      ro.merge_cost = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--size-penalty") == 0) {
+      ro.size_penalty = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--contours") == 0) {
+      const char *format = argv[++i];
+      ro.contours = 1;
+      if (strcmp(format, "wkt") == 0) {
+        ro.polygon_format = POLY_WKT;
+      } else if (strcmp(format, "geojson") == 0) {
+        ro.polygon_format = POLY_GEOJSON;
+      } else {
+        fprintf(stderr, "Error: unknown polygon format %s\n", format);
+        return EXIT_FAILURE;
+      }
+    } else if (i + 1 < argc && strcmp(argv[i], "--simplify") == 0) {
+      ro.simplify = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--pixel-index") == 0) {
+      ro.pixel_index = 1;
+    } else if (i + 1 < argc && strcmp(argv[i], "--label-file") == 0) {
+      const char *raster = argv[++i];
+      ro.label_file = 1;
+      if (strcmp(raster, "raw") == 0) {
+        ro.label_rle = 0;
+      } else if (strcmp(raster, "rle") == 0) {
+        ro.label_rle = 1;
+      } else {
+        fprintf(stderr, "Error: unknown label file raster %s\n", raster);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "--region-tree") == 0) {
+      ro.region_tree = 1;
+    } else if (i + 1 < argc && strcmp(argv[i], "--render") == 0) {
+      ro.render = 1;
+      ro.render_seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (i + 1 < argc && strcmp(argv[i], "--denoise-iterations") == 0) {
+      map.max_iterations = atoi(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--denoise-tolerance") == 0) {
+      map.tolerance = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--sigma-n") == 0) {
+      map.sigma_n = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--sigma-x") == 0) {
+      map.sigma_x = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--prior-p") == 0) {
+      map.p = atof(argv[++i]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--engine") == 0) {
+      engine = argv[++i];
+      if (strcmp(engine, "dfs") != 0 && strcmp(engine, "parallel") != 0 &&
+          strcmp(engine, "tile") != 0) {
+        fprintf(stderr, "Error: unknown engine %s\n", engine);
+        return EXIT_FAILURE;
+      }
+    } else if (i + 1 < argc && strcmp(argv[i], "--connectivity") == 0) {
+      connectivity = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--tile-size") == 0) {
+      tile_size = atoi(argv[++i]);
+      if (tile_size <= 0) {
+        fprintf(stderr, "Error: tile size must be positive\n");
+        return EXIT_FAILURE;
+      }
+    } else if (i + 1 < argc && strcmp(argv[i], "--seeds") == 0) {
+      seed_file = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "--seed-output") == 0) {
+      const char *output = argv[++i];
+      if (strcmp(output, "label") == 0) {
+        rle_output = 0;
+      } else if (strcmp(output, "rle") == 0) {
+        rle_output = 1;
+      } else {
+        fprintf(stderr, "Error: unknown seed output %s\n", output);
+        return EXIT_FAILURE;
+      }
+    } else if (i + 1 < argc && strcmp(argv[i], "--fill-thresholds") == 0) {
+      nfill_thresholds = ParseThresholdList(argv[++i], &fill_thresholds);
+      if (nfill_thresholds < 0) {
+        return EXIT_FAILURE;
+      }
+    } else {
+      fprintf(stderr, "Error: unknown option %s\n", argv[i]);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  // a volume has 6, 18 or 26 neighbors, an image a mask of NB_* offsets
+  if (volume && connectivity != NULL) {
+    volume_connectivity = atoi(connectivity);
+    if (volume_connectivity != VOL_6 && volume_connectivity != VOL_18 &&
+        volume_connectivity != VOL_26) {
+      fprintf(stderr, "Error: volume connectivity must be 6, 18 or 26\n");
+      return EXIT_FAILURE;
+    }
+  } else if (connectivity != NULL &&
+             ParseNeighborhood(connectivity, &neighborhood)) {
+    fprintf(stderr, "Error: bad neighborhood %s\n", connectivity);
+    return EXIT_FAILURE;
+  }
+
+  // volumes are labeled by the volume stream only
+  if (volume && (denoise || count_only || ro.rag || ro.merge ||
+                 ro.contours || ro.pixel_index || ro.label_file ||
+                 ro.region_tree || ro.render || seed_file != NULL ||
+                 nfill_thresholds > 0 || strcmp(engine, "dfs") != 0)) {
+    fprintf(stderr,
+            "Error: --volume does not take --denoise, --count-only, --rag, "
+            "--merge-*, --contours, --pixel-index, --label-file, "
+            "--region-tree, --render, --seeds, --fill-thresholds or "
+            "--engine\n");
+    return EXIT_FAILURE;
+  }
+
+  // the remaining engines are 4-connected only
+  if (neighborhood != NB_4 &&
+      (count_only || seed_file != NULL || nfill_thresholds > 0)) {
+    fprintf(stderr,
+            "Error: --count-only, --seeds and --fill-thresholds require "
+            "--connectivity 4\n");
+    return EXIT_FAILURE;
+  }
+
   // open image file
   if ((fp = fopen(argv[1], "rb")) == NULL) {
     fprintf(stderr, "Error: failed to open file %s\n", argv[1]);
     return EXIT_FAILURE;
   }
 
+  int ret;
+  if (volume) {
+    ret = LabelVolume(fp, threshold, volume_connectivity, 100);
+    fclose(fp);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("done\n");
+    return EXIT_SUCCESS;
+  }
+
   // read image
   if (read_TIFF(fp, &input_img)) {
     fprintf(stderr, "Error: failed to read file %s\n", argv[1]);
@@ -320,24 +1474,95 @@ int main(int argc, char **argv) {
 
   // close image file
   fclose(fp);
+  ro.image = &input_img;
 
   // check image data type
-  if (input_img.TIFF_type != 'g') {
-    fprintf(stderr, "Error: image must be 8-bit grayscale\n");
+  if (input_img.TIFF_type != 'g' && input_img.TIFF_type != 'w' &&
+      input_img.TIFF_type != 'f') {
+    fprintf(stderr, "Error: image must be 8-bit, 16-bit or float grayscale\n");
     return EXIT_FAILURE;
   }
 
-  int ret;
-  pixel_t s = {.col = 67, .row = 45};
-  ret =
-      AreaFill(input_img.mono, input_img.width, input_img.height, threshold, s);
-  if (ret == EXIT_FAILURE) {
+  if (input_img.TIFF_type != 'g') {
+    // only the dfs, tile and parallel engines have 16-bit and float kernels
+    if (denoise || count_only || seed_file != NULL || nfill_thresholds > 0) {
+      fprintf(stderr,
+              "Error: --denoise, --count-only, --seeds and --fill-thresholds "
+              "require an 8-bit image\n");
+      return EXIT_FAILURE;
+    }
+    pixel_t s = {.col = 67, .row = 45};
+    ret = AreaFillNative(&input_img, threshold, neighborhood, s);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("finished AreaFill\n");
+    ret = GetAllConnectedSetsNative(&input_img, engine, threshold,
+                                    neighborhood, 100, tile_size, &ro);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("finished GetAllConnectedSets\n");
+    free_TIFF(&(input_img));
+    printf("done\n");
+    return EXIT_SUCCESS;
+  }
+
+  if (denoise) {
+    ret = DenoiseImage(&input_img, &map);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("finished DenoiseImage\n");
+  }
+
+  if (count_only) {
+    ret = CountOnly(input_img.mono, input_img.width, input_img.height,
+                    threshold, 100);
+    free_TIFF(&(input_img));
     return ret;
   }
-  printf("finished AreaFill\n");
 
-  ret = GetAllConnectedSets(input_img.mono, input_img.width, input_img.height,
-                            threshold, 100);
+  if (seed_file != NULL) {
+    ret = SeedFill(input_img.mono, input_img.width, input_img.height,
+                   threshold, seed_file, rle_output);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("finished SeedFill\n");
+  } else if (nfill_thresholds > 0) {
+    pixel_t s = {.col = 67, .row = 45};
+    ret = ProgressiveAreaFill(input_img.mono, input_img.width,
+                              input_img.height, fill_thresholds,
+                              nfill_thresholds, s);
+    free(fill_thresholds);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("finished ProgressiveAreaFill\n");
+  } else {
+    pixel_t s = {.col = 67, .row = 45};
+    ret = AreaFill(input_img.mono, input_img.width, input_img.height,
+                   threshold, neighborhood, s);
+    if (ret == EXIT_FAILURE) {
+      return ret;
+    }
+    printf("finished AreaFill\n");
+  }
+
+  if (strcmp(engine, "parallel") == 0) {
+    ret = GetAllConnectedSetsParallel(input_img.mono, input_img.width,
+                                      input_img.height, threshold,
+                                      neighborhood, 100, &ro);
+  } else if (strcmp(engine, "tile") == 0) {
+    ret = GetAllConnectedSetsTiled(input_img.mono, input_img.width,
+                                   input_img.height, threshold, neighborhood,
+                                   100, tile_size, &ro);
+  } else {
+    ret = GetAllConnectedSets(input_img.mono, input_img.width,
+                              input_img.height, threshold, neighborhood, 100,
+                              &ro);
+  }
   if (ret == EXIT_FAILURE) {
     return ret;
   }
@@ -351,10 +1576,76 @@ int main(int argc, char **argv) {
 }
 
 void print_usage(const char *program_name) {
-  printf("Usage: %s <image-file-path>\n", program_name);
+  printf("Usage: %s <image-file-path> <threshold> [options]\n", program_name);
   printf("Arguments:\n");
   printf("  <image-file-path> : Specify the file path of the image.\n");
   printf(
       "  <threshold> : Specify the threshold number for determining pixel "
       "neighbors.\n");
+  printf("Options:\n");
+  printf("  --denoise : qGGMRF MAP denoising before labeling.\n");
+  printf(
+      "  --count-only : Only print the number of regions and their size "
+      "histogram.\n");
+  printf("  --denoise-iterations <n> : Maximum number of ICM sweeps.\n");
+  printf(
+      "  --denoise-tolerance <t> : Stop when the mean pixel update is below "
+      "t.\n");
+  printf("  --sigma-n <s> : Standard deviation of the noise.\n");
+  printf("  --sigma-x <s> : Scale parameter of the qGGMRF prior.\n");
+  printf("  --prior-p <p> : Shape parameter p of the qGGMRF prior.\n");
+  printf(
+      "  --engine <dfs|parallel|tile> : Labeling engine used for the "
+      "segmentation.\n");
+  printf(
+      "  --connectivity <4|8|mask> : Neighborhood of a pixel; mask is nine "
+      "0/1 digits of the 3x3 window, e.g. 000101000.\n");
+  printf(
+      "  --volume : Label the pages of the file as the slices of a volume; "
+      "--connectivity is then 6, 18 or 26 (default 6).\n");
+  printf(
+      "  --rag : Also write the region adjacency graph of the segmentation "
+      "to rag_<threshold>.bin.\n");
+  printf(
+      "  --merge-regions <n> : Merge the most similar adjacent regions until "
+      "n are left, into merged_<threshold>.tif, and write the merge "
+      "sequence to merge_<threshold>.bin.\n");
+  printf(
+      "  --merge-cost <c> : Merge as long as the dissimilarity is at most "
+      "c.\n");
+  printf(
+      "  --size-penalty <w> : Add w * log2 of the smaller size to the mean "
+      "difference of two regions (default 0).\n");
+  printf(
+      "  --contours <wkt|geojson> : Trace the region boundaries into "
+      "contours_<threshold>.chain and .wkt or .geojson, in pixel-corner "
+      "coordinates with y down.\n");
+  printf(
+      "  --simplify <t> : Douglas-Peucker tolerance of the polygons in "
+      "pixels (default 0, every corner); a ring that would collapse or "
+      "cross itself keeps every corner.\n");
+  printf(
+      "  --pixel-index : Also write segmentation_<threshold>.pix, the "
+      "pixels of every label for mapping.\n");
+  printf(
+      "  --label-file <raw|rle> : Also write segmentation_<threshold>.lbl, "
+      "labels, region statistics and pixel index in one mappable file.\n");
+  printf(
+      "  --region-tree : Also write segmentation_<threshold>.rtree, an R-tree "
+      "of the region boxes and centroids for mapping.\n");
+  printf(
+      "  --render <seed> : Also write scrambled_segmentation_<threshold>.tif, "
+      "the labels in random colors of seed.\n");
+  printf(
+      "  --tile-size <n> : Side of the square tiles of the tile engine "
+      "(default 128).\n");
+  printf(
+      "  --seeds <file> : Area fill from every \"col row\" seed in file "
+      "instead of the default seed.\n");
+  printf(
+      "  --seed-output <label|rle> : Write the seed fills as one label image "
+      "or as per-seed run-length masks.\n");
+  printf(
+      "  --fill-thresholds <T1,T2,...> : Area fill of the default seed at "
+      "every listed threshold, growing one region progressively.\n");
 }
@@ -0,0 +1,535 @@
+#include "contour.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "neighborhood.h"
+
+/* Steps of the chain codes, and for a trace that has reached a vertex
+ * heading in direction d, the offsets from the vertex of the pixels
+ * ahead of it to the right and to the left, and the diagonal between the
+ * pixel behind on the right and the pixel ahead on the left. */
+static const int step_x[4] = {1, 0, -1, 0};
+static const int step_y[4] = {0, -1, 0, 1};
+static const int right_x[4] = {0, 0, -1, -1};
+static const int right_y[4] = {0, -1, -1, 0};
+static const int left_x[4] = {0, -1, -1, 0};
+static const int left_y[4] = {-1, -1, 0, 0};
+static const unsigned int diagonal[4] = {NB_NE | NB_SW, NB_NW | NB_SE,
+                                         NB_NE | NB_SW, NB_NW | NB_SE};
+
+int ContourTracerInit(struct contour_tracer *ct, unsigned int **seg,
+                      int width, int height, unsigned int neighborhood) {
+  size_t words = ((size_t)width * height + 63) / 64;
+
+  ct->seg = seg;
+  ct->width = width;
+  ct->height = height;
+  ct->nb = nb_symmetric(neighborhood);
+  ct->x = ct->y = 0;
+  ct->visited = (uint64_t *)get_spc(words, sizeof(uint64_t));
+  ct->cap = 1024;
+  ct->code = (uint8_t *)mget_spc(ct->cap, sizeof(uint8_t));
+  return 0;
+}
+
+void ContourTracerFree(struct contour_tracer *ct) {
+  free(ct->visited);
+  free(ct->code);
+}
+
+static inline int InRegion(const struct contour_tracer *ct, int x, int y,
+                           unsigned int label) {
+  return x >= 0 && y >= 0 && x < ct->width && y < ct->height &&
+         ct->seg[y][x] == label;
+}
+
+static inline int Visited(const struct contour_tracer *ct, int x, int y) {
+  size_t i = (size_t)y * ct->width + x;
+  return (ct->visited[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void MarkVisited(struct contour_tracer *ct, int x, int y) {
+  size_t i = (size_t)y * ct->width + x;
+  ct->visited[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+static void AppendCode(struct contour_tracer *ct, uint32_t n, int d) {
+  if (n == ct->cap) {
+    ct->cap *= 2;
+    ct->code = (uint8_t *)realloc(ct->code, ct->cap);
+    if (ct->code == NULL) {
+      fprintf(stderr, "AppendCode(): realloc() error\n");
+      exit(-1);
+    }
+  }
+  ct->code[n] = (uint8_t)d;
+}
+
+/* Walks the boundary whose first crack is the top of pixel (x0, y0) */
+static void Trace(struct contour_tracer *ct, int x0, int y0,
+                  struct contour *c) {
+  unsigned int label = ct->seg[y0][x0];
+  int x = x0 + 1, y = y0, d = CHAIN_E;
+  uint32_t n = 0;
+  long area2 = -(long)y0; /* shoelace term of the first crack */
+
+  MarkVisited(ct, x0, y0);
+  AppendCode(ct, n++, CHAIN_E);
+  for (;;) {
+    int ar = InRegion(ct, x + right_x[d], y + right_y[d], label);
+    int al = InRegion(ct, x + left_x[d], y + left_y[d], label);
+    int next;
+
+    // turn left around the pixel ahead on the left, go straight along the
+    // pixel ahead on the right, or turn right around the pixel behind
+    if (al && (ar || (ct->nb & diagonal[d])))
+      next = (d + 1) % 4;
+    else if (ar)
+      next = d;
+    else
+      next = (d + 3) % 4;
+    if (x == x0 && y == y0 && next == CHAIN_E) break;
+
+    if (next == CHAIN_E) MarkVisited(ct, x, y);
+    AppendCode(ct, n++, next);
+    area2 += (long)x * step_y[next] - (long)y * step_x[next];
+    x += step_x[next];
+    y += step_y[next];
+    d = next;
+  }
+  c->label = label;
+  c->x0 = x0;
+  c->y0 = y0;
+  c->n = n;
+  c->code = ct->code;
+  c->area = area2 / 2;
+  c->hole = c->area < 0;
+}
+
+int NextContour(struct contour_tracer *ct, struct contour *c) {
+  for (; ct->y < ct->height; ct->y++, ct->x = 0) {
+    const unsigned int *row = ct->seg[ct->y];
+    const unsigned int *up = (ct->y > 0) ? ct->seg[ct->y - 1] : NULL;
+    for (; ct->x < ct->width; ct->x++) {
+      unsigned int l = row[ct->x];
+      if (l == 0 || (up != NULL && up[ct->x] == l)) continue;
+      if (Visited(ct, ct->x, ct->y)) continue;
+      Trace(ct, ct->x++, ct->y, c);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int WriteChainCode(FILE *fp, const struct contour *c) {
+  fprintf(fp, "%u %d %d %d %u ", c->label, c->hole, c->x0, c->y0, c->n);
+  for (uint32_t i = 0; i < c->n; i++) fputc('0' + c->code[i], fp);
+  if (fputc('\n', fp) == EOF) {
+    fprintf(stderr, "WriteChainCode(): write error\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Distance of point p from the line through a and b */
+static double LineDistance(const int32_t *a, const int32_t *b,
+                           const int32_t *p) {
+  double dx = b[0] - a[0], dy = b[1] - a[1];
+  double len = sqrt(dx * dx + dy * dy);
+
+  if (len == 0) return hypot(p[0] - a[0], p[1] - a[1]);
+  return fabs(dy * (p[0] - a[0]) - dx * (p[1] - a[1])) / len;
+}
+
+/* Douglas-Peucker over corners p[i0 .. i1], marking the kept ones.  The
+ * farthest corner is kept without regard to tolerance if force is set. */
+static void Simplify(const int32_t *p, uint32_t i0, uint32_t i1,
+                     double tolerance, int force, uint8_t *keep) {
+  uint32_t stack[64][2], n = 0;
+
+  stack[n][0] = i0;
+  stack[n++][1] = i1;
+  while (n > 0) {
+    uint32_t a, b, k;
+    double dmax = -1;
+
+    n--;
+    a = k = stack[n][0];
+    b = stack[n][1];
+    for (uint32_t i = a + 1; i < b; i++) {
+      double dist = LineDistance(p + 2 * a, p + 2 * b, p + 2 * i);
+      if (dist > dmax) {
+        dmax = dist;
+        k = i;
+      }
+    }
+    if (k == a || (dmax <= tolerance && !force)) continue;
+    force = 0;
+    keep[k] = 1;
+    // the longer half is pushed first and the shorter one split next, so
+    // the stack never holds more than log2(i1 - i0) + 1 ranges
+    if (k - a > b - k) {
+      stack[n][0] = a;
+      stack[n++][1] = k;
+      stack[n][0] = k;
+      stack[n++][1] = b;
+    } else {
+      stack[n][0] = k;
+      stack[n++][1] = b;
+      stack[n][0] = a;
+      stack[n++][1] = k;
+    }
+  }
+}
+
+struct ring_segment {
+  int32_t x0, y0, x1, y1; /* x0 <= x1 */
+  uint32_t i;             /* segment i joins kept corners i and i + 1 */
+};
+
+static int CompareSegments(const void *a, const void *b) {
+  int32_t x = ((const struct ring_segment *)a)->x0;
+  int32_t y = ((const struct ring_segment *)b)->x0;
+  return (x > y) - (x < y);
+}
+
+/* Sign of the turn from a -> b to a -> c */
+static int Turn(int32_t ax, int32_t ay, int32_t bx, int32_t by, int32_t cx,
+                int32_t cy) {
+  int64_t t = (int64_t)(bx - ax) * (cy - ay) - (int64_t)(by - ay) * (cx - ax);
+  return (t > 0) - (t < 0);
+}
+
+/* 1 if c, on the line through a and b, is within their box */
+static int OnSegment(int32_t ax, int32_t ay, int32_t bx, int32_t by,
+                     int32_t cx, int32_t cy) {
+  return ((cx >= ax && cx <= bx) || (cx >= bx && cx <= ax)) &&
+         ((cy >= ay && cy <= by) || (cy >= by && cy <= ay));
+}
+
+/* 1 if segments s and t have a point in common */
+static int SegmentsMeet(const struct ring_segment *s,
+                        const struct ring_segment *t) {
+  int d1 = Turn(s->x0, s->y0, s->x1, s->y1, t->x0, t->y0);
+  int d2 = Turn(s->x0, s->y0, s->x1, s->y1, t->x1, t->y1);
+  int d3 = Turn(t->x0, t->y0, t->x1, t->y1, s->x0, s->y0);
+  int d4 = Turn(t->x0, t->y0, t->x1, t->y1, s->x1, s->y1);
+
+  if (d1 * d2 < 0 && d3 * d4 < 0) return 1;
+  return (d1 == 0 && OnSegment(s->x0, s->y0, s->x1, s->y1, t->x0, t->y0)) ||
+         (d2 == 0 && OnSegment(s->x0, s->y0, s->x1, s->y1, t->x1, t->y1)) ||
+         (d3 == 0 && OnSegment(t->x0, t->y0, t->x1, t->y1, s->x0, s->y0)) ||
+         (d4 == 0 && OnSegment(t->x0, t->y0, t->x1, t->y1, s->x1, s->y1));
+}
+
+/* 1 if the kept corners of p[0 .. m], a closed ring, enclose an area of
+ * the sign of area without the ring folding back or crossing itself.  The
+ * segments are swept by x, so only those whose x ranges overlap are
+ * tested against each other. */
+static int SimpleRing(const int32_t *p, const uint8_t *keep, uint32_t m,
+                      long area) {
+  uint32_t *k = (uint32_t *)mget_spc((size_t)m + 1, sizeof(uint32_t));
+  struct ring_segment *seg;
+  uint32_t n = 0, nseg;
+  int64_t area2 = 0;
+  int ok = 1;
+
+  for (uint32_t i = 0; i <= m; i++) {
+    if (keep[i]) k[n++] = i;
+  }
+  nseg = n - 1;
+  for (uint32_t i = 0; i < nseg; i++) {
+    const int32_t *a = p + 2 * k[i], *b = p + 2 * k[i + 1];
+    area2 += (int64_t)a[0] * b[1] - (int64_t)b[0] * a[1];
+  }
+  if (nseg < 3 || area2 == 0 || (area2 > 0) != (area > 0)) {
+    free(k);
+    return 0;
+  }
+
+  // a corner where the ring turns straight back collapses it
+  for (uint32_t i = 0; i < nseg && ok; i++) {
+    const int32_t *a = p + 2 * k[i == 0 ? nseg - 1 : i - 1];
+    const int32_t *b = p + 2 * k[i], *c = p + 2 * k[i + 1];
+    if (Turn(a[0], a[1], b[0], b[1], c[0], c[1]) == 0 &&
+        (int64_t)(b[0] - a[0]) * (c[0] - b[0]) +
+                (int64_t)(b[1] - a[1]) * (c[1] - b[1]) < 0)
+      ok = 0;
+  }
+
+  seg = (struct ring_segment *)mget_spc(nseg, sizeof(struct ring_segment));
+  for (uint32_t i = 0; i < nseg; i++) {
+    const int32_t *a = p + 2 * k[i], *b = p + 2 * k[i + 1];
+    int swap = a[0] > b[0];
+    seg[i].x0 = swap ? b[0] : a[0];
+    seg[i].y0 = swap ? b[1] : a[1];
+    seg[i].x1 = swap ? a[0] : b[0];
+    seg[i].y1 = swap ? a[1] : b[1];
+    seg[i].i = i;
+  }
+  qsort(seg, nseg, sizeof(struct ring_segment), CompareSegments);
+  for (uint32_t i = 0; i < nseg && ok; i++) {
+    for (uint32_t j = i + 1; j < nseg && seg[j].x0 <= seg[i].x1; j++) {
+      uint32_t d = (seg[i].i > seg[j].i) ? seg[i].i - seg[j].i
+                                         : seg[j].i - seg[i].i;
+      // neighbors in the ring share a corner
+      if (d == 1 || d == nseg - 1) continue;
+      if (SegmentsMeet(&seg[i], &seg[j])) {
+        ok = 0;
+        break;
+      }
+    }
+  }
+  free(seg);
+  free(k);
+  return ok;
+}
+
+uint32_t SimplifyContour(const struct contour *c, double tolerance,
+                         int32_t *xy) {
+  int32_t x = c->x0, y = c->y0, *p = xy;
+  uint32_t m = 0, far = 0, out = 0;
+  uint8_t *keep;
+  double dmax = -1;
+
+  // corners are the vertices where the chain turns
+  for (uint32_t i = 0; i < c->n; i++) {
+    uint8_t prev = c->code[(i + c->n - 1) % c->n];
+    if (c->code[i] != prev) {
+      p[2 * m] = x;
+      p[2 * m + 1] = y;
+      m++;
+    }
+    x += step_x[c->code[i]];
+    y += step_y[c->code[i]];
+  }
+  p[2 * m] = p[0];
+  p[2 * m + 1] = p[1];
+
+  // split the ring at its first corner and the corner farthest from it
+  keep = (uint8_t *)get_spc((size_t)m + 1, sizeof(uint8_t));
+  for (uint32_t i = 1; i < m; i++) {
+    double dist = hypot(p[2 * i] - p[0], p[2 * i + 1] - p[1]);
+    if (dist > dmax) {
+      dmax = dist;
+      far = i;
+    }
+  }
+  keep[0] = keep[far] = keep[m] = 1;
+  Simplify(p, 0, far, tolerance, 1, keep);
+  Simplify(p, far, m, tolerance, 1, keep);
+
+  // a ring that simplification made collapse, fold back or cross itself
+  // is written unsimplified; the crack boundary itself is never checked
+  {
+    uint32_t nkeep = 0;
+    for (uint32_t i = 0; i <= m; i++) nkeep += keep[i];
+    if (nkeep < m + 1 && !SimpleRing(p, keep, m, c->area))
+      memset(keep, 1, (size_t)m + 1);
+  }
+
+  for (uint32_t i = 0; i <= m; i++) {
+    if (!keep[i]) continue;
+    xy[2 * out] = p[2 * i];
+    xy[2 * out + 1] = p[2 * i + 1];
+    out++;
+  }
+  free(keep);
+  return out;
+}
+
+struct polygon_ring {
+  struct polygon_ring *next;
+  int hole;
+  uint32_t n;
+  int32_t xy[]; /* n points, the last one equal to the first */
+};
+
+int PolygonWriterInit(struct polygon_writer *pw, FILE *fp, int format,
+                      double tolerance, unsigned int **seg, int width,
+                      int height, unsigned int nlabels) {
+  pw->fp = fp;
+  pw->format = format;
+  pw->tolerance = tolerance;
+  pw->last_row = (uint32_t *)get_spc((size_t)nlabels + 1, sizeof(uint32_t));
+  pw->rings = (struct polygon_ring **)get_spc((size_t)nlabels + 1,
+                                              sizeof(struct polygon_ring *));
+  pw->pending = (uint32_t *)mget_spc((size_t)nlabels + 1, sizeof(uint32_t));
+  pw->npending = 0;
+  pw->cap = 1024;
+  pw->xy = (int32_t *)mget_spc(2 * (size_t)pw->cap, sizeof(int32_t));
+  pw->npolygons = 0;
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) pw->last_row[seg[y][x]] = y;
+  }
+
+  if (format == POLY_GEOJSON)
+    fprintf(fp, "{\"type\": \"FeatureCollection\", \"features\": [");
+  return 0;
+}
+
+/* Even-odd test of point (x, y) against ring r */
+static int InsideRing(const struct polygon_ring *r, double x, double y) {
+  int in = 0;
+
+  for (uint32_t i = 0; i + 1 < r->n; i++) {
+    double x1 = r->xy[2 * i], y1 = r->xy[2 * i + 1];
+    double x2 = r->xy[2 * i + 2], y2 = r->xy[2 * i + 3];
+    if ((y1 > y) != (y2 > y) && x < x1 + (y - y1) * (x2 - x1) / (y2 - y1))
+      in = !in;
+  }
+  return in;
+}
+
+static void WriteRing(FILE *fp, int format, const struct polygon_ring *r) {
+  fputs(format == POLY_GEOJSON ? "[" : "(", fp);
+  for (uint32_t i = 0; i < r->n; i++) {
+    if (format == POLY_GEOJSON)
+      fprintf(fp, "%s[%d, %d]", i ? ", " : "", r->xy[2 * i], r->xy[2 * i + 1]);
+    else
+      fprintf(fp, "%s%d %d", i ? ", " : "", r->xy[2 * i], r->xy[2 * i + 1]);
+  }
+  fputs(format == POLY_GEOJSON ? "]" : ")", fp);
+}
+
+/* Writes the polygon of outer ring o with its holes among the rings from
+ * first on.  A hole belongs to the first outer ring that holds the pixel
+ * at its first corner, or to the first outer ring if none does. */
+static void WritePolygon(FILE *fp, int format, const struct polygon_ring *o,
+                         const struct polygon_ring *first) {
+  const struct polygon_ring *h;
+
+  fputs(format == POLY_GEOJSON ? "[" : "(", fp);
+  WriteRing(fp, format, o);
+  for (h = first; h != NULL; h = h->next) {
+    const struct polygon_ring *owner = first, *r;
+    if (!h->hole) continue;
+    for (r = first; r != NULL; r = r->next) {
+      if (!r->hole && InsideRing(r, h->xy[0] + 0.5, h->xy[1] + 0.5)) {
+        owner = r;
+        break;
+      }
+    }
+    if (owner != o) continue;
+    fputs(", ", fp);
+    WriteRing(fp, format, h);
+  }
+  fputs(format == POLY_GEOJSON ? "]" : ")", fp);
+}
+
+/* Writes the polygon of label l, a MultiPolygon if it has several outer
+ * rings, and frees its rings.  The first ring of a label is always outer,
+ * since no boundary of the label is above its top pixel. */
+static void FlushLabel(struct polygon_writer *pw, uint32_t l) {
+  struct polygon_ring *first = pw->rings[l], *r, *next;
+  int nouter = 0;
+  FILE *fp = pw->fp;
+  int json = (pw->format == POLY_GEOJSON);
+
+  for (r = first; r != NULL; r = r->next) nouter += !r->hole;
+
+  if (json) {
+    fprintf(fp,
+            "%s\n{\"type\": \"Feature\", \"properties\": {\"label\": %u}, "
+            "\"geometry\": {\"type\": \"%s\", \"coordinates\": ",
+            pw->npolygons ? "," : "", l,
+            nouter > 1 ? "MultiPolygon" : "Polygon");
+  } else {
+    fprintf(fp, "%u\t%s ", l, nouter > 1 ? "MULTIPOLYGON" : "POLYGON");
+  }
+  if (nouter > 1) {
+    fputs(json ? "[" : "(", fp);
+    for (r = first; r != NULL; r = r->next) {
+      if (r->hole) continue;
+      if (r != first) fputs(", ", fp);
+      WritePolygon(fp, pw->format, r, first);
+    }
+    fputs(json ? "]" : ")", fp);
+  } else {
+    WritePolygon(fp, pw->format, first, first);
+  }
+  fputs(json ? "}}" : "\n", fp);
+  pw->npolygons++;
+
+  for (r = first; r != NULL; r = next) {
+    next = r->next;
+    free(r);
+  }
+  pw->rings[l] = NULL;
+}
+
+static int CompareLabels(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* Writes the polygons of the pending labels whose last row is above row,
+ * in label order */
+static void FlushPending(struct polygon_writer *pw, long row) {
+  uint32_t i, n = 0, done = 0;
+
+  // move the finished labels to the end, keeping the others in order
+  for (i = 0; i < pw->npending; i++) {
+    if ((long)pw->last_row[pw->pending[i]] < row) done++;
+  }
+  if (done == 0) return;
+  {
+    uint32_t *finished = (uint32_t *)mget_spc(done, sizeof(uint32_t));
+    uint32_t k = 0;
+    for (i = 0; i < pw->npending; i++) {
+      uint32_t l = pw->pending[i];
+      if ((long)pw->last_row[l] < row)
+        finished[k++] = l;
+      else
+        pw->pending[n++] = l;
+    }
+    pw->npending = n;
+    qsort(finished, done, sizeof(uint32_t), CompareLabels);
+    for (k = 0; k < done; k++) FlushLabel(pw, finished[k]);
+    free(finished);
+  }
+}
+
+int PolygonWriterAdd(struct polygon_writer *pw, const struct contour *c) {
+  struct polygon_ring *r, **tail;
+  uint32_t n;
+
+  FlushPending(pw, c->y0);
+  if (c->n + 1 > pw->cap) {
+    pw->cap = c->n + 1;
+    free(pw->xy);
+    pw->xy = (int32_t *)mget_spc(2 * (size_t)pw->cap, sizeof(int32_t));
+  }
+  n = SimplifyContour(c, pw->tolerance, pw->xy);
+  r = (struct polygon_ring *)mget_spc(1, sizeof(*r) + 2 * n * sizeof(int32_t));
+  r->next = NULL;
+  r->hole = c->hole;
+  r->n = n;
+  memcpy(r->xy, pw->xy, 2 * n * sizeof(int32_t));
+
+  if (pw->rings[c->label] == NULL) pw->pending[pw->npending++] = c->label;
+  for (tail = &pw->rings[c->label]; *tail != NULL; tail = &(*tail)->next) {
+  }
+  *tail = r;
+  return 0;
+}
+
+int PolygonWriterFinish(struct polygon_writer *pw) {
+  int ret = 0;
+
+  FlushPending(pw, (long)UINT32_MAX + 1);
+  if (pw->format == POLY_GEOJSON) fprintf(pw->fp, "\n]}\n");
+  if (ferror(pw->fp)) {
+    fprintf(stderr, "PolygonWriterFinish(): write error\n");
+    ret = -1;
+  }
+  free(pw->last_row);
+  free(pw->rings);
+  free(pw->pending);
+  free(pw->xy);
+  return ret;
+}
@@ -0,0 +1,107 @@
+#ifndef _CONTOUR_H_
+#define _CONTOUR_H_
+
+#include <stdio.h>
+
+#include "typeutil.h"
+
+/* Boundaries of the regions of a label image, traced along the cracks
+ * between pixels.
+ *
+ * The contours are found in a single raster scan of the label buffer.
+ * Every closed boundary of a region, outer or around a hole, has a crack
+ * along the top of one of its pixels, so the scan starts a trace at the
+ * first pixel whose top crack is a boundary not yet walked.  The trace
+ * follows the boundary once around, with the region on its right, and
+ * marks the top cracks it walks in a bitmap of one bit per pixel; no
+ * region is ever scanned again.  Each contour is handed to the caller as
+ * soon as it is traced, and only the longest contour is kept in memory.
+ *
+ * Where two pixels of a region touch only at a corner, the trace goes
+ * around both if the neighborhood (see neighborhood.h) holds that
+ * diagonal, and around each separately otherwise.  Pixels of label 0 are
+ * not part of any region.
+ *
+ * A contour is a Freeman chain code of the cracks: 0 east, 1 north, 2
+ * west and 3 south, with y growing down, from the top-left corner of its
+ * first pixel.  Outer boundaries run clockwise on the screen, holes
+ * counterclockwise. */
+
+#define CHAIN_E 0
+#define CHAIN_N 1
+#define CHAIN_W 2
+#define CHAIN_S 3
+
+struct contour {
+  uint32_t label;
+  int hole;      /* 1 for the boundary of a hole in the region */
+  int x0, y0;    /* start vertex                               */
+  uint32_t n;    /* number of cracks                           */
+  uint8_t *code; /* n chain codes                              */
+  long area;     /* enclosed area, negative for a hole         */
+};
+
+struct contour_tracer {
+  unsigned int **seg;
+  int width, height;
+  unsigned int nb;
+  int x, y;           /* next pixel of the scan              */
+  uint64_t *visited;  /* walked top cracks, one bit a pixel  */
+  uint8_t *code;      /* chain of the last contour           */
+  uint32_t cap;
+};
+
+int ContourTracerInit(struct contour_tracer *ct, unsigned int **seg,
+                      int width, int height, unsigned int neighborhood);
+/* Traces the next contour in scan order into c, whose code stays valid
+ * until the next call.  Returns 1, or 0 when all contours are done. */
+int NextContour(struct contour_tracer *ct, struct contour *c);
+void ContourTracerFree(struct contour_tracer *ct);
+
+/* Writes c as one line: label, 0 for outer or 1 for a hole, x0, y0, n,
+ * and the chain as n digits */
+int WriteChainCode(FILE *fp, const struct contour *c);
+
+/* Writes the corners of c, simplified by Douglas-Peucker with tolerance
+ * in pixels, as x, y pairs to xy, which holds 2 * (c->n + 1) values.  The
+ * ring is closed, its last point being its first.  If the simplified ring
+ * has fewer than three corners, no area, the orientation opposite to c,
+ * or a corner where it turns straight back, or if any two of its edges
+ * that are not neighbors meet, all corners of c are written instead.
+ * Returns the number of points. */
+uint32_t SimplifyContour(const struct contour *c, double tolerance,
+                         int32_t *xy);
+
+/* Polygon output, one polygon per label with its holes.  The polygons are
+ * written once the scan is past the last row of their label, so only the
+ * rings of labels that span the current row are kept.
+ *
+ * Coordinates are the pixel corners of the image, (0, 0) at the top-left
+ * corner of the first pixel, x to the right and y down, in both formats;
+ * no geographic transform is applied.  Taken as plain x, y numbers, outer
+ * rings are counterclockwise and holes clockwise, as RFC 7946 requires of
+ * GeoJSON, which is clockwise and counterclockwise on the screen. */
+#define POLY_WKT 0     /* one line per label: label, tab, WKT polygon */
+#define POLY_GEOJSON 1 /* a GeoJSON FeatureCollection                 */
+
+struct polygon_ring;
+
+struct polygon_writer {
+  FILE *fp;
+  int format;
+  double tolerance;
+  uint32_t *last_row;            /* of every label            */
+  struct polygon_ring **rings;   /* pending rings by label    */
+  uint32_t *pending, npending;   /* labels with pending rings */
+  int32_t *xy;                   /* scratch points            */
+  uint32_t cap;
+  long npolygons;
+};
+
+int PolygonWriterInit(struct polygon_writer *pw, FILE *fp, int format,
+                      double tolerance, unsigned int **seg, int width,
+                      int height, unsigned int nlabels);
+int PolygonWriterAdd(struct polygon_writer *pw, const struct contour *c);
+int PolygonWriterFinish(struct polygon_writer *pw);
+
+#endif /* _CONTOUR_H_ */
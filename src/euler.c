@@ -0,0 +1,311 @@
+#include "euler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocate.h"
+#include "neighborhood.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Rows of windows counted by one task.  A task packs its rows once, and
+ * the row above it once more. */
+#define EULER_BAND_ROWS 64
+
+static inline int Popcount64(uint64_t x) {
+#if defined(__GNUC__) && defined(__POPCNT__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ull);
+  x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return (int)((x * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/* The Makefile builds for any x86-64, which may lack the POPCNT
+ * instruction, so on x86 a second copy of the row kernel is compiled for
+ * POPCNT and picked at run time when the CPU has it. */
+#if defined(__GNUC__) && !defined(__POPCNT__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define EULER_POPCNT_DISPATCH
+#endif
+
+/* Bit j of the result is set if p[j] is nonzero.  The eight bytes are
+ * folded onto the low bit of each byte, and the multiply gathers those
+ * bits into the top byte without carries. */
+static inline uint64_t PackBytes8(const unsigned char *p) {
+  uint64_t v = (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 |
+               (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32 |
+               (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 |
+               (uint64_t)p[7] << 56;
+
+  v |= v >> 4;
+  v |= v >> 2;
+  v |= v >> 1;
+  v &= 0x0101010101010101ull;
+  return (v * 0x0102040810204080ull) >> 56;
+}
+
+/* Packs row into nwords words, pixel x at bit x % 64 of word x / 64; the
+ * bits past the row are cleared.  With SSE2, which every x86-64 has, 16
+ * pixels are compared with zero at a time and pmovmskb gathers the
+ * results, five times the rate of PackBytes8. */
+static void PackRow(const unsigned char *row, int width, uint64_t *bits,
+                    int nwords) {
+  int x = 0, k = 0;
+
+  for (; x + 64 <= width; x += 64, k++) {
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t w = 0;
+    for (int j = 0; j < 4; j++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(row + x + 16 * j));
+      w |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))
+           << (16 * j);
+    }
+    bits[k] = ~w; /* the zero pixels were set */
+#else
+    uint64_t w = 0;
+    for (int j = 0; j < 8; j++) w |= PackBytes8(row + x + 8 * j) << (8 * j);
+    bits[k] = w;
+#endif
+  }
+  for (; k < nwords; k++) bits[k] = 0;
+  for (; x < width; x++) {
+    if (row[x]) bits[x / 64] |= (uint64_t)1 << (x % 64);
+  }
+}
+
+/* Adds the windows over rows a and b to q.  Window i covers pixels i - 1
+ * and i of both rows, so the left pixels are the rows shifted up by one
+ * bit, with the top bit of the previous word shifted in.  hw is a
+ * constant in every caller; it selects __builtin_popcountll, which is the
+ * POPCNT instruction in a function compiled for it, over Popcount64. */
+static inline __attribute__((always_inline)) void CountRowPairWith(
+    const uint64_t *a, const uint64_t *b, int nwords, struct bit_quads *q,
+    const int hw) {
+  uint64_t carry_a = 0, carry_b = 0;
+  uint64_t q1 = 0, q3 = 0, qd_main = 0, qd_anti = 0;
+
+  for (int k = 0; k < nwords; k++) {
+    uint64_t a1 = a[k], b1 = b[k];
+    uint64_t a0 = (a1 << 1) | carry_a, b0 = (b1 << 1) | carry_b;
+    uint64_t sa = a0 ^ a1, sb = b0 ^ b1; /* one pixel set in the row  */
+    uint64_t pair = (a0 & a1) | (b0 & b1); /* a row with both set     */
+    uint64_t odd = sa ^ sb, diagonal = sa & sb;
+
+    carry_a = a1 >> 63;
+    carry_b = b1 >> 63;
+    if (hw) {
+      q1 += __builtin_popcountll(odd & ~pair);
+      q3 += __builtin_popcountll(odd & pair);
+      qd_main += __builtin_popcountll(diagonal & a0 & b1);
+      qd_anti += __builtin_popcountll(diagonal & a1 & b0);
+    } else {
+      q1 += Popcount64(odd & ~pair);
+      q3 += Popcount64(odd & pair);
+      qd_main += Popcount64(diagonal & a0 & b1);
+      qd_anti += Popcount64(diagonal & a1 & b0);
+    }
+  }
+  q->q1 += q1;
+  q->q3 += q3;
+  q->qd_main += qd_main;
+  q->qd_anti += qd_anti;
+}
+
+typedef void (*row_pair_fn)(const uint64_t *a, const uint64_t *b,
+                            int nwords, struct bit_quads *q);
+
+static void CountRowPair(const uint64_t *a, const uint64_t *b, int nwords,
+                         struct bit_quads *q) {
+  CountRowPairWith(a, b, nwords, q, 0);
+}
+
+#ifdef EULER_POPCNT_DISPATCH
+__attribute__((target("popcnt"))) static void CountRowPairPopcnt(
+    const uint64_t *a, const uint64_t *b, int nwords, struct bit_quads *q) {
+  CountRowPairWith(a, b, nwords, q, 1);
+}
+#endif
+
+static row_pair_fn SelectRowPair(void) {
+#ifdef EULER_POPCNT_DISPATCH
+  if (__builtin_cpu_supports("popcnt")) return CountRowPairPopcnt;
+#endif
+  return CountRowPair;
+}
+
+void CountBitQuads(unsigned char **mask, int width, int height,
+                   struct bit_quads *q) {
+  /* windows 0 .. width, the last one over the right border */
+  int nwords = width / 64 + 1;
+  int nbands = height / EULER_BAND_ROWS + 1;
+  uint64_t q1 = 0, q3 = 0, qd_main = 0, qd_anti = 0;
+  row_pair_fn count_row_pair = SelectRowPair();
+
+#pragma omp parallel reduction(+ : q1, q3, qd_main, qd_anti)
+  {
+    uint64_t *up = (uint64_t *)mget_spc(nwords, sizeof(uint64_t));
+    uint64_t *lo = (uint64_t *)mget_spc(nwords, sizeof(uint64_t));
+
+#pragma omp for schedule(static)
+    for (int band = 0; band < nbands; band++) {
+      /* window rows y0 .. y1 - 1, window row y over pixel rows y - 1, y */
+      int y0 = band * EULER_BAND_ROWS;
+      int y1 = (y0 + EULER_BAND_ROWS < height + 1) ? y0 + EULER_BAND_ROWS
+                                                   : height + 1;
+      struct bit_quads t = {0, 0, 0, 0};
+
+      if (y0 > 0)
+        PackRow(mask[y0 - 1], width, up, nwords);
+      else
+        for (int k = 0; k < nwords; k++) up[k] = 0;
+      for (int y = y0; y < y1; y++) {
+        uint64_t *swap;
+        if (y < height)
+          PackRow(mask[y], width, lo, nwords);
+        else
+          for (int k = 0; k < nwords; k++) lo[k] = 0;
+        count_row_pair(up, lo, nwords, &t);
+        swap = up;
+        up = lo;
+        lo = swap;
+      }
+      q1 += t.q1;
+      q3 += t.q3;
+      qd_main += t.qd_main;
+      qd_anti += t.qd_anti;
+    }
+    free(up);
+    free(lo);
+  }
+
+  q->q1 = q1;
+  q->q3 = q3;
+  q->qd_main = qd_main;
+  q->qd_anti = qd_anti;
+}
+
+/* Contributions, times 4, of the 16 patterns of a window to the Euler
+ * number.  Bit 0 of a pattern is the top-left pixel, bit 1 the top-right,
+ * bit 2 the bottom-left and bit 3 the bottom-right. */
+static void EulerTable(unsigned int nb, int table[16]) {
+  for (int p = 0; p < 16; p++) {
+    int n = (p & 1) + (p >> 1 & 1) + (p >> 2 & 1) + (p >> 3 & 1);
+    table[p] = (n == 1) ? 1 : (n == 3) ? -1 : 0;
+  }
+  table[9] = (nb & (NB_NW | NB_SE)) ? -2 : 2;
+  table[6] = (nb & (NB_NE | NB_SW)) ? -2 : 2;
+}
+
+int EulerFromQuads(const struct bit_quads *q, unsigned int neighborhood,
+                   long *euler) {
+  unsigned int nb = nb_symmetric(neighborhood);
+  int table[16];
+  long e4;
+
+  if ((nb & NB_4) != NB_4) {
+    fprintf(stderr, "EulerFromQuads(): neighborhood without NB_4\n");
+    return -1;
+  }
+  EulerTable(nb, table);
+  e4 = (long)q->q1 - (long)q->q3 + table[9] * (long)q->qd_main +
+       table[6] * (long)q->qd_anti;
+  *euler = e4 / 4;
+  return 0;
+}
+
+int EulerNumber(unsigned char **mask, int width, int height,
+                unsigned int neighborhood, long *euler) {
+  struct bit_quads q;
+
+  CountBitQuads(mask, width, height, &q);
+  return EulerFromQuads(&q, neighborhood, euler);
+}
+
+/* Copies row y of seg, mapped through lut, to row[1 .. width]; row[0] and
+ * row[width + 1] stay 0, and rows outside the image are all 0. */
+static void LoadLabelRow(unsigned int **seg, int width, int height, int y,
+                         const uint32_t *lut, uint32_t *row) {
+  if (y < 0 || y >= height) {
+    for (int x = 0; x < width; x++) row[x + 1] = 0;
+  } else if (lut) {
+    for (int x = 0; x < width; x++) row[x + 1] = lut[seg[y][x]];
+  } else {
+    for (int x = 0; x < width; x++) row[x + 1] = seg[y][x];
+  }
+}
+
+int LabelEulerNumbers(unsigned int **seg, int width, int height,
+                      unsigned int neighborhood, const uint32_t *lut,
+                      uint32_t nregions, long *euler) {
+  unsigned int nb = nb_symmetric(neighborhood);
+  int nbands = height / EULER_BAND_ROWS + 1;
+  int table[16], bad = 0;
+
+  if ((nb & NB_4) != NB_4) {
+    fprintf(stderr, "LabelEulerNumbers(): neighborhood without NB_4\n");
+    return -1;
+  }
+  EulerTable(nb, table);
+  for (uint32_t r = 0; r < nregions; r++) euler[r] = 0;
+
+#pragma omp parallel
+  {
+    uint32_t *up = (uint32_t *)get_spc(width + 2, sizeof(uint32_t));
+    uint32_t *lo = (uint32_t *)get_spc(width + 2, sizeof(uint32_t));
+
+#pragma omp for schedule(static)
+    for (int band = 0; band < nbands; band++) {
+      int y0 = band * EULER_BAND_ROWS;
+      int y1 = (y0 + EULER_BAND_ROWS < height + 1) ? y0 + EULER_BAND_ROWS
+                                                   : height + 1;
+
+      LoadLabelRow(seg, width, height, y0 - 1, lut, up);
+      for (int y = y0; y < y1; y++) {
+        uint32_t *swap;
+        LoadLabelRow(seg, width, height, y, lut, lo);
+        for (int i = 0; i <= width; i++) {
+          /* most windows lie inside one region */
+          if (up[i] == up[i + 1] && lo[i] == lo[i + 1] && up[i] == lo[i])
+            continue;
+          uint32_t v[4] = {up[i], up[i + 1], lo[i], lo[i + 1]};
+          for (int k = 0; k < 4; k++) {
+            uint32_t l = v[k];
+            int p;
+            if (l == 0 || (k > 0 && l == v[0]) || (k > 1 && l == v[1]) ||
+                (k > 2 && l == v[2]))
+              continue;
+            if (l >= nregions) {
+#pragma omp atomic write
+              bad = 1;
+              continue;
+            }
+            p = (v[0] == l) | (v[1] == l) << 1 | (v[2] == l) << 2 |
+                (v[3] == l) << 3;
+            /* windows on a straight boundary add nothing */
+            if (table[p] == 0) continue;
+#pragma omp atomic
+            euler[l] += table[p];
+          }
+        }
+        swap = up;
+        up = lo;
+        lo = swap;
+      }
+    }
+    free(up);
+    free(lo);
+  }
+
+  if (bad) {
+    fprintf(stderr, "LabelEulerNumbers(): region beyond nregions\n");
+    return -1;
+  }
+  for (uint32_t r = 1; r < nregions; r++) euler[r] /= 4;
+  return 0;
+}
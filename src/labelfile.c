@@ -0,0 +1,427 @@
+#include "labelfile.h"
+
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "mapfile.h"
+
+#define LF_MAGIC "LABELIDX"
+#define LF_BYTE_ORDER 0x01020304u
+#define LF_MAX_SECTIONS 64
+
+struct lf_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t width, height;
+  uint32_t nlabels;
+  uint32_t nsections;
+  uint32_t crc;          /* of the header, with crc 0, and the table */
+  uint32_t reserved[7];  /* 0                                         */
+};
+
+struct lf_section {
+  uint32_t type;
+  uint32_t crc;     /* of the size bytes at offset */
+  uint64_t offset;  /* multiple of LABEL_FILE_ALIGN */
+  uint64_t size;
+};
+
+#define PIXEL_T unsigned char
+#define PIXEL_NAME(f) f
+#include "labelfile.inc"
+#undef PIXEL_T
+#undef PIXEL_NAME
+
+#define PIXEL_T uint16_t
+#define PIXEL_NAME(f) f##_u16
+#include "labelfile.inc"
+#undef PIXEL_T
+#undef PIXEL_NAME
+
+#define PIXEL_T float
+#define PIXEL_NAME(f) f##_f32
+#include "labelfile.inc"
+#undef PIXEL_T
+#undef PIXEL_NAME
+
+/* Tables of the slicing-by-4 CRC: crc_table[k][b] is the CRC of byte b
+ * followed by k zero bytes */
+static uint32_t crc_table[4][256];
+static int crc_table_ready = 0;
+
+static void MakeCrcTable(void) {
+  for (uint32_t b = 0; b < 256; b++) {
+    uint32_t c = b;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    crc_table[0][b] = c;
+  }
+  for (uint32_t b = 0; b < 256; b++) {
+    for (int k = 1; k < 4; k++) {
+      uint32_t c = crc_table[k - 1][b];
+      crc_table[k][b] = crc_table[0][c & 0xff] ^ (c >> 8);
+    }
+  }
+  crc_table_ready = 1;
+}
+
+uint32_t Crc32(uint32_t crc, const void *data, size_t n) {
+  const unsigned char *p = (const unsigned char *)data;
+
+  if (!crc_table_ready) MakeCrcTable();
+  crc = ~crc;
+  for (; n >= 4; n -= 4, p += 4) {
+    crc ^= (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+    crc = crc_table[3][crc & 0xff] ^ crc_table[2][(crc >> 8) & 0xff] ^
+          crc_table[1][(crc >> 16) & 0xff] ^ crc_table[0][crc >> 24];
+  }
+  for (; n > 0; n--, p++) crc = crc_table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+/* Sections are written one after another, each padded to its alignment,
+ * while their CRCs are computed. */
+struct section_writer {
+  FILE *fp;
+  uint64_t pos;
+  struct lf_section *s;
+  int error;
+};
+
+static void SectionWrite(struct section_writer *w, const void *data,
+                         size_t n) {
+  if (n == 0 || w->error) return;
+  if (fwrite(data, 1, n, w->fp) != n) {
+    w->error = 1;
+    return;
+  }
+  w->s->crc = Crc32(w->s->crc, data, n);
+  w->s->size += n;
+  w->pos += n;
+}
+
+static void BeginSection(struct section_writer *w, struct lf_section *s,
+                         uint32_t type) {
+  static const char zeros[LABEL_FILE_ALIGN] = {0};
+  size_t pad = (LABEL_FILE_ALIGN - w->pos % LABEL_FILE_ALIGN) %
+               LABEL_FILE_ALIGN;
+
+  if (!w->error && pad && fwrite(zeros, 1, pad, w->fp) != pad) w->error = 1;
+  w->pos += pad;
+  s->type = type;
+  s->crc = 0;
+  s->offset = w->pos;
+  s->size = 0;
+  w->s = s;
+}
+
+/* Writes the runs of seg, row offsets first */
+static void WriteRuns(struct section_writer *w, unsigned int **seg,
+                      int width, int height) {
+  struct label_run *runs;
+  uint32_t *run_offset, nruns = 0;
+
+  run_offset = (uint32_t *)mget_spc((size_t)height + 1, sizeof(uint32_t));
+  for (int y = 0; y < height; y++) {
+    run_offset[y] = nruns;
+    nruns++;
+    for (int x = 1; x < width; x++) nruns += (seg[y][x] != seg[y][x - 1]);
+  }
+  run_offset[height] = nruns;
+  SectionWrite(w, run_offset, ((size_t)height + 1) * sizeof(uint32_t));
+  free(run_offset);
+
+  runs = (struct label_run *)mget_spc(width, sizeof(struct label_run));
+  for (int y = 0; y < height; y++) {
+    int n = 0;
+    for (int x = 0; x < width; x++) {
+      if (x == 0 || seg[y][x] != seg[y][x - 1]) {
+        runs[n].x0 = x;
+        runs[n].label = seg[y][x];
+        n++;
+      }
+    }
+    SectionWrite(w, runs, (size_t)n * sizeof(struct label_run));
+  }
+  free(runs);
+}
+
+int WriteLabelFile(FILE *fp, unsigned int **seg, int width, int height,
+                   unsigned int nlabels, const struct region_stats *stats,
+                   const struct pixel_index *pi, int rle) {
+  struct lf_header h;
+  struct lf_section s[5];
+  struct section_writer w = {fp, 0, NULL, 0};
+  struct region_box *boxes;
+  size_t nregions = (size_t)nlabels + 1;
+  size_t npix = (size_t)width * height;
+  int ns = 5;
+
+  if (width <= 0 || height <= 0 || pi->width != (uint32_t)width ||
+      pi->height != (uint32_t)height || pi->nlabels != nlabels) {
+    fprintf(stderr, "WriteLabelFile(): index does not match labels\n");
+    return -1;
+  }
+
+  // room for the header and the table, written last with the CRCs
+  memset(&h, 0, sizeof(h));
+  memset(s, 0, sizeof(s));
+  if (fwrite(&h, sizeof(h), 1, fp) != 1 || fwrite(s, sizeof(s), 1, fp) != 1)
+    w.error = 1;
+  w.pos = sizeof(h) + sizeof(s);
+
+  BeginSection(&w, &s[0], rle ? LF_RASTER_RLE : LF_RASTER);
+  if (rle) {
+    WriteRuns(&w, seg, width, height);
+  } else {
+    for (int y = 0; y < height; y++)
+      SectionWrite(&w, seg[y], (size_t)width * sizeof(uint32_t));
+  }
+
+  BeginSection(&w, &s[1], LF_STATS);
+  SectionWrite(&w, stats, nregions * sizeof(struct region_stats));
+
+  boxes = (struct region_box *)mget_spc(nregions, sizeof(struct region_box));
+  for (uint32_t l = 0; l <= nlabels; l++) RegionBox(pi, l, &boxes[l]);
+  BeginSection(&w, &s[2], LF_BOXES);
+  SectionWrite(&w, boxes, nregions * sizeof(struct region_box));
+  free(boxes);
+
+  BeginSection(&w, &s[3], LF_OFFSETS);
+  SectionWrite(&w, pi->offset, (nregions + 1) * sizeof(uint32_t));
+  BeginSection(&w, &s[4], LF_INDEX);
+  SectionWrite(&w, pi->index, npix * sizeof(uint32_t));
+
+  memcpy(h.magic, LF_MAGIC, 8);
+  h.version = LABEL_FILE_VERSION;
+  h.byte_order = LF_BYTE_ORDER;
+  h.width = width;
+  h.height = height;
+  h.nlabels = nlabels;
+  h.nsections = ns;
+  h.crc = Crc32(Crc32(0, &h, sizeof(h)), s, sizeof(s));
+  if (w.error || fseek(fp, 0, SEEK_SET) != 0 ||
+      fwrite(&h, sizeof(h), 1, fp) != 1 || fwrite(s, sizeof(s), 1, fp) != 1 ||
+      fseek(fp, 0, SEEK_END) != 0) {
+    fprintf(stderr, "WriteLabelFile(): fwrite() error\n");
+    return -1;
+  }
+  return 0;
+}
+
+static const struct lf_section *Sections(const struct label_file *lf) {
+  return (const struct lf_section *)((const char *)lf->map +
+                                     sizeof(struct lf_header));
+}
+
+/* Checks that a section lies in the file and has the expected size */
+static int SectionFits(const struct label_file *lf,
+                       const struct lf_section *s, uint64_t size) {
+  return s->offset % LABEL_FILE_ALIGN == 0 && s->offset <= lf->size &&
+         s->size <= lf->size - s->offset && s->size == size;
+}
+
+/* Checks that every label of the raster is a region, and that the runs
+ * of every row start at x = 0 and at increasing x inside the row */
+static int CheckLabels(const struct label_file *lf) {
+  if (lf->raster) {
+    uint64_t npix = (uint64_t)lf->width * lf->height;
+    for (uint64_t i = 0; i < npix; i++) {
+      if (lf->raster[i] > lf->nlabels) return -1;
+    }
+    return 0;
+  }
+  for (uint32_t y = 0; y < lf->height; y++) {
+    uint32_t first = lf->run_offset[y], last = lf->run_offset[y + 1];
+    if (lf->runs[first].x0 != 0) return -1;
+    for (uint32_t k = first; k < last; k++) {
+      if (lf->runs[k].label > lf->nlabels || lf->runs[k].x0 >= lf->width ||
+          (k > first && lf->runs[k].x0 <= lf->runs[k - 1].x0))
+        return -1;
+    }
+  }
+  return 0;
+}
+
+int OpenLabelFile(const char *path, int verify, struct label_file *lf) {
+  struct lf_header h;
+  const struct lf_section *s;
+  const char *base;
+  uint64_t npix, nregions;
+  int have = 0;
+
+  memset(lf, 0, sizeof(*lf));
+  if ((lf->map = MapFile(path, &lf->size)) == NULL) return -1;
+  base = (const char *)lf->map;
+
+  if (lf->size < sizeof(h) || memcmp(base, LF_MAGIC, 8) != 0) {
+    fprintf(stderr, "OpenLabelFile(): not a label file\n");
+    CloseLabelFile(lf);
+    return -1;
+  }
+  memcpy(&h, base, sizeof(h));
+  if (h.byte_order != LF_BYTE_ORDER) {
+    fprintf(stderr, "OpenLabelFile(): file written in another byte order\n");
+    CloseLabelFile(lf);
+    return -1;
+  }
+  if (h.version >> 16 != LABEL_FILE_VERSION >> 16) {
+    fprintf(stderr, "OpenLabelFile(): unsupported version %u.%u\n",
+            h.version >> 16, h.version & 0xffff);
+    CloseLabelFile(lf);
+    return -1;
+  }
+  if (h.nsections > LF_MAX_SECTIONS ||
+      lf->size < sizeof(h) + h.nsections * sizeof(struct lf_section)) {
+    fprintf(stderr, "OpenLabelFile(): truncated file\n");
+    CloseLabelFile(lf);
+    return -1;
+  }
+  s = Sections(lf);
+  {
+    uint32_t crc = h.crc;
+    h.crc = 0;
+    if (Crc32(Crc32(0, &h, sizeof(h)), s,
+              h.nsections * sizeof(struct lf_section)) != crc) {
+      fprintf(stderr, "OpenLabelFile(): corrupt header\n");
+      CloseLabelFile(lf);
+      return -1;
+    }
+  }
+
+  lf->version = h.version;
+  lf->width = h.width;
+  lf->height = h.height;
+  lf->nlabels = h.nlabels;
+  npix = (uint64_t)h.width * h.height;
+  nregions = (uint64_t)h.nlabels + 1;
+
+  for (uint32_t k = 0; k < h.nsections; k++) {
+    const void *data = base + s[k].offset;
+    int ok = 1;
+    switch (s[k].type) {
+      case LF_RASTER:
+        ok = SectionFits(lf, &s[k], npix * sizeof(uint32_t));
+        lf->raster = (const uint32_t *)data;
+        break;
+      case LF_RASTER_RLE: {
+        uint64_t head = ((uint64_t)h.height + 1) * sizeof(uint32_t);
+        const uint32_t *run_offset = (const uint32_t *)data;
+        ok = SectionFits(lf, &s[k], s[k].size) && s[k].size >= head &&
+             run_offset[0] == 0 &&
+             head + run_offset[h.height] * sizeof(struct label_run) ==
+                 s[k].size;
+        for (uint32_t y = 0; ok && y < h.height; y++)
+          ok = run_offset[y] < run_offset[y + 1];
+        lf->run_offset = run_offset;
+        lf->runs = (const struct label_run *)((const char *)data + head);
+        break;
+      }
+      case LF_STATS:
+        ok = SectionFits(lf, &s[k], nregions * sizeof(struct region_stats));
+        lf->stats = (const struct region_stats *)data;
+        break;
+      case LF_BOXES:
+        ok = SectionFits(lf, &s[k], nregions * sizeof(struct region_box));
+        lf->boxes = (const struct region_box *)data;
+        break;
+      case LF_OFFSETS:
+        ok = SectionFits(lf, &s[k], (nregions + 1) * sizeof(uint32_t));
+        lf->pixels.offset = (uint32_t *)data;
+        break;
+      case LF_INDEX:
+        ok = SectionFits(lf, &s[k], npix * sizeof(uint32_t));
+        lf->pixels.index = (uint32_t *)data;
+        break;
+      default:
+        continue;  // from a later minor version
+    }
+    if (!ok) {
+      fprintf(stderr, "OpenLabelFile(): bad section %u\n", s[k].type);
+      CloseLabelFile(lf);
+      return -1;
+    }
+    have |= 1 << s[k].type;
+  }
+  if (!(have & (1 << LF_RASTER | 1 << LF_RASTER_RLE)) ||
+      !(have & 1 << LF_STATS) || !(have & 1 << LF_BOXES) ||
+      !(have & 1 << LF_OFFSETS) || !(have & 1 << LF_INDEX)) {
+    fprintf(stderr, "OpenLabelFile(): missing section\n");
+    CloseLabelFile(lf);
+    return -1;
+  }
+  lf->pixels.width = h.width;
+  lf->pixels.height = h.height;
+  lf->pixels.nlabels = h.nlabels;
+
+  // the label data index the region arrays and the image, so its structure
+  // is checked on every open; only the CRCs are left to verify
+  if (CheckLabels(lf) || CheckPixelIndex(&lf->pixels)) {
+    fprintf(stderr, "OpenLabelFile(): corrupt label data\n");
+    CloseLabelFile(lf);
+    return -1;
+  }
+
+  if (verify && VerifyLabelFile(lf)) {
+    CloseLabelFile(lf);
+    return -1;
+  }
+  return 0;
+}
+
+int VerifyLabelFile(const struct label_file *lf) {
+  const struct lf_header *h = (const struct lf_header *)lf->map;
+  const struct lf_section *s = Sections(lf);
+
+  for (uint32_t k = 0; k < h->nsections; k++) {
+    if (s[k].offset > lf->size || s[k].size > lf->size - s[k].offset ||
+        Crc32(0, (const char *)lf->map + s[k].offset, s[k].size) !=
+            s[k].crc) {
+      fprintf(stderr, "VerifyLabelFile(): corrupt section %u\n", s[k].type);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void CloseLabelFile(struct label_file *lf) {
+  if (lf->map) UnmapFile(lf->map, lf->size);
+  memset(lf, 0, sizeof(*lf));
+}
+
+uint32_t LabelFileAt(const struct label_file *lf, int x, int y) {
+  uint32_t lo, hi;
+
+  if (lf->raster) return lf->raster[(size_t)y * lf->width + x];
+  // the last run of the row that starts at or before x
+  lo = lf->run_offset[y];
+  hi = lf->run_offset[y + 1] - 1;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo + 1) / 2;
+    if (lf->runs[mid].x0 <= (uint32_t)x)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lf->runs[lo].label;
+}
+
+void LabelFileRow(const struct label_file *lf, int y, uint32_t *row) {
+  uint32_t first, last;
+
+  if (lf->raster) {
+    memcpy(row, lf->raster + (size_t)y * lf->width,
+           lf->width * sizeof(uint32_t));
+    return;
+  }
+  first = lf->run_offset[y];
+  last = lf->run_offset[y + 1];
+  for (uint32_t k = first; k < last; k++) {
+    uint32_t end = (k + 1 < last) ? lf->runs[k + 1].x0 : lf->width;
+    for (uint32_t x = lf->runs[k].x0; x < end && x < lf->width; x++)
+      row[x] = lf->runs[k].label;
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef _LABELFILE_H_
+#define _LABELFILE_H_
+
+#include <stdio.h>
+
+#include "pixelindex.h"
+#include "typeutil.h"
+
+/* Label file: a label image together with everything needed to answer
+ * region queries, in one file that is used in place through mmap().
+ *
+ * The file starts with a 64-byte header and a table of sections.  Every
+ * section starts on a 64-byte boundary and holds one array exactly as it
+ * is laid out in memory, in the byte order of the writer, so opening the
+ * file only checks the header and points into the mapping:
+ *
+ *   LF_RASTER      width * height labels, row by row
+ *   LF_RASTER_RLE  instead of LF_RASTER: height + 1 offsets into the runs
+ *                  of each row, then the runs
+ *   LF_STATS       struct region_stats of labels 0 .. nlabels
+ *   LF_BOXES       struct region_box of labels 0 .. nlabels
+ *   LF_OFFSETS     nlabels + 2 offsets into LF_INDEX  } the pixel index,
+ *   LF_INDEX       width * height pixel indices       } see pixelindex.h
+ *
+ * The header and the section table carry a CRC-32 of the header and of
+ * every section.  Readers check the CRC of the header on opening, and the
+ * CRCs of the sections only if asked.  The labels, runs, offsets and pixel
+ * indices are checked for range and order on every open, so a file that
+ * passes cannot make a query read outside the mapping.
+ * A reader accepts files of its major version, LABEL_FILE_VERSION >> 16,
+ * and ignores sections it does not know. */
+
+#define LABEL_FILE_VERSION 0x00010000 /* major 1, minor 0 */
+#define LABEL_FILE_ALIGN 64
+
+#define LF_RASTER 1
+#define LF_RASTER_RLE 2
+#define LF_STATS 3
+#define LF_BOXES 4
+#define LF_OFFSETS 5
+#define LF_INDEX 6
+
+struct region_stats {
+  uint32_t size;   /* pixels              */
+  float min, max;  /* pixel values        */
+  float mean;
+  double cx, cy;   /* centroid            */
+};
+
+/* A run of a row from x0 up to the x0 of the next run of the row, or to
+ * the end of the row */
+struct label_run {
+  uint32_t x0;
+  uint32_t label;
+};
+
+struct label_file {
+  void *map;
+  size_t size;
+  uint32_t version;
+  uint32_t width, height;
+  uint32_t nlabels;
+  const uint32_t *raster;            /* NULL if run-length coded   */
+  const uint32_t *run_offset;        /* NULL if not                */
+  const struct label_run *runs;
+  const struct region_stats *stats;  /* nlabels + 1                */
+  const struct region_box *boxes;    /* nlabels + 1                */
+  struct pixel_index pixels;         /* in the mapping, read-only;
+                                        do not free                 */
+};
+
+/* Statistics of every label of seg over the pixels of img.  stats holds
+ * nlabels + 1 entries.  Returns 0 on success. */
+int RegionStats(unsigned char **img, unsigned int **seg, int width,
+                int height, unsigned int nlabels, struct region_stats *stats);
+int RegionStats_u16(uint16_t **img, unsigned int **seg, int width,
+                    int height, unsigned int nlabels,
+                    struct region_stats *stats);
+int RegionStats_f32(float **img, unsigned int **seg, int width, int height,
+                    unsigned int nlabels, struct region_stats *stats);
+
+/* Writes seg, with stats and the pixel index pi of seg, to fp, which must
+ * be a new file open for writing and seeking.  With rle the raster is run-
+ * length coded.  Returns 0 on success. */
+int WriteLabelFile(FILE *fp, unsigned int **seg, int width, int height,
+                   unsigned int nlabels, const struct region_stats *stats,
+                   const struct pixel_index *pi, int rle);
+
+/* Maps a label file; with verify the CRCs of all sections are checked.
+ * Returns 0 on success. */
+int OpenLabelFile(const char *path, int verify, struct label_file *lf);
+/* Checks the CRCs of all sections.  Returns 0 if they match. */
+int VerifyLabelFile(const struct label_file *lf);
+void CloseLabelFile(struct label_file *lf);
+
+/* Label of pixel (x, y), in O(log runs) for a run-length coded raster */
+uint32_t LabelFileAt(const struct label_file *lf, int x, int y);
+/* Decodes row y into width labels */
+void LabelFileRow(const struct label_file *lf, int y, uint32_t *row);
+
+/* CRC-32 (IEEE 802.3) of n bytes, continuing from crc; start from 0 */
+uint32_t Crc32(uint32_t crc, const void *data, size_t n);
+
+#endif /* _LABELFILE_H_ */
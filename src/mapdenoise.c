@@ -0,0 +1,125 @@
+#include "mapdenoise.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocate.h"
+
+#define NB 4             /* neighbors per pixel                 */
+#define NB_WEIGHT (0.25) /* b_sr, normalized to sum to one      */
+
+static double UpdateColor(double **x, double **y, int width, int height,
+                          int color, const struct qggmrf_table *tab,
+                          double inv_var);
+
+void map_default_params(struct map_params *mp) {
+  mp->sigma_n = 10.0;
+  mp->sigma_x = 10.0;
+  mp->p = 1.2;
+  mp->q = 2.0;
+  mp->T = 1.0;
+  mp->max_iterations = 20;
+  mp->tolerance = 0.01;
+  mp->verbose = 1;
+}
+
+int qGGMRF_MAP_denoise(double **x, double **y, int width, int height,
+                       const struct map_params *mp, struct map_stats *stats) {
+  struct qggmrf_table tab;
+  double inv_var, change, start, seconds;
+  int it;
+
+  if (qggmrf_table_init(&tab, NB_WEIGHT, mp->sigma_x, mp->p, mp->q, mp->T)) {
+    fprintf(stderr, "qGGMRF_MAP_denoise: memory allocation failed\n");
+    return 1;
+  }
+  inv_var = 1.0 / (mp->sigma_n * mp->sigma_n);
+
+  stats->iterations = 0;
+  stats->last_update = 0.0;
+  stats->total_seconds = 0.0;
+  for (it = 0; it < mp->max_iterations; it++) {
+    start = omp_get_wtime();
+    change = UpdateColor(x, y, width, height, 0, &tab, inv_var);
+    change += UpdateColor(x, y, width, height, 1, &tab, inv_var);
+    change /= (double)width * height;
+    seconds = omp_get_wtime() - start;
+
+    stats->iterations++;
+    stats->last_update = change;
+    stats->total_seconds += seconds;
+    if (mp->verbose) {
+      printf("MAP iteration %d: mean |update| = %g, %.3f ms\n", it + 1, change,
+             1e3 * seconds);
+    }
+    if (change < mp->tolerance) break;
+  }
+
+  qggmrf_table_free(&tab);
+  return 0;
+}
+
+/**
+ * @brief Updates all pixels with (row + col) % 2 == color
+ *
+ * Each pixel is set to the minimizer of the surrogate cost
+ * (y_s - x_s)^2 / (2 sigma_n^2) + sum_r btilde_r (x_s - x_r)^2, i.e.
+ * x_s = (y_s / sigma_n^2 + 2 sum_r btilde_r x_r) /
+ *       (1 / sigma_n^2 + 2 sum_r btilde_r).
+ * The neighbor differences of one row are gathered so btilde is
+ * evaluated with a single batch call.
+ *
+ * @return the sum of |update| over the pixels of this color
+ */
+static double UpdateColor(double **x, double **y, int width, int height,
+                          int color, const struct qggmrf_table *tab,
+                          double inv_var) {
+  double change = 0.0;
+  int i;
+
+#pragma omp parallel reduction(+ : change)
+  {
+    double *delta = (double *)mget_spc(NB * (width / 2 + 1), sizeof(double));
+    double *bt = (double *)mget_spc(NB * (width / 2 + 1), sizeof(double));
+    double *xr = (double *)mget_spc(NB * (width / 2 + 1), sizeof(double));
+
+#pragma omp for schedule(static)
+    for (i = 0; i < height; i++) {
+      int j, k, n = 0;
+
+      /* gather neighbor values; missing neighbors get btilde = 0 below */
+      for (j = (i + color) % 2; j < width; j += 2, n++) {
+        double xs = x[i][j];
+        xr[NB * n + 0] = (i > 0) ? x[i - 1][j] : xs;
+        xr[NB * n + 1] = (i < height - 1) ? x[i + 1][j] : xs;
+        xr[NB * n + 2] = (j > 0) ? x[i][j - 1] : xs;
+        xr[NB * n + 3] = (j < width - 1) ? x[i][j + 1] : xs;
+        for (k = 0; k < NB; k++) delta[NB * n + k] = xs - xr[NB * n + k];
+      }
+      qggmrf_btilde_array(tab, delta, bt, NB * n);
+
+      for (j = (i + color) % 2, n = 0; j < width; j += 2, n++) {
+        double num = y[i][j] * inv_var, den = inv_var, xnew;
+        if (i == 0) bt[NB * n + 0] = 0;
+        if (i == height - 1) bt[NB * n + 1] = 0;
+        if (j == 0) bt[NB * n + 2] = 0;
+        if (j == width - 1) bt[NB * n + 3] = 0;
+        for (k = 0; k < NB; k++) {
+          num += 2 * bt[NB * n + k] * xr[NB * n + k];
+          den += 2 * bt[NB * n + k];
+        }
+        xnew = num / den;
+        change += fabs(xnew - x[i][j]);
+        x[i][j] = xnew;
+      }
+    }
+
+    free(delta);
+    free(bt);
+    free(xr);
+  }
+
+  return change;
+}
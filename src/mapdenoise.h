@@ -0,0 +1,40 @@
+#ifndef _MAPDENOISE_H_
+#define _MAPDENOISE_H_
+
+#include "qGGMRF.h"
+#include "typeutil.h"
+
+/* MAP denoising of y = x + w, with w white Gaussian noise of standard
+ * deviation sigma_n and a qGGMRF prior on x over the 4-point
+ * neighborhood.  The cost
+ *
+ *   sum_s (y_s - x_s)^2 / (2 sigma_n^2) + sum_{s,r} b_sr rho(x_s - x_r)
+ *
+ * is minimized by ICM using the quadratic surrogate of rho (get_btilde),
+ * for which each pixel update has a closed form.  Pixels are updated in
+ * red-black (checkerboard) order: no two pixels of one color are
+ * neighbors, so each half sweep is done in parallel. */
+
+struct map_params {
+  double sigma_n;     /* standard deviation of the noise              */
+  double sigma_x;     /* qGGMRF scale parameter                       */
+  double p, q, T;     /* qGGMRF shape and threshold parameters        */
+  int max_iterations; /* maximum number of full sweeps                */
+  double tolerance;   /* stop when the mean |update| falls below this */
+  int verbose;        /* print the time of every iteration            */
+};
+
+struct map_stats {
+  int iterations;       /* number of sweeps performed             */
+  double last_update;   /* mean |update| of the last sweep        */
+  double total_seconds; /* wall time of all sweeps                */
+};
+
+void map_default_params(struct map_params *mp);
+
+/* Denoises y (height x width) into x; x holds the initial estimate on
+ * entry.  Returns 0 on success. */
+int qGGMRF_MAP_denoise(double **x, double **y, int width, int height,
+                       const struct map_params *mp, struct map_stats *stats);
+
+#endif /* _MAPDENOISE_H_ */
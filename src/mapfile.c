@@ -0,0 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "mapfile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocate.h"
+#include "typeutil.h"
+
+#ifndef __WINDOWS__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void *MapFile(const char *path, size_t *size) {
+  struct stat st;
+  void *map = MAP_FAILED;
+  int fd = open(path, O_RDONLY);
+
+  if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    *size = st.st_size;
+  }
+  if (fd >= 0) close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "MapFile(): cannot map %s\n", path);
+    return NULL;
+  }
+  return map;
+}
+
+void UnmapFile(void *map, size_t size) { munmap(map, size); }
+
+#else
+
+void *MapFile(const char *path, size_t *size) {
+  FILE *fp;
+  void *data = NULL;
+  long n = 0;
+
+  if ((fp = fopen(path, "rb")) != NULL && fseek(fp, 0, SEEK_END) == 0 &&
+      (n = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+    data = mget_spc(n, 1);
+    if (fread(data, 1, n, fp) != (size_t)n) {
+      free(data);
+      data = NULL;
+    }
+  }
+  if (fp != NULL) fclose(fp);
+  if (data == NULL) {
+    fprintf(stderr, "MapFile(): cannot read %s\n", path);
+    return NULL;
+  }
+  *size = n;
+  return data;
+}
+
+void UnmapFile(void *map, size_t size) {
+  (void)size;
+  free(map);
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef _MAPFILE_H_
+#define _MAPFILE_H_
+
+#include <stddef.h>
+
+/* Read-only views of whole files.  The file is mapped with mmap(), so its
+ * pages are only read when touched and are shared between processes;
+ * where mmap() is not available it is read into memory instead. */
+
+/* Returns the contents of path and their size in *size, or NULL with an
+ * error message on stderr.  An empty file cannot be mapped. */
+void *MapFile(const char *path, size_t *size);
+void UnmapFile(void *map, size_t size);
+
+#endif /* _MAPFILE_H_ */
@@ -0,0 +1,346 @@
+#include "merge.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "unionfind.h"
+
+#define MERGE_MAGIC "MRG1"
+#define MERGE_BYTE_ORDER 0x01020304u
+
+/* The best pair of region owner, made when owner had version version; it
+ * is stale once the best pair of owner has changed since */
+struct candidate {
+  double cost;
+  uint32_t a, b; /* the pair, a < b */
+  uint32_t owner, version;
+};
+
+struct heap {
+  struct candidate *v;
+  size_t n, cap;
+};
+
+/* Orders pairs by cost, then by labels, so merging is deterministic */
+static inline int Before(const struct candidate *p, const struct candidate *q) {
+  if (p->cost != q->cost) return p->cost < q->cost;
+  if (p->a != q->a) return p->a < q->a;
+  return p->b < q->b;
+}
+
+static void HeapPush(struct heap *h, struct candidate c) {
+  size_t i;
+
+  if (h->n == h->cap) {
+    h->cap = h->cap ? 2 * h->cap : 1024;
+    h->v = (struct candidate *)realloc(h->v, h->cap * sizeof(*h->v));
+    if (h->v == NULL) {
+      fprintf(stderr, "HeapPush(): realloc() error\n");
+      exit(-1);
+    }
+  }
+  for (i = h->n++; i > 0 && Before(&c, &h->v[(i - 1) / 2]); i = (i - 1) / 2)
+    h->v[i] = h->v[(i - 1) / 2];
+  h->v[i] = c;
+}
+
+/* Puts c at position i and moves it down to its place */
+static void SiftDown(struct heap *h, size_t i, struct candidate c) {
+  size_t k;
+
+  while ((k = 2 * i + 1) < h->n) {
+    if (k + 1 < h->n && Before(&h->v[k + 1], &h->v[k])) k++;
+    if (!Before(&h->v[k], &c)) break;
+    h->v[i] = h->v[k];
+    i = k;
+  }
+  h->v[i] = c;
+}
+
+static struct candidate HeapPop(struct heap *h) {
+  struct candidate top = h->v[0];
+
+  h->n--;
+  if (h->n > 0) SiftDown(h, 0, h->v[h->n]);
+  return top;
+}
+
+/* Regions being merged: the union-find over labels, and for every root its
+ * size, pixel sum, list of neighbors and best pair.  A list may hold labels
+ * that have merged since; they are resolved with uf_find.
+ *
+ * Each pair of neighbors is owned by the region that merged last, or by
+ * the smaller label if neither has merged, and the best pair of a region
+ * is the best of the pairs it owns.  A merge changes the cost of every
+ * pair of the new region, which then owns them all, so it is the only
+ * region that has to look at all of them; a neighbor only looks again at
+ * its own pairs if its best pair was with one of the merged regions.
+ * A region that keeps growing thus costs one pass over its neighbors per
+ * merge, without a heap entry for each. */
+struct regions {
+  uint32_t *parent;
+  double *size, *sum;
+  double *mean, *log_size; /* mean and log2(size), for the costs     */
+  uint32_t **nbr, *nnbr, *cap;
+  uint32_t *merged;        /* step of the last merge, 0 if none      */
+  struct candidate *best;  /* best.b == 0 for a region without pairs */
+  uint32_t *version;       /* of the best pair                       */
+  uint32_t *mark, stamp;   /* to drop duplicates from neighbor lists */
+  double size_penalty;
+};
+
+static inline int Owns(const struct regions *r, uint32_t v, uint32_t u) {
+  if (r->merged[v] != r->merged[u]) return r->merged[v] > r->merged[u];
+  return v < u;
+}
+
+/* A best pair is live while its owner has not merged into another region
+ * and has not found another best pair.  The partner cannot have merged:
+ * every merge renews the best pairs of the regions that owned a pair with
+ * either merged region. */
+static inline int Live(const struct regions *r, const struct candidate *c) {
+  return r->parent[c->owner] == c->owner &&
+         r->version[c->owner] == c->version;
+}
+
+/* Drops the stale pairs and rebuilds the heap from the live ones */
+static void HeapPurge(struct heap *h, const struct regions *r) {
+  size_t n = 0;
+
+  for (size_t i = 0; i < h->n; i++) {
+    if (Live(r, &h->v[i])) h->v[n++] = h->v[i];
+  }
+  h->n = n;
+  for (size_t i = n / 2; i-- > 0;) SiftDown(h, i, h->v[i]);
+}
+
+static struct candidate Pair(const struct regions *r, uint32_t a,
+                             uint32_t b) {
+  struct candidate c;
+  double n;
+
+  if (a > b) {
+    uint32_t t = a;
+    a = b;
+    b = t;
+  }
+  n = (r->log_size[a] < r->log_size[b]) ? r->log_size[a] : r->log_size[b];
+  c.cost = fabs(r->mean[a] - r->mean[b]) + r->size_penalty * n;
+  c.a = a;
+  c.b = b;
+  return c;
+}
+
+static void AddNeighbor(struct regions *r, uint32_t v, uint32_t u) {
+  if (r->nnbr[v] == r->cap[v]) {
+    r->cap[v] = r->cap[v] ? 2 * r->cap[v] : 4;
+    r->nbr[v] = (uint32_t *)realloc(r->nbr[v], r->cap[v] * sizeof(uint32_t));
+    if (r->nbr[v] == NULL) {
+      fprintf(stderr, "AddNeighbor(): realloc() error\n");
+      exit(-1);
+    }
+  }
+  r->nbr[v][r->nnbr[v]++] = u;
+}
+
+/* Makes c the best pair of region v and queues it; c.b == 0 means that v
+ * has no neighbors left */
+static void SetBest(struct heap *h, struct regions *r, uint32_t v,
+                    struct candidate c) {
+  c.owner = v;
+  c.version = ++r->version[v];
+  r->best[v] = c;
+  if (c.b != 0) HeapPush(h, c);
+}
+
+/* Resolves the neighbor list of v to distinct roots and finds the best
+ * pair that v owns */
+static void Rescan(struct heap *h, struct regions *r, uint32_t v) {
+  uint32_t n = 0, stamp = ++r->stamp;
+  struct candidate best = {0, 0, 0, 0, 0}, c;
+
+  r->mark[v] = stamp;
+  for (uint32_t i = 0; i < r->nnbr[v]; i++) {
+    uint32_t u = uf_find(r->parent, r->nbr[v][i]);
+    if (r->mark[u] == stamp) continue;
+    r->mark[u] = stamp;
+    r->nbr[v][n++] = u;
+    if (!Owns(r, v, u)) continue;
+    c = Pair(r, v, u);
+    if (best.b == 0 || Before(&c, &best)) best = c;
+  }
+  r->nnbr[v] = n;
+  SetBest(h, r, v, best);
+}
+
+/* Merges b into a at step.  The neighbor lists of a and b are joined into
+ * one list of distinct roots, all of whose pairs a now owns. */
+static void Merge(struct heap *h, struct regions *r, uint32_t a, uint32_t b,
+                  uint32_t step) {
+  uint32_t *old[2] = {r->nbr[a], r->nbr[b]};
+  uint32_t nold[2] = {r->nnbr[a], r->nnbr[b]};
+  uint32_t stamp = ++r->stamp;
+  struct candidate best = {0, 0, 0, 0, 0}, c;
+
+  r->parent[b] = a;
+  r->size[a] += r->size[b];
+  r->sum[a] += r->sum[b];
+  r->mean[a] = r->sum[a] / r->size[a];
+  r->log_size[a] = log2(r->size[a]);
+  r->merged[a] = step;
+  r->nbr[a] = r->nbr[b] = NULL;
+  r->nnbr[a] = r->nnbr[b] = r->cap[a] = r->cap[b] = 0;
+
+  r->mark[a] = stamp;
+  for (int k = 0; k < 2; k++) {
+    for (uint32_t i = 0; i < nold[k]; i++) {
+      uint32_t u = uf_find(r->parent, old[k][i]);
+      if (r->mark[u] == stamp) continue;
+      r->mark[u] = stamp;
+      AddNeighbor(r, a, u);
+    }
+    free(old[k]);
+  }
+
+  for (uint32_t i = 0; i < r->nnbr[a]; i++) {
+    uint32_t u = r->nbr[a][i];
+    struct candidate *ub = &r->best[u];
+    c = Pair(r, a, u);
+    if (best.b == 0 || Before(&c, &best)) best = c;
+    if (ub->a == a || ub->b == a || ub->a == b || ub->b == b)
+      Rescan(h, r, u);
+  }
+  SetBest(h, r, a, best);
+}
+
+int MergeRegions(const struct rag *g, double size_penalty,
+                 struct merge_tree *t) {
+  size_t n = (size_t)g->nlabels + 1;
+  struct regions r;
+  struct heap h = {NULL, 0, 0};
+  uint32_t v, e;
+
+  r.parent = (uint32_t *)mget_spc(n, sizeof(uint32_t));
+  r.size = (double *)mget_spc(n, sizeof(double));
+  r.sum = (double *)mget_spc(n, sizeof(double));
+  r.mean = (double *)mget_spc(n, sizeof(double));
+  r.log_size = (double *)mget_spc(n, sizeof(double));
+  r.nbr = (uint32_t **)get_spc(n, sizeof(uint32_t *));
+  r.nnbr = (uint32_t *)get_spc(n, sizeof(uint32_t));
+  r.cap = (uint32_t *)get_spc(n, sizeof(uint32_t));
+  r.merged = (uint32_t *)get_spc(n, sizeof(uint32_t));
+  r.best = (struct candidate *)get_spc(n, sizeof(struct candidate));
+  r.version = (uint32_t *)get_spc(n, sizeof(uint32_t));
+  r.mark = (uint32_t *)get_spc(n, sizeof(uint32_t));
+  r.stamp = 0;
+  r.size_penalty = size_penalty;
+  for (v = 0; v < n; v++) {
+    r.parent[v] = v;
+    r.size[v] = g->size[v];
+    r.sum[v] = g->mean[v] * g->size[v];
+    r.mean[v] = r.sum[v] / r.size[v];
+    r.log_size[v] = log2(r.size[v]);
+  }
+  for (e = 0; e < g->nedges; e++) {
+    AddNeighbor(&r, g->edges[e].a, g->edges[e].b);
+    AddNeighbor(&r, g->edges[e].b, g->edges[e].a);
+  }
+  for (v = 1; v < n; v++) Rescan(&h, &r, v);
+
+  t->nlabels = g->nlabels;
+  t->nsteps = 0;
+  t->steps = (struct merge_step *)mget_spc(n, sizeof(struct merge_step));
+  while (h.n > 0) {
+    struct candidate c = HeapPop(&h);
+    if (!Live(&r, &c)) continue;
+    t->steps[t->nsteps].a = c.a;
+    t->steps[t->nsteps].b = c.b;
+    t->steps[t->nsteps].cost = (float)c.cost;
+    t->nsteps++;
+    Merge(&h, &r, c.a, c.b, t->nsteps);
+
+    // there are never more live pairs than regions
+    if (h.n > 4 * n + 1024) HeapPurge(&h, &r);
+  }
+
+  for (v = 0; v < n; v++) free(r.nbr[v]);
+  free(r.parent);
+  free(r.size);
+  free(r.sum);
+  free(r.mean);
+  free(r.log_size);
+  free(r.nbr);
+  free(r.nnbr);
+  free(r.cap);
+  free(r.merged);
+  free(r.best);
+  free(r.version);
+  free(r.mark);
+  free(h.v);
+  return 0;
+}
+
+uint32_t CutMergeTree(const struct merge_tree *t, unsigned int nregions,
+                      double max_cost, uint32_t *map, unsigned int *nlabels) {
+  uint32_t n = t->nlabels, k, v;
+
+  for (v = 0; v <= n; v++) map[v] = v;
+  for (k = 0; k < t->nsteps && n - k > nregions; k++) {
+    if (t->steps[k].cost > max_cost) break;
+    map[t->steps[k].b] = t->steps[k].a;
+  }
+
+  // a merged label points at a smaller one, so its root is already
+  // numbered when it is reached
+  *nlabels = 0;
+  for (v = 1; v <= n; v++) {
+    map[v] = (map[v] == v) ? ++*nlabels : map[map[v]];
+  }
+  return k;
+}
+
+int WriteMergeTree(FILE *fp, const struct merge_tree *t) {
+  uint32_t head[3] = {MERGE_BYTE_ORDER, t->nlabels, t->nsteps};
+
+  if (fwrite(MERGE_MAGIC, 1, 4, fp) != 4 || fwrite(head, 4, 3, fp) != 3 ||
+      fwrite(t->steps, sizeof(struct merge_step), t->nsteps, fp) !=
+          t->nsteps) {
+    fprintf(stderr, "WriteMergeTree(): fwrite() error\n");
+    return -1;
+  }
+  return 0;
+}
+
+int ReadMergeTree(FILE *fp, struct merge_tree *t) {
+  char magic[4];
+  uint32_t head[3];
+
+  memset(t, 0, sizeof(*t));
+  if (fread(magic, 1, 4, fp) != 4 || fread(head, 4, 3, fp) != 3 ||
+      memcmp(magic, MERGE_MAGIC, 4) != 0) {
+    fprintf(stderr, "ReadMergeTree(): not a merge tree\n");
+    return -1;
+  }
+  if (head[0] != MERGE_BYTE_ORDER) {
+    fprintf(stderr, "ReadMergeTree(): tree written in another byte order\n");
+    return -1;
+  }
+  t->nlabels = head[1];
+  t->nsteps = head[2];
+  t->steps = (struct merge_step *)mget_spc((size_t)t->nsteps + 1,
+                                           sizeof(struct merge_step));
+  if (fread(t->steps, sizeof(struct merge_step), t->nsteps, fp) !=
+      t->nsteps) {
+    fprintf(stderr, "ReadMergeTree(): truncated tree\n");
+    FreeMergeTree(t);
+    return -1;
+  }
+  return 0;
+}
+
+void FreeMergeTree(struct merge_tree *t) {
+  free(t->steps);
+  memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,57 @@
+#ifndef _MERGE_H_
+#define _MERGE_H_
+
+#include <stdio.h>
+
+#include "rag.h"
+#include "typeutil.h"
+
+/* Hierarchical merging of the regions of a region adjacency graph.
+ *
+ * The two adjacent regions of least dissimilarity
+ *
+ *   |mean_a - mean_b| + size_penalty * log2(min(size_a, size_b))
+ *
+ * are merged, one pair at a time, until no adjacent regions are left.
+ * The best pair of every region waits in a binary heap.  A pair is not
+ * removed from the heap when it goes stale, but dropped when it comes out.
+ * Regions are tracked with a union-find, so a merged region keeps the
+ * smaller of its two labels.  Regions of label 0 are never merged.
+ *
+ * The merge sequence is kept as a dendrogram: step k merges region b into
+ * region a, a < b, at cost.  Any cut of it is taken later with
+ * CutMergeTree without merging again.  With size_penalty > 0 the costs of
+ * the steps need not increase, so the cuts are prefixes of the sequence. */
+
+struct merge_step {
+  uint32_t a, b; /* merged regions, a < b; the result is a */
+  float cost;    /* dissimilarity of a and b               */
+};
+
+struct merge_tree {
+  uint32_t nlabels; /* leaves, the labels 1 .. nlabels */
+  uint32_t nsteps;
+  struct merge_step *steps;
+};
+
+/* Returns 0 on success */
+int MergeRegions(const struct rag *g, double size_penalty,
+                 struct merge_tree *t);
+
+/* Takes the steps of t in order while more than nregions regions are left
+ * and the cost of the step is at most max_cost, and writes the new label
+ * of every old label 0 .. nlabels to map.  The regions are numbered 1, 2,
+ * ... by their smallest old label, so raster order of first appearance is
+ * kept; label 0 maps to 0.  Returns the number of steps taken. */
+uint32_t CutMergeTree(const struct merge_tree *t, unsigned int nregions,
+                      double max_cost, uint32_t *map, unsigned int *nlabels);
+
+/* Binary dump: the magic "MRG1", the word 0x01020304 in the byte order of
+ * the writer, nlabels and nsteps as 32-bit words, and nsteps steps of two
+ * 32-bit words and a float each.  Both return 0 on success. */
+int WriteMergeTree(FILE *fp, const struct merge_tree *t);
+int ReadMergeTree(FILE *fp, struct merge_tree *t);
+
+void FreeMergeTree(struct merge_tree *t);
+
+#endif /* _MERGE_H_ */
@@ -0,0 +1,44 @@
+#include "neighborhood.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Bit of every position of the 3 x 3 window in raster order */
+static const unsigned int window[9] = {NB_NW, NB_N, NB_NE, NB_W, 0,
+                                       NB_E,  NB_SW, NB_S, NB_SE};
+
+int ParseNeighborhood(const char *s, unsigned int *mask) {
+  unsigned long m;
+  char *end;
+
+  if (strcmp(s, "4") == 0) {
+    *mask = NB_4;
+    return 0;
+  }
+  if (strcmp(s, "8") == 0) {
+    *mask = NB_8;
+    return 0;
+  }
+  if (strlen(s) == 9 && strspn(s, "01") == 9) {
+    m = 0;
+    for (int k = 0; k < 9; k++) {
+      if (s[k] == '1') m |= window[k];
+    }
+  } else {
+    m = strtoul(s, &end, 0);
+    if (*s == '\0' || *end != '\0' || m > NB_8) return -1;
+  }
+  if (m == 0) return -1;
+  *mask = nb_symmetric((unsigned int)m);
+  return 0;
+}
+
+void FormatNeighborhood(unsigned int mask, char buf[12]) {
+  int n = 0;
+
+  for (int k = 0; k < 9; k++) {
+    if (k == 3 || k == 6) buf[n++] = '/';
+    buf[n++] = (k == 4) ? 'x' : (mask & window[k]) ? '1' : '0';
+  }
+  buf[n] = '\0';
+}
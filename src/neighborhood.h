@@ -0,0 +1,54 @@
+#ifndef _NEIGHBORHOOD_H_
+#define _NEIGHBORHOOD_H_
+
+/* Pixel neighborhoods as bit masks over the eight offsets around a pixel.
+ *
+ * Two pixels are neighbors when one is at an offset of the mask from the
+ * other, so a mask is always used together with its mirror image; a mask
+ * holding only NB_E thus connects pixels horizontally.  Engines implement
+ * their inner loops as NB_KERNEL functions that test each offset of the
+ * mask with its own unrolled statement, and call them with NB_4 or NB_8
+ * as constants so that the compiler generates one specialized kernel per
+ * neighborhood.  Any other mask runs the same unrolled kernel with the
+ * mask as a variable. */
+
+#define NB_N 0x01  /* (col, row - 1)     */
+#define NB_S 0x02  /* (col, row + 1)     */
+#define NB_W 0x04  /* (col - 1, row)     */
+#define NB_E 0x08  /* (col + 1, row)     */
+#define NB_NW 0x10 /* (col - 1, row - 1) */
+#define NB_NE 0x20 /* (col + 1, row - 1) */
+#define NB_SW 0x40 /* (col - 1, row + 1) */
+#define NB_SE 0x80 /* (col + 1, row + 1) */
+
+#define NB_4 (NB_N | NB_S | NB_W | NB_E)
+#define NB_8 0xff
+
+/* Offsets that precede a pixel in raster order.  Union-find engines only
+ * merge a pixel with these, which visits every edge once. */
+#define NB_BACKWARD (NB_N | NB_W | NB_NW | NB_NE)
+
+#define NB_KERNEL static inline __attribute__((always_inline))
+
+/* Adds the mirror image of every offset */
+static inline unsigned int nb_symmetric(unsigned int mask) {
+  static const unsigned int mirror[8] = {NB_S,  NB_N,  NB_E,  NB_W,
+                                         NB_SE, NB_SW, NB_NE, NB_NW};
+  unsigned int m = mask & NB_8;
+
+  for (int k = 0; k < 8; k++) {
+    if (mask & (1u << k)) m |= mirror[k];
+  }
+  return m;
+}
+
+/* Parses "4", "8", or a user mask given either as nine 0/1 characters of
+ * the 3 x 3 window in raster order (the center is ignored), for example
+ * "000101000" for horizontal neighbors only, or as a number made of the
+ * NB_* bits.  The mask is made symmetric.  Returns 0 on success. */
+int ParseNeighborhood(const char *s, unsigned int *mask);
+
+/* Writes the 3 x 3 window of a mask as "101/010/101" into buf[12] */
+void FormatNeighborhood(unsigned int mask, char buf[12]);
+
+#endif /* _NEIGHBORHOOD_H_ */
@@ -0,0 +1,35 @@
+#include "parlabel.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "neighborhood.h"
+#include "relabel.h"
+#include "unionfind.h"
+
+#define PIXEL_T unsigned char
+#define PIXEL_DIFF(a, b) abs((int)(a) - (int)(b))
+#define PIXEL_NAME(f) f
+#include "parlabel.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+#define PIXEL_T uint16_t
+#define PIXEL_DIFF(a, b) abs((int)(a) - (int)(b))
+#define PIXEL_NAME(f) f##_u16
+#include "parlabel.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+#define PIXEL_T float
+#define PIXEL_DIFF(a, b) fabs((double)(a) - (double)(b))
+#define PIXEL_NAME(f) f##_f32
+#include "parlabel.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
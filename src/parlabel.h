@@ -0,0 +1,38 @@
+#ifndef _PARLABEL_H_
+#define _PARLABEL_H_
+
+#include "typeutil.h"
+
+/* Parallel labeling by concurrent union-find.
+ *
+ * The label buffer itself holds the union-find forest.  Threads take
+ * tiles from a shared dynamic queue and merge every pixel with its
+ * backward neighbors in the neighborhood (see neighborhood.h) using
+ * CAS-based link-by-index with path halving, so the root of every set is
+ * its first pixel in raster order.  ResolveLabels (see relabel.h) then
+ * flattens the forest and assigns the final labels 1, 2, ... in raster
+ * order of first appearance to the sets with more than
+ * min_connected_pixels pixels; all other pixels get label 0.  The result
+ * is identical to GetAllConnectedSets and independent of the number of
+ * threads. */
+
+#define PAR_TILE_ROWS 64
+#define PAR_TILE_COLS 256
+
+/* seg must be a height x width array allocated with get_img().  The
+ * number of labels is returned in *nlabels.  Returns 0 on success. */
+int LabelParallel(unsigned char **img, int width, int height,
+                  double threshold, unsigned int neighborhood,
+                  int min_connected_pixels, unsigned int **seg,
+                  unsigned int *nlabels);
+
+/* The same for 16-bit and floating-point images */
+int LabelParallel_u16(uint16_t **img, int width, int height,
+                      double threshold, unsigned int neighborhood,
+                      int min_connected_pixels, unsigned int **seg,
+                      unsigned int *nlabels);
+int LabelParallel_f32(float **img, int width, int height, double threshold,
+                      unsigned int neighborhood, int min_connected_pixels,
+                      unsigned int **seg, unsigned int *nlabels);
+
+#endif /* _PARLABEL_H_ */
@@ -0,0 +1,189 @@
+#include "pixelindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "mapfile.h"
+
+#define PIX_MAGIC "PIX1"
+#define PIX_BYTE_ORDER 0x01020304u
+#define PIX_HEADER 24 /* magic, byte order, width, height, nlabels, 0 */
+
+int BuildPixelIndex(unsigned int **seg, int width, int height,
+                    unsigned int nlabels, struct pixel_index *pi) {
+  uint64_t npix = (uint64_t)width * height;
+  uint32_t *next, sum = 0;
+
+  memset(pi, 0, sizeof(*pi));
+  if (npix > UINT32_MAX || nlabels >= UINT32_MAX - 1) {
+    fprintf(stderr, "BuildPixelIndex(): image too large\n");
+    return -1;
+  }
+  pi->width = width;
+  pi->height = height;
+  pi->nlabels = nlabels;
+  pi->offset = (uint32_t *)get_spc((size_t)nlabels + 2, sizeof(uint32_t));
+  pi->index = (uint32_t *)mget_spc(npix ? npix : 1, sizeof(uint32_t));
+
+  // count the pixels of every label into offset[l + 1]
+  for (int i = 0; i < height; i++) {
+    for (int j = 0; j < width; j++) {
+      unsigned int l = seg[i][j];
+      if (l > nlabels) {
+        fprintf(stderr, "BuildPixelIndex(): label %u beyond %u\n", l,
+                nlabels);
+        FreePixelIndex(pi);
+        return -1;
+      }
+      pi->offset[l + 1]++;
+    }
+  }
+  for (uint32_t l = 0; l <= nlabels; l++) {
+    sum += pi->offset[l + 1];
+    pi->offset[l + 1] = sum;
+  }
+
+  // scatter, keeping the pixels of each label in raster order
+  next = (uint32_t *)mget_spc((size_t)nlabels + 1, sizeof(uint32_t));
+  memcpy(next, pi->offset, ((size_t)nlabels + 1) * sizeof(uint32_t));
+  for (int i = 0; i < height; i++) {
+    uint32_t s = (uint32_t)i * width;
+    for (int j = 0; j < width; j++) pi->index[next[seg[i][j]]++] = s + j;
+  }
+  free(next);
+  return 0;
+}
+
+void RegionBox(const struct pixel_index *pi, uint32_t label,
+               struct region_box *box) {
+  const uint32_t *p = region_pixels(pi, label);
+  uint32_t n = region_size(pi, label);
+  int xmin, xmax;
+
+  if (n == 0) {
+    box->x0 = box->y0 = box->width = box->height = 0;
+    return;
+  }
+  // the rows come from the first and last pixel, the columns from all
+  xmin = xmax = p[0] % pi->width;
+  for (uint32_t k = 1; k < n; k++) {
+    int x = p[k] % pi->width;
+    if (x < xmin) xmin = x;
+    if (x > xmax) xmax = x;
+  }
+  box->x0 = xmin;
+  box->y0 = p[0] / pi->width;
+  box->width = xmax - xmin + 1;
+  box->height = p[n - 1] / pi->width - box->y0 + 1;
+}
+
+/* Sets the pixels of the region in out, a crop of box, to their value in
+ * img, or to 1 if img is NULL */
+static unsigned char **ExtractRegion(const struct pixel_index *pi,
+                                     uint32_t label, unsigned char **img,
+                                     const struct region_box *box) {
+  const uint32_t *p = region_pixels(pi, label);
+  uint32_t n = region_size(pi, label);
+  unsigned char **out;
+  int w = box->width > 0 ? box->width : 1;
+  int h = box->height > 0 ? box->height : 1;
+
+  out = (unsigned char **)get_img(w, h, sizeof(unsigned char));
+  memset(out[0], 0, (size_t)w * h);
+  for (uint32_t k = 0; k < n; k++) {
+    int row = p[k] / pi->width, col = p[k] % pi->width;
+    out[row - box->y0][col - box->x0] = img ? img[row][col] : 1;
+  }
+  return out;
+}
+
+unsigned char **RegionMask(const struct pixel_index *pi, uint32_t label,
+                           const struct region_box *box) {
+  return ExtractRegion(pi, label, NULL, box);
+}
+
+unsigned char **RegionCrop(const struct pixel_index *pi, uint32_t label,
+                           unsigned char **img,
+                           const struct region_box *box) {
+  return ExtractRegion(pi, label, img, box);
+}
+
+int WritePixelIndex(FILE *fp, const struct pixel_index *pi) {
+  uint32_t head[5] = {PIX_BYTE_ORDER, pi->width, pi->height, pi->nlabels, 0};
+  size_t noffsets = (size_t)pi->nlabels + 2;
+  size_t npix = (size_t)pi->width * pi->height;
+
+  if (fwrite(PIX_MAGIC, 1, 4, fp) != 4 || fwrite(head, 4, 5, fp) != 5 ||
+      fwrite(pi->offset, sizeof(uint32_t), noffsets, fp) != noffsets ||
+      fwrite(pi->index, sizeof(uint32_t), npix, fp) != npix) {
+    fprintf(stderr, "WritePixelIndex(): fwrite() error\n");
+    return -1;
+  }
+  return 0;
+}
+
+int MapPixelIndex(const char *path, struct pixel_index *pi) {
+  const uint32_t *head;
+  uint64_t noffsets, npix;
+  size_t size;
+  void *map;
+
+  memset(pi, 0, sizeof(*pi));
+  if ((map = MapFile(path, &size)) == NULL) return -1;
+  pi->map = map;
+  pi->map_size = size;
+
+  head = (const uint32_t *)map;
+  if (size < PIX_HEADER || memcmp(map, PIX_MAGIC, 4) != 0) {
+    fprintf(stderr, "MapPixelIndex(): not a pixel index\n");
+    FreePixelIndex(pi);
+    return -1;
+  }
+  if (head[1] != PIX_BYTE_ORDER) {
+    fprintf(stderr, "MapPixelIndex(): index written in another byte order\n");
+    FreePixelIndex(pi);
+    return -1;
+  }
+  pi->width = head[2];
+  pi->height = head[3];
+  pi->nlabels = head[4];
+  noffsets = (uint64_t)pi->nlabels + 2;
+  npix = (uint64_t)pi->width * pi->height;
+  if (size != PIX_HEADER + 4 * (noffsets + npix)) {
+    fprintf(stderr, "MapPixelIndex(): truncated index\n");
+    FreePixelIndex(pi);
+    return -1;
+  }
+  pi->offset = (uint32_t *)((char *)map + PIX_HEADER);
+  pi->index = pi->offset + noffsets;
+  if (CheckPixelIndex(pi)) {
+    fprintf(stderr, "MapPixelIndex(): corrupt index\n");
+    FreePixelIndex(pi);
+    return -1;
+  }
+  return 0;
+}
+
+int CheckPixelIndex(const struct pixel_index *pi) {
+  uint64_t npix = (uint64_t)pi->width * pi->height;
+
+  if (pi->offset[0] != 0 || pi->offset[pi->nlabels + 1] != npix) return -1;
+  for (uint64_t l = 0; l <= pi->nlabels; l++) {
+    if (pi->offset[l] > pi->offset[l + 1]) return -1;
+  }
+  for (uint64_t i = 0; i < npix; i++) {
+    if (pi->index[i] >= npix) return -1;
+  }
+  return 0;
+}
+
+void FreePixelIndex(struct pixel_index *pi) {
+  if (pi->map) {
+    UnmapFile(pi->map, pi->map_size);
+  } else {
+    free(pi->offset);
+    free(pi->index);
+  }
+  memset(pi, 0, sizeof(*pi));
+}
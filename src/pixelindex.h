@@ -0,0 +1,71 @@
+#ifndef _PIXELINDEX_H_
+#define _PIXELINDEX_H_
+
+#include <stdio.h>
+
+#include "typeutil.h"
+
+/* Index of the pixels of every label of a label image.
+ *
+ * BuildPixelIndex counting-sorts the pixel indices, row * width + col, by
+ * label in two raster passes over the label buffer: one counts the pixels
+ * of every label and turns the counts into offsets, the other scatters
+ * the pixels.  The pixels of label l are then index[offset[l]] ..
+ * index[offset[l + 1] - 1], in raster order, so the pixel list, bounding
+ * box, mask or crop of any region takes time proportional to its size
+ * instead of a scan of the image.
+ *
+ * The index is written as a header followed by the two arrays exactly as
+ * they are held in memory, so MapPixelIndex uses the file in place with
+ * mmap().  Mapping reads the file once to check it; nothing is copied. */
+
+struct pixel_index {
+  uint32_t width, height;
+  uint32_t nlabels;  /* labels 0 .. nlabels                     */
+  uint32_t *offset;  /* nlabels + 2 offsets into index          */
+  uint32_t *index;   /* width * height pixel indices, by label  */
+  void *map;         /* the mapped file, read-only, or NULL     */
+  size_t map_size;
+};
+
+struct region_box {
+  int x0, y0;        /* top-left pixel     */
+  int width, height; /* 0 x 0 if no pixels */
+};
+
+static inline uint32_t region_size(const struct pixel_index *pi,
+                                   uint32_t label) {
+  return pi->offset[label + 1] - pi->offset[label];
+}
+
+static inline const uint32_t *region_pixels(const struct pixel_index *pi,
+                                            uint32_t label) {
+  return pi->index + pi->offset[label];
+}
+
+/* seg holds labels 0 .. nlabels.  Returns 0 on success. */
+int BuildPixelIndex(unsigned int **seg, int width, int height,
+                    unsigned int nlabels, struct pixel_index *pi);
+
+void RegionBox(const struct pixel_index *pi, uint32_t label,
+               struct region_box *box);
+/* Returns a box->height x box->width image from get_img(), with 1 at the
+ * pixels of the region and 0 elsewhere */
+unsigned char **RegionMask(const struct pixel_index *pi, uint32_t label,
+                           const struct region_box *box);
+/* The same with the pixels of img */
+unsigned char **RegionCrop(const struct pixel_index *pi, uint32_t label,
+                           unsigned char **img,
+                           const struct region_box *box);
+
+int WritePixelIndex(FILE *fp, const struct pixel_index *pi);
+/* Maps a file written by WritePixelIndex.  The offsets and pixel indices
+ * are checked with CheckPixelIndex, so a corrupt file is rejected before
+ * any region is read.  Returns 0 on success. */
+int MapPixelIndex(const char *path, struct pixel_index *pi);
+void FreePixelIndex(struct pixel_index *pi);
+/* Returns 0 if the offsets run from 0 to width * height without ever
+ * decreasing and every pixel index is inside the image */
+int CheckPixelIndex(const struct pixel_index *pi);
+
+#endif /* _PIXELINDEX_H_ */
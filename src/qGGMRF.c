@@ -1,5 +1,7 @@
 #include "qGGMRF.h"
 
+#include <string.h>
+
 double get_btilde(
     double delta_prime, /* initial difference between pixel x_s^\prime and its
                            neighbor x_r^\prime */
@@ -61,3 +63,165 @@ double get_rho(
   rho = tmpa * tmpc;
   return rho;
 }
+
+/* Table-driven evaluation.  With s = |delta| / (T * sigma_x) the two
+   functions above can be written as
+
+     rho    = (T^p / p) * s^q / (1 + s^(q-p))
+     btilde = (b * T^(p-2) / (2 * sigma_x^2)) *
+              s^(q-2) * (q/p + s^(q-p)) / (1 + s^(q-p))^2
+
+   Both are tabulated at QGGMRF_SUB points per octave of s for
+   2^QGGMRF_EMIN <= s < 2^QGGMRF_EMAX.  A lookup takes the octave from the
+   exponent bits of s and the position within the octave from the mantissa
+   bits, then interpolates linearly.  Outside the tabulated range the exact
+   formulas are used.  For q == 2, with t = s^(2-p),
+
+     rho    = (T^p / p) * s^2 / (1 + t)
+     btilde = (b * T^(p-2) / (2 * sigma_x^2)) * (2/p + t) / (1 + t)^2
+
+   so only the bounded factors 1 / (1 + t) and (2/p + t) / (1 + t)^2 are
+   tabulated, and s^2 is computed exactly. */
+
+static double exact_rho_s(const struct qggmrf_table *t, double s);
+static double exact_btilde_s(const struct qggmrf_table *t, double s);
+static double table_lookup(const double *tab, double s, int *inrange);
+
+int qggmrf_table_init(struct qggmrf_table *t, double b, double sigma_x,
+                      double p, double q, double T)
+/* Builds the tables for fixed parameters.  Returns 0 on success. */
+{
+  int e, j, k, n;
+  double s, fr, fb, er;
+
+  t->b = b;
+  t->sigma_x = sigma_x;
+  t->p = p;
+  t->q = q;
+  t->T = T;
+  t->inv_Tsigma = 1.0 / (T * sigma_x);
+  t->rho_scale = pow(T, p) / p;
+  t->btilde_scale = b * pow(T, p - 2.0) / (2.0 * sigma_x * sigma_x);
+  t->q2 = (q == 2.0);
+
+  n = (QGGMRF_EMAX - QGGMRF_EMIN) * QGGMRF_SUB + 1;
+  t->rho_tab = (double *)malloc(n * sizeof(double));
+  t->btilde_tab = (double *)malloc(n * sizeof(double));
+  if (t->rho_tab == NULL || t->btilde_tab == NULL) {
+    qggmrf_table_free(t);
+    return (1);
+  }
+
+  for (k = 0; k < n; k++) {
+    e = QGGMRF_EMIN + k / QGGMRF_SUB;
+    j = k % QGGMRF_SUB;
+    s = ldexp(1.0 + (double)j / QGGMRF_SUB, e);
+    t->rho_tab[k] = exact_rho_s(t, s);
+    t->btilde_tab[k] = exact_btilde_s(t, s);
+  }
+
+  /* measure the interpolation error at the centre and quarter points of */
+  /* every interval, where it is largest                                 */
+  t->max_rel_err = 0.0;
+  for (k = 0; k < n - 1; k++) {
+    for (j = 1; j < 4; j++) {
+      e = QGGMRF_EMIN + k / QGGMRF_SUB;
+      s = ldexp(1.0 + (k % QGGMRF_SUB + j / 4.0) / QGGMRF_SUB, e);
+      fr = qggmrf_rho(t, s / t->inv_Tsigma);
+      fb = qggmrf_btilde(t, s / t->inv_Tsigma);
+      er = fabs(fr / get_rho(s / t->inv_Tsigma, b, sigma_x, p, q, T) - 1.0);
+      if (er > t->max_rel_err) t->max_rel_err = er;
+      er = fabs(fb / get_btilde(s / t->inv_Tsigma, b, sigma_x, p, q, T) - 1.0);
+      if (er > t->max_rel_err) t->max_rel_err = er;
+    }
+  }
+
+  return (0);
+}
+
+void qggmrf_table_free(struct qggmrf_table *t)
+{
+  free(t->rho_tab);
+  free(t->btilde_tab);
+  t->rho_tab = NULL;
+  t->btilde_tab = NULL;
+}
+
+static double exact_rho_s(const struct qggmrf_table *t, double s)
+/* rho as a function of s; the s^q factor is left out if q == 2 */
+{
+  double tmpb = pow(s, t->q - t->p);
+  return ((t->q2 ? 1.0 : t->rho_scale * pow(s, t->q)) / (1 + tmpb));
+}
+
+static double exact_btilde_s(const struct qggmrf_table *t, double s)
+/* btilde as a function of s; the constant factor is left out if q == 2 */
+{
+  double tmpb = pow(s, t->q - t->p);
+  return ((t->q2 ? 1.0 : t->btilde_scale * pow(s, t->q - 2.0)) *
+          ((t->q / t->p) + tmpb) / ((1 + tmpb) * (1 + tmpb)));
+}
+
+static double table_lookup(const double *tab, double s, int *inrange)
+/* Linear interpolation in tab at s; sets *inrange = 0 if s is outside */
+/* the tabulated range.                                                */
+{
+  uint64_t bits, mant;
+  int e, k;
+  double frac;
+
+  memcpy(&bits, &s, sizeof(bits));
+  e = (int)((bits >> 52) & 0x7ff) - 1023;
+  if (e < QGGMRF_EMIN || e >= QGGMRF_EMAX) {
+    *inrange = 0;
+    return (0.0);
+  }
+  mant = bits & (((uint64_t)1 << 52) - 1);
+  k = (e - QGGMRF_EMIN) * QGGMRF_SUB + (int)(mant >> (52 - QGGMRF_LOG2SUB));
+  frac = (double)(mant & (((uint64_t)1 << (52 - QGGMRF_LOG2SUB)) - 1)) *
+         (1.0 / ((uint64_t)1 << (52 - QGGMRF_LOG2SUB)));
+  *inrange = 1;
+  return (tab[k] + frac * (tab[k + 1] - tab[k]));
+}
+
+double qggmrf_rho(const struct qggmrf_table *t, double delta)
+/* Table-driven get_rho() */
+{
+  double s, v;
+  int inrange;
+
+  s = (fabs(delta) + t->sigma_x * DBL_EPSILON) * t->inv_Tsigma;
+  v = table_lookup(t->rho_tab, s, &inrange);
+  if (!inrange) v = exact_rho_s(t, s);
+  return (t->q2 ? t->rho_scale * s * s * v : v);
+}
+
+double qggmrf_btilde(const struct qggmrf_table *t, double delta)
+/* Table-driven get_btilde() */
+{
+  double s, v;
+  int inrange;
+
+  s = (fabs(delta) + t->sigma_x * DBL_EPSILON) * t->inv_Tsigma;
+  v = table_lookup(t->btilde_tab, s, &inrange);
+  if (!inrange) v = exact_btilde_s(t, s);
+  return (t->q2 ? t->btilde_scale * v : v);
+}
+
+void qggmrf_rho_array(const struct qggmrf_table *t, const double *delta,
+                      double *rho, int n)
+/* rho[i] = get_rho(delta[i], ...) for i = 0, ..., n-1 */
+{
+  int i;
+
+  for (i = 0; i < n; i++) rho[i] = qggmrf_rho(t, delta[i]);
+}
+
+void qggmrf_btilde_array(const struct qggmrf_table *t, const double *delta,
+                         double *btilde, int n)
+/* btilde[i] = get_btilde(delta[i], ...) for i = 0, ..., n-1 */
+{
+  int i;
+
+  for (i = 0; i < n; i++) btilde[i] = qggmrf_btilde(t, delta[i]);
+}
@@ -13,4 +13,43 @@ double get_btilde(double delta, double b, double sigma_x, double p, double q,
 double get_rho(double delta, double b, double sigma_x, double p, double q,
                double T);
 
+/* Precomputed evaluator of get_rho() and get_btilde() for fixed
+ * (b, sigma_x, p, q, T).  The functions are tabulated over
+ * s = |delta| / (T * sigma_x) with QGGMRF_SUB linearly interpolated
+ * intervals per octave for 2^QGGMRF_EMIN <= s < 2^QGGMRF_EMAX; outside
+ * that range the exact formulas are used.  For q == 2 only the bounded
+ * factors 1/(1+t) and (2/p+t)/(1+t)^2, t = s^(2-p), are tabulated, and
+ * the power s^q is evaluated exactly as s*s.
+ *
+ * The maximum relative error over the tabulated range is measured when
+ * the tables are built and stored in max_rel_err.  For
+ * 1.0 <= p <= q <= 2.0 it is below 1e-4 (about 6e-5 at p = 1.0, 4e-5 at
+ * the typical p = 1.2). */
+
+#define QGGMRF_LOG2SUB 6
+#define QGGMRF_SUB (1 << QGGMRF_LOG2SUB)
+#define QGGMRF_EMIN (-24)
+#define QGGMRF_EMAX 16
+
+struct qggmrf_table {
+  double b, sigma_x, p, q, T; /* parameters of the qGGMRF potential */
+  double inv_Tsigma;          /* 1 / (T * sigma_x)                   */
+  double rho_scale;           /* T^p / p                             */
+  double btilde_scale;        /* b * T^(p-2) / (2 * sigma_x^2)       */
+  int q2;                     /* 1 if q == 2                         */
+  double *rho_tab;            /* rho, or 1/(1+t) if q == 2           */
+  double *btilde_tab;         /* btilde, or (2/p+t)/(1+t)^2          */
+  double max_rel_err;         /* measured maximum relative error     */
+};
+
+int qggmrf_table_init(struct qggmrf_table *t, double b, double sigma_x,
+                      double p, double q, double T);
+void qggmrf_table_free(struct qggmrf_table *t);
+double qggmrf_rho(const struct qggmrf_table *t, double delta);
+double qggmrf_btilde(const struct qggmrf_table *t, double delta);
+void qggmrf_rho_array(const struct qggmrf_table *t, const double *delta,
+                      double *rho, int n);
+void qggmrf_btilde_array(const struct qggmrf_table *t, const double *delta,
+                         double *btilde, int n);
+
 #endif /* defined(____get_btilde__) */
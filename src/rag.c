@@ -0,0 +1,234 @@
+#include "rag.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "neighborhood.h"
+
+#define RAG_MAGIC "RAG1"
+#define RAG_BYTE_ORDER 0x01020304u
+
+/* Open-addressing hash table of the label pairs met so far, keyed by
+ * (a << 32) | b with a < b.  Key 0 marks an empty slot, since label 0 is
+ * never part of a pair. */
+struct pair_slot {
+  uint64_t key;
+  uint32_t length;
+  float min_diff;
+  double sum_diff;
+};
+
+struct pair_table {
+  struct pair_slot *slot;
+  size_t cap, n;
+  struct pair_slot *last; /* slot of the previous pair */
+};
+
+static void PairTableInit(struct pair_table *t) {
+  t->cap = 1024;
+  t->n = 0;
+  t->slot = (struct pair_slot *)get_spc(t->cap, sizeof(struct pair_slot));
+  t->last = NULL;
+}
+
+static inline size_t PairHash(uint64_t key, size_t cap) {
+  return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (cap - 1);
+}
+
+static struct pair_slot *FindSlot(struct pair_slot *slot, size_t cap,
+                                  uint64_t key) {
+  size_t h = PairHash(key, cap);
+
+  while (slot[h].key != 0 && slot[h].key != key) h = (h + 1) & (cap - 1);
+  return slot + h;
+}
+
+/* Doubles the table once it is half full */
+static void PairTableGrow(struct pair_table *t) {
+  size_t cap = 2 * t->cap;
+  struct pair_slot *slot;
+
+  slot = (struct pair_slot *)get_spc(cap, sizeof(struct pair_slot));
+  for (size_t i = 0; i < t->cap; i++) {
+    if (t->slot[i].key != 0) *FindSlot(slot, cap, t->slot[i].key) = t->slot[i];
+  }
+  free(t->slot);
+  t->slot = slot;
+  t->cap = cap;
+  t->last = NULL;
+}
+
+/* Adds one neighbor pair with labels a != b to the edge between them.
+ * Boundaries are traced pixel after pixel, so the previous pair is
+ * checked before the table. */
+static inline void AddPair(struct pair_table *t, uint32_t a, uint32_t b,
+                           double diff) {
+  uint64_t key = (a < b) ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+  struct pair_slot *s = t->last;
+
+  if (s == NULL || s->key != key) {
+    s = FindSlot(t->slot, t->cap, key);
+    if (s->key == 0) {
+      if (2 * (t->n + 1) > t->cap) {
+        PairTableGrow(t);
+        s = FindSlot(t->slot, t->cap, key);
+      }
+      s->key = key;
+      s->min_diff = (float)diff;
+      t->n++;
+    }
+    t->last = s;
+  }
+  s->length++;
+  s->sum_diff += diff;
+  if (diff < s->min_diff) s->min_diff = (float)diff;
+}
+
+static int CompareEdges(const void *p, const void *q) {
+  const struct rag_edge *e = (const struct rag_edge *)p;
+  const struct rag_edge *f = (const struct rag_edge *)q;
+
+  if (e->a != f->a) return (e->a < f->a) ? -1 : 1;
+  if (e->b != f->b) return (e->b < f->b) ? -1 : 1;
+  return 0;
+}
+
+/* Builds the adjacency of g from its sorted edges */
+static void BuildAdjacency(struct rag *g) {
+  uint32_t *next;
+
+  g->offset = (uint32_t *)get_spc((size_t)g->nlabels + 2, sizeof(uint32_t));
+  g->adj = (uint32_t *)mget_spc(2 * (size_t)g->nedges + 1, sizeof(uint32_t));
+  for (uint32_t e = 0; e < g->nedges; e++) {
+    g->offset[g->edges[e].a + 1]++;
+    g->offset[g->edges[e].b + 1]++;
+  }
+  for (uint32_t v = 0; v <= g->nlabels; v++) g->offset[v + 1] += g->offset[v];
+
+  next = (uint32_t *)mget_spc((size_t)g->nlabels + 1, sizeof(uint32_t));
+  memcpy(next, g->offset, ((size_t)g->nlabels + 1) * sizeof(uint32_t));
+  for (uint32_t e = 0; e < g->nedges; e++) {
+    g->adj[next[g->edges[e].a]++] = e;
+    g->adj[next[g->edges[e].b]++] = e;
+  }
+  free(next);
+}
+
+/* Moves the pairs of t into the sorted edges of g, and turns the pixel
+ * sums into the means of g, which takes over sum */
+static void FinishRAG(struct rag *g, struct pair_table *t, double *sum) {
+  uint32_t n = 0;
+
+  g->edges = (struct rag_edge *)mget_spc(t->n + 1, sizeof(struct rag_edge));
+  for (size_t i = 0; i < t->cap; i++) {
+    struct pair_slot *s = t->slot + i;
+    if (s->key == 0) continue;
+    g->edges[n].a = (uint32_t)(s->key >> 32);
+    g->edges[n].b = (uint32_t)s->key;
+    g->edges[n].length = s->length;
+    g->edges[n].min_diff = s->min_diff;
+    g->edges[n].mean_diff = (float)(s->sum_diff / s->length);
+    n++;
+  }
+  free(t->slot);
+  g->nedges = n;
+  qsort(g->edges, n, sizeof(struct rag_edge), CompareEdges);
+
+  g->mean = sum;
+  for (uint32_t v = 0; v <= g->nlabels; v++) {
+    if (g->size[v] > 0) sum[v] /= g->size[v];
+  }
+  BuildAdjacency(g);
+}
+
+#define PIXEL_T unsigned char
+#define PIXEL_DIFF(a, b) abs((int)(a) - (int)(b))
+#define PIXEL_NAME(f) f
+#include "rag.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+#define PIXEL_T uint16_t
+#define PIXEL_DIFF(a, b) abs((int)(a) - (int)(b))
+#define PIXEL_NAME(f) f##_u16
+#include "rag.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+#define PIXEL_T float
+#define PIXEL_DIFF(a, b) fabs((double)(a) - (double)(b))
+#define PIXEL_NAME(f) f##_f32
+#include "rag.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+int WriteRAG(FILE *fp, const struct rag *g) {
+  uint32_t head[3] = {RAG_BYTE_ORDER, g->nlabels, g->nedges};
+  size_t n = (size_t)g->nlabels + 1;
+
+  if (fwrite(RAG_MAGIC, 1, 4, fp) != 4 || fwrite(head, 4, 3, fp) != 3 ||
+      fwrite(g->size, sizeof(uint32_t), n, fp) != n ||
+      fwrite(g->mean, sizeof(double), n, fp) != n ||
+      fwrite(g->edges, sizeof(struct rag_edge), g->nedges, fp) != g->nedges) {
+    fprintf(stderr, "WriteRAG(): fwrite() error\n");
+    return -1;
+  }
+  return 0;
+}
+
+int ReadRAG(FILE *fp, struct rag *g) {
+  char magic[4];
+  uint32_t head[3];
+  size_t n;
+
+  memset(g, 0, sizeof(*g));
+  if (fread(magic, 1, 4, fp) != 4 || fread(head, 4, 3, fp) != 3 ||
+      memcmp(magic, RAG_MAGIC, 4) != 0) {
+    fprintf(stderr, "ReadRAG(): not a region adjacency graph\n");
+    return -1;
+  }
+  if (head[0] != RAG_BYTE_ORDER) {
+    fprintf(stderr, "ReadRAG(): graph written in another byte order\n");
+    return -1;
+  }
+  g->nlabels = head[1];
+  g->nedges = head[2];
+  n = (size_t)g->nlabels + 1;
+  g->size = (uint32_t *)mget_spc(n, sizeof(uint32_t));
+  g->mean = (double *)mget_spc(n, sizeof(double));
+  g->edges = (struct rag_edge *)mget_spc((size_t)g->nedges + 1,
+                                         sizeof(struct rag_edge));
+  if (fread(g->size, sizeof(uint32_t), n, fp) != n ||
+      fread(g->mean, sizeof(double), n, fp) != n ||
+      fread(g->edges, sizeof(struct rag_edge), g->nedges, fp) != g->nedges) {
+    fprintf(stderr, "ReadRAG(): truncated graph\n");
+    FreeRAG(g);
+    return -1;
+  }
+  // the edges index the region arrays; a corrupt file must not
+  for (uint32_t e = 0; e < g->nedges; e++) {
+    if (g->edges[e].a == 0 || g->edges[e].a >= g->edges[e].b ||
+        g->edges[e].b > g->nlabels) {
+      fprintf(stderr, "ReadRAG(): edge %u joins invalid labels %u and %u\n",
+              e, g->edges[e].a, g->edges[e].b);
+      FreeRAG(g);
+      return -1;
+    }
+  }
+  BuildAdjacency(g);
+  return 0;
+}
+
+void FreeRAG(struct rag *g) {
+  free(g->size);
+  free(g->mean);
+  free(g->edges);
+  free(g->offset);
+  free(g->adj);
+  memset(g, 0, sizeof(*g));
+}
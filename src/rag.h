@@ -0,0 +1,64 @@
+#ifndef _RAG_H_
+#define _RAG_H_
+
+#include <stdio.h>
+
+#include "typeutil.h"
+
+/* Region adjacency graph of a label image.
+ *
+ * BuildRAG makes one raster pass over the label buffer and the image,
+ * right after labeling while both are in memory.  Every pair of pixels
+ * that are neighbors in the neighborhood (see neighborhood.h) and carry
+ * different nonzero labels adds to the edge between the two labels: the
+ * boundary length counts such pairs, and the minimum and mean of their
+ * |difference| are kept.  Pairs are deduplicated in an open-addressing
+ * hash table; the edges are then sorted into a CSR adjacency.  The size
+ * and the mean pixel value of every region, label 0 included, are
+ * collected in the same pass. */
+
+struct rag_edge {
+  uint32_t a, b;   /* labels, a < b                      */
+  uint32_t length; /* neighbor pairs across the boundary */
+  float min_diff;  /* min |difference| of those pairs    */
+  float mean_diff; /* mean |difference| of those pairs   */
+};
+
+struct rag {
+  uint32_t nlabels;        /* regions 1 .. nlabels                  */
+  uint32_t nedges;         /* edges, sorted by (a, b)               */
+  uint32_t *size;          /* nlabels + 1 region sizes in pixels    */
+  double *mean;            /* nlabels + 1 mean pixel values         */
+  struct rag_edge *edges;
+  uint32_t *offset;        /* edges of region v are                 */
+  uint32_t *adj;           /* adj[offset[v] .. offset[v + 1])       */
+};
+
+/* seg holds labels 0 .. nlabels.  There is one function per pixel type.
+ * Returns 0 on success. */
+int BuildRAG(unsigned char **img, unsigned int **seg, int width, int height,
+             unsigned int neighborhood, unsigned int nlabels, struct rag *g);
+int BuildRAG_u16(uint16_t **img, unsigned int **seg, int width, int height,
+                 unsigned int neighborhood, unsigned int nlabels,
+                 struct rag *g);
+int BuildRAG_f32(float **img, unsigned int **seg, int width, int height,
+                 unsigned int neighborhood, unsigned int nlabels,
+                 struct rag *g);
+
+/* Returns the other end of edge e of region v */
+static inline uint32_t rag_neighbor(const struct rag *g, uint32_t e,
+                                    uint32_t v) {
+  return (g->edges[e].a == v) ? g->edges[e].b : g->edges[e].a;
+}
+
+/* Binary dump: the magic "RAG1", the word 0x01020304 in the byte order of
+ * the writer, nlabels and nedges as 32-bit words, nlabels + 1 sizes as
+ * 32-bit words, nlabels + 1 means as doubles, and nedges edges of three
+ * 32-bit words and two floats each.  The adjacency is rebuilt on reading.
+ * Both return 0 on success. */
+int WriteRAG(FILE *fp, const struct rag *g);
+int ReadRAG(FILE *fp, struct rag *g);
+
+void FreeRAG(struct rag *g);
+
+#endif /* _RAG_H_ */
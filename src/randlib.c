@@ -13,11 +13,13 @@ void exit();
       and a short is 16 bits.  These conventions are machine dependent and
       must therefore be verified before using.                     */
 
-static long int tmp;
-static uint32_t sd[2]; /*  tmp: 31 bit seed in GF( (2^31)-1 )   */
-                       /*  sd[0]: high order 15 bits of tmp     */
-                       /*  sd[1]: low order 16 bits of tmp      */
-/* NOTE: high order 16 bits of sd[0] and sd[1] are 0        */
+/* State used by the non-reentrant interface (random2(), normal(), ...).  */
+/* Each of those routines is a wrapper around its "_r" counterpart, so    */
+/* the sequence they generate is identical to the original static-global  */
+/* implementation.                                                        */
+static struct rand_state global_state = {0, {0, 0}, 1, 0.0};
+
+static uint32_t mulmod_prime(uint32_t a, uint32_t b);
 
 /* Generates 20 random #'s starting from a seed of 1  */
 /*
@@ -85,30 +87,61 @@ main()
 
 double random2()
 /* Uniform random number generator on (0,1] */
-/*  Algorithm:  newseed = (16807 * oldseed) MOD [(2^31) - 1]  ;
-                returned value = newseed / ( (2^31)-1 )  ;
-      newseed is stored in tmp and sd[0] and sd[1] are updated;
-      Since 16807 is a primitive element of GF[(2^31)-1], repeated calls
-      to random2() should generate all positive integers <= MAXPRIME
-      before repeating any one value.
-    Tested: Feb. 16, 1988;  verified the length of cycle of integers
-                             generated by repeated calls to random2()  */
+/* See random2_r() for the algorithm.       */
 {
-  *(sd + 1) *= 16807;
-  *sd *= 16807;
-  tmp = ((*sd) >> 15) + (((*sd) & 0x7fff) << 16);
-  tmp += (*(sd + 1));
-  if (tmp & 0x80000000) {
-    tmp++;
-    tmp &= 0x7fffffff;
-  }
-  *sd = tmp >> 16;
-  *(sd + 1) = tmp & 0xffff;
-  return (((double)tmp) / MAXPRIME);
+  return (random2_r(&global_state));
 }
 
 int32_t random3()
 /* random3(): modified on 10/23/89 from random2() to generate positive ints*/
+{
+  return (random3_r(&global_state));
+}
+
+void srandom2(uint32_t num)
+/* Set a new seed for random # generator  */
+{
+  srandom2_r(&global_state, num);
+}
+
+void readseed()
+/*  Reads random # generator seed from file: /tmp/randomseed */
+{
+  readseed_r(&global_state);
+}
+
+void writeseed()
+/*  Writes random # generator seed from file: /tmp/randomseed */
+{
+  writeseed_r(&global_state);
+}
+
+double normal()
+/*  Generates normal random numbers: N(0,1)  */
+{
+  return (normal_r(&global_state));
+}
+
+double dexprand()
+/*  Generates a double exponentially distributed random variable
+      with mean 0 and variance 2.                                 */
+{
+  return (dexprand_r(&global_state));
+}
+
+/* Reentrant interface.  Every routine below operates only on the state  */
+/* object it is passed, so separate threads may each own a state.        */
+
+void rand_init_r(struct rand_state *st, uint32_t seed)
+/* Initializes a state object: sets the seed and clears the value cached */
+/* by normal_r().                                                        */
+{
+  srandom2_r(st, seed);
+  st->even = 1;
+  st->b = 0.0;
+}
+
+double random2_r(struct rand_state *st)
 /* Uniform random number generator on (0,1] */
 /*  Algorithm:  newseed = (16807 * oldseed) MOD [(2^31) - 1]  ;
                 returned value = newseed / ( (2^31)-1 )  ;
@@ -119,46 +152,53 @@ int32_t random3()
     Tested: Feb. 16, 1988;  verified the length of cycle of integers
                              generated by repeated calls to random2()  */
 {
+  return (((double)random3_r(st)) / MAXPRIME);
+}
+
+int32_t random3_r(struct rand_state *st)
+/* Same recursion as random2_r(), returning the new seed as an integer */
+{
+  uint32_t *sd = st->sd;
+
   *(sd + 1) *= 16807;
   *sd *= 16807;
-  tmp = ((*sd) >> 15) + (((*sd) & 0x7fff) << 16);
-  tmp += (*(sd + 1));
-  if (tmp & 0x80000000) {
-    tmp++;
-    tmp &= 0x7fffffff;
+  st->tmp = ((*sd) >> 15) + (((*sd) & 0x7fff) << 16);
+  st->tmp += (*(sd + 1));
+  if (st->tmp & 0x80000000) {
+    st->tmp++;
+    st->tmp &= 0x7fffffff;
   }
-  *sd = tmp >> 16;
-  *(sd + 1) = tmp & 0xffff;
-  return ((int)tmp);
+  *sd = st->tmp >> 16;
+  *(sd + 1) = st->tmp & 0xffff;
+  return ((int)st->tmp);
 }
 
-void srandom2(uint32_t num)
+void srandom2_r(struct rand_state *st, uint32_t num)
 /* Set a new seed for random # generator  */
 {
-  tmp = num;
-  *sd = tmp >> 16;
-  *(sd + 1) = tmp & 0xffff;
+  st->tmp = num;
+  st->sd[0] = st->tmp >> 16;
+  st->sd[1] = st->tmp & 0xffff;
 }
 
-void readseed()
+void readseed_r(struct rand_state *st)
 /*  Reads random # generator seed from file: /tmp/randomseed */
 {
   FILE *fp1;
-  void writeseed();
 
   if ((fp1 = fopen("/tmp/randomseed", "r")) == NULL) {
     fprintf(stderr, "readseed: creating file /tmp/randomseed\n");
-    tmp = 143542612;
-    writeseed();
-    srandom2(tmp);
+    st->tmp = 143542612;
+    writeseed_r(st);
+    srandom2_r(st, st->tmp);
   } else {
-    fscanf(fp1, "%ld", &tmp);
-    srandom2(tmp);
+    fscanf(fp1, "%ld", &st->tmp);
+    srandom2_r(st, st->tmp);
     fclose(fp1);
   }
 }
 
-void writeseed()
+void writeseed_r(struct rand_state *st)
 /*  Writes random # generator seed from file: /tmp/randomseed */
 {
   FILE *fp1;
@@ -167,37 +207,336 @@ void writeseed()
     fprintf(stderr, "writeseed: can't open file /tmp/randomseed\n");
     exit(1);
   } else {
-    fprintf(fp1, "%ld", tmp);
+    fprintf(fp1, "%ld", st->tmp);
     fclose(fp1);
   }
 }
 
-double normal()
+double normal_r(struct rand_state *st)
 /*  Generates normal random numbers: N(0,1)  */
 {
-  static int32_t even = 1; /*   if  even = 0:  return b              */
-                           /*       even = 1:  compute 2 new values  */
-  static double b;         /*   temporary storage                    */
-  double a, r, theta, random2();
+  double a, r, theta;
 
-  if ((even = !even)) {
-    return (b);
+  /*   if  even = 0:  return b              */
+  /*       even = 1:  compute 2 new values  */
+  if ((st->even = !st->even)) {
+    return (st->b);
   } else {
-    theta = 2 * PI * random2();
-    r = sqrt(-2 * log(random2()));
+    theta = 2 * PI * random2_r(st);
+    r = sqrt(-2 * log(random2_r(st)));
     a = r * cos(theta);
-    b = r * sin(theta);
+    st->b = r * sin(theta);
     return (a);
   }
 }
 
-double dexprand()
+double dexprand_r(struct rand_state *st)
 /*  Generates a double exponentially distributed random variable
       with mean 0 and variance 2.                                 */
 {
-  double a, random2();
+  double a;
 
-  a = -log(random2());
-  if (random2() > 0.5) a = (-a);
+  a = -log(random2_r(st));
+  if (random2_r(st) > 0.5) a = (-a);
   return (a);
 }
+
+/* Jump-ahead.  Since newseed = 16807^n * oldseed MOD [(2^31) - 1] after */
+/* n steps, advancing a generator by n draws costs O(log n) modular      */
+/* multiplications instead of n calls to random2_r().                    */
+
+static uint32_t mulmod_prime(uint32_t a, uint32_t b)
+/* Computes (a * b) MOD [(2^31) - 1] for a, b < 2^31 */
+{
+  uint64_t v = (uint64_t)a * b;
+
+  v = (v & MAXPRIME) + (v >> 31);
+  v = (v & MAXPRIME) + (v >> 31);
+  if (v >= MAXPRIME) v -= MAXPRIME;
+  return ((uint32_t)v);
+}
+
+uint32_t rand_multiplier(uint64_t n)
+/* Returns 16807^n MOD [(2^31) - 1] by square-and-multiply.  The exponent */
+/* is reduced modulo the cycle length (2^31) - 2 first.                   */
+{
+  uint32_t result = 1, base = 16807;
+
+  n %= (MAXPRIME - 1);
+  while (n) {
+    if (n & 1) result = mulmod_prime(result, base);
+    base = mulmod_prime(base, base);
+    n >>= 1;
+  }
+  return (result);
+}
+
+void rand_jump_r(struct rand_state *st, uint64_t n)
+/* Advances the generator by n draws of random2_r()/random3_r(), so that */
+/* the next value returned is the one n+1 draws ahead.                   */
+{
+  uint32_t seed = (uint32_t)(st->tmp % MAXPRIME);
+
+  srandom2_r(st, mulmod_prime(seed, rand_multiplier(n)));
+}
+
+void rand_substream_r(struct rand_state *st, const struct rand_state *base,
+                      uint32_t index, uint64_t stride)
+/* Initializes st as the index-th of a family of disjoint substreams of   */
+/* base: substream k starts k*stride draws after base.  With stride at    */
+/* least the number of draws each consumer makes, substreams never        */
+/* overlap, and the union of substreams 0,1,... replays the base sequence. */
+{
+  uint64_t n;
+
+  n = ((uint64_t)(index % (MAXPRIME - 1)) * (stride % (MAXPRIME - 1))) %
+      (MAXPRIME - 1);
+  st->tmp = base->tmp;
+  st->sd[0] = base->sd[0];
+  st->sd[1] = base->sd[1];
+  st->even = 1;
+  st->b = 0.0;
+  rand_jump_r(st, n);
+}
+
+/* Bulk generation.  The Lehmer recursion is advanced RAND_LANES draws at */
+/* a time: lane i holds the seed that random3_r() would return on draw   */
+/* k+i, and multiplying every lane by 16807^RAND_LANES yields draws       */
+/* k+RAND_LANES+i.  The lanes are independent, so the inner loop          */
+/* vectorizes, and the concatenated output is exactly the sequence of     */
+/* repeated random3_r() calls.                                            */
+
+#define RAND_LANES 8
+#define RAND_CHUNK 512 /* number of integers buffered per refill */
+
+static void lehmer_fill(struct rand_state *st, uint32_t *out, size_t n)
+/* Writes the next n values of random3_r() into out and advances st */
+{
+  uint32_t lane[RAND_LANES], mult;
+  size_t k;
+  int i;
+
+  if (n == 0) return;
+  mult = rand_multiplier(RAND_LANES);
+  lane[0] = mulmod_prime((uint32_t)(st->tmp % MAXPRIME), 16807);
+  for (i = 1; i < RAND_LANES; i++) lane[i] = mulmod_prime(lane[i - 1], 16807);
+
+  for (k = 0; k + RAND_LANES <= n; k += RAND_LANES) {
+    for (i = 0; i < RAND_LANES; i++) {
+      out[k + i] = lane[i];
+      lane[i] = mulmod_prime(lane[i], mult);
+    }
+  }
+  for (i = 0; k < n; k++, i++) out[k] = lane[i];
+
+  srandom2_r(st, out[n - 1]);
+}
+
+void random2_fill_r(struct rand_state *st, double *x, size_t n)
+/* Fills x[0..n-1] with the next n values of random2_r() */
+{
+  uint32_t buf[RAND_CHUNK];
+  size_t k, m, i;
+
+  for (k = 0; k < n; k += m) {
+    m = (n - k < RAND_CHUNK) ? n - k : RAND_CHUNK;
+    lehmer_fill(st, buf, m);
+    for (i = 0; i < m; i++) x[k + i] = ((double)buf[i]) / MAXPRIME;
+  }
+}
+
+/* Ziggurat tables for the standard normal (Marsaglia and Tsang, 2000),  */
+/* scaled for the 31 bit integers produced by the Lehmer generator.      */
+/* zig_ready: 0 = not built, 1 = being built, 2 = ready.                 */
+
+#define ZIG_R 3.442619855899
+#define ZIG_V 9.91256303526217e-3
+#define ZIG_M 1073741824.0 /* 2^30 */
+
+struct zig_tables {
+  uint32_t kn[128];
+  double wn[128];
+  double fn[128];
+};
+
+static struct zig_tables zig;
+static int zig_ready = 0;
+
+static void zig_build(struct zig_tables *z)
+{
+  double dn = ZIG_R, tn = ZIG_R, q;
+  int i;
+
+  q = ZIG_V / exp(-.5 * dn * dn);
+  z->kn[0] = (uint32_t)((dn / q) * ZIG_M);
+  z->kn[1] = 0;
+  z->wn[0] = q / ZIG_M;
+  z->wn[127] = dn / ZIG_M;
+  z->fn[0] = 1.0;
+  z->fn[127] = exp(-.5 * dn * dn);
+  for (i = 126; i >= 1; i--) {
+    dn = sqrt(-2. * log(ZIG_V / dn + exp(-.5 * dn * dn)));
+    z->kn[i + 1] = (uint32_t)((dn / tn) * ZIG_M);
+    tn = dn;
+    z->fn[i] = exp(-.5 * dn * dn);
+    z->wn[i] = dn / ZIG_M;
+  }
+}
+
+static const struct zig_tables *zig_get(struct zig_tables *local)
+/* Returns the shared tables, building them on first use.  A thread that */
+/* finds another thread building them uses a private copy instead.       */
+{
+  int expected = 0;
+
+  if (__atomic_load_n(&zig_ready, __ATOMIC_ACQUIRE) == 2) return (&zig);
+  if (__atomic_compare_exchange_n(&zig_ready, &expected, 1, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    zig_build(&zig);
+    __atomic_store_n(&zig_ready, 2, __ATOMIC_RELEASE);
+    return (&zig);
+  }
+  if (expected == 2) return (&zig);
+  zig_build(local);
+  return (local);
+}
+
+/* Buffered source of Lehmer integers used by the rejection samplers */
+struct lehmer_buf {
+  struct rand_state *st;
+  uint32_t v[RAND_CHUNK];
+  int pos;
+};
+
+static uint32_t lehmer_next(struct lehmer_buf *lb)
+{
+  if (lb->pos == RAND_CHUNK) {
+    lehmer_fill(lb->st, lb->v, RAND_CHUNK);
+    lb->pos = 0;
+  }
+  return (lb->v[lb->pos++]);
+}
+
+static double zig_normal(const struct zig_tables *z, struct lehmer_buf *lb)
+/* One N(0,1) variate by the ziggurat method */
+{
+  int32_t hz;
+  uint32_t iz, j;
+  double x, y;
+
+  j = lehmer_next(lb);
+  hz = (int32_t)j - (1 << 30);
+  iz = j & 127;
+  if ((uint32_t)abs(hz) < z->kn[iz]) return (hz * z->wn[iz]);
+
+  for (;;) {
+    x = hz * z->wn[iz];
+    if (iz == 0) { /* sample from the tail beyond ZIG_R */
+      do {
+        x = -log(((double)lehmer_next(lb)) / MAXPRIME) / ZIG_R;
+        y = -log(((double)lehmer_next(lb)) / MAXPRIME);
+      } while (y + y < x * x);
+      return ((hz > 0) ? ZIG_R + x : -ZIG_R - x);
+    }
+    if (z->fn[iz] + (((double)lehmer_next(lb)) / MAXPRIME) *
+                        (z->fn[iz - 1] - z->fn[iz]) <
+        exp(-.5 * x * x))
+      return (x);
+
+    j = lehmer_next(lb);
+    hz = (int32_t)j - (1 << 30);
+    iz = j & 127;
+    if ((uint32_t)abs(hz) < z->kn[iz]) return (hz * z->wn[iz]);
+  }
+}
+
+void normal_fill_r(struct rand_state *st, double *x, size_t n, int mode)
+/* Fills x[0..n-1] with N(0,1) variates.                                 */
+/* mode = RAND_FILL_LEGACY: x is exactly the sequence of n normal_r()     */
+/*        calls, including the value cached by a previous normal_r().    */
+/* mode = RAND_FILL_FAST:   ziggurat method; about one draw per variate  */
+/*        and no transcendental functions in the common case.            */
+{
+  double u[RAND_CHUNK];
+  size_t k = 0, m, i;
+
+  if (mode == RAND_FILL_FAST) {
+    struct zig_tables local;
+    const struct zig_tables *z = zig_get(&local);
+    struct lehmer_buf lb;
+
+    lb.st = st;
+    lb.pos = RAND_CHUNK;
+    for (k = 0; k < n; k++) x[k] = zig_normal(z, &lb);
+    /* return the unused buffered draws to the stream */
+    if (lb.pos < RAND_CHUNK) srandom2_r(st, lb.v[lb.pos - 1]);
+    return;
+  }
+
+  if (n > 0 && st->even == 0) { /* value left over from normal_r() */
+    x[k++] = st->b;
+    st->even = 1;
+  }
+  while (n - k >= 2) { /* Box-Muller over whole pairs */
+    m = (n - k) & ~(size_t)1;
+    if (m > RAND_CHUNK) m = RAND_CHUNK;
+    random2_fill_r(st, u, m);
+    for (i = 0; i < m; i += 2) {
+      double r = sqrt(-2 * log(u[i + 1]));
+      double theta = 2 * PI * u[i];
+      x[k + i] = r * cos(theta);
+      x[k + i + 1] = r * sin(theta);
+    }
+    k += m;
+  }
+  if (k < n) x[k] = normal_r(st); /* odd count: leaves b cached */
+}
+
+void dexprand_fill_r(struct rand_state *st, double *x, size_t n, int mode)
+/* Fills x[0..n-1] with double exponential variates (mean 0, variance 2). */
+/* mode = RAND_FILL_LEGACY: exactly the sequence of n dexprand_r() calls. */
+/* mode = RAND_FILL_FAST:   inverse CDF, one draw per variate.           */
+{
+  double u[RAND_CHUNK];
+  size_t k, m, i;
+
+  if (mode == RAND_FILL_FAST) {
+    for (k = 0; k < n; k += m) {
+      m = (n - k < RAND_CHUNK) ? n - k : RAND_CHUNK;
+      random2_fill_r(st, u, m);
+      for (i = 0; i < m; i++) {
+        double v = 2 * u[i];
+        x[k + i] = (v <= 1.0) ? log(v) : -log(2.0 - v);
+      }
+    }
+    return;
+  }
+
+  for (k = 0; k < n; k += m / 2) {
+    m = 2 * (n - k);
+    if (m > RAND_CHUNK) m = RAND_CHUNK;
+    random2_fill_r(st, u, m);
+    for (i = 0; i < m; i += 2) {
+      double a = -log(u[i]);
+      x[k + i / 2] = (u[i + 1] > 0.5) ? -a : a;
+    }
+  }
+}
+
+void random2_fill(double *x, size_t n)
+/* Bulk random2(): same values as n calls to random2() */
+{
+  random2_fill_r(&global_state, x, n);
+}
+
+void normal_fill(double *x, size_t n, int mode)
+/* Bulk normal(); see normal_fill_r() for the meaning of mode */
+{
+  normal_fill_r(&global_state, x, n, mode);
+}
+
+void dexprand_fill(double *x, size_t n, int mode)
+/* Bulk dexprand(); see dexprand_fill_r() for the meaning of mode */
+{
+  dexprand_fill_r(&global_state, x, n, mode);
+}
@@ -8,6 +8,17 @@
 
 #include "typeutil.h"
 
+/* Explicit generator state for the reentrant "_r" interface.  A state   */
+/* must be initialized with rand_init_r() or rand_substream_r() before   */
+/* use.  Distinct threads should each own a distinct state.              */
+struct rand_state {
+  long int tmp;   /* 31 bit seed in GF( (2^31)-1 )                      */
+  uint32_t sd[2]; /* sd[0]: high order 15 bits of tmp                   */
+                  /* sd[1]: low order 16 bits of tmp                    */
+  int32_t even;   /* normal_r(): 0 if b holds a cached value            */
+  double b;       /* normal_r(): second value of the last Box-Muller pair */
+};
+
 double random2();
 int32_t random3();
 void srandom2(uint32_t num);
@@ -16,4 +27,30 @@ void writeseed();
 double normal();
 double dexprand();
 
+void rand_init_r(struct rand_state *st, uint32_t seed);
+double random2_r(struct rand_state *st);
+int32_t random3_r(struct rand_state *st);
+void srandom2_r(struct rand_state *st, uint32_t num);
+void readseed_r(struct rand_state *st);
+void writeseed_r(struct rand_state *st);
+double normal_r(struct rand_state *st);
+double dexprand_r(struct rand_state *st);
+
+/* Jump-ahead and parallel substreams */
+uint32_t rand_multiplier(uint64_t n);
+void rand_jump_r(struct rand_state *st, uint64_t n);
+void rand_substream_r(struct rand_state *st, const struct rand_state *base,
+                      uint32_t index, uint64_t stride);
+
+/* Bulk generators: fill an array with n variates */
+#define RAND_FILL_FAST 0   /* fastest method; different sequence        */
+#define RAND_FILL_LEGACY 1 /* same values as repeated single calls      */
+
+void random2_fill(double *x, size_t n);
+void normal_fill(double *x, size_t n, int mode);
+void dexprand_fill(double *x, size_t n, int mode);
+void random2_fill_r(struct rand_state *st, double *x, size_t n);
+void normal_fill_r(struct rand_state *st, double *x, size_t n, int mode);
+void dexprand_fill_r(struct rand_state *st, double *x, size_t n, int mode);
+
 #endif /* _RANDLIB_H_ */
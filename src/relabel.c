@@ -0,0 +1,89 @@
+#include "relabel.h"
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocate.h"
+#include "unionfind.h"
+
+/* Raster chunks of the prefix sum per thread, for load balance; the labels
+ * do not depend on it */
+#define RELABEL_CHUNKS_PER_THREAD 4
+
+int RelabelRoots(uint32_t *root, long npix, int min_connected_pixels,
+                 unsigned int *nlabels) {
+  uint32_t *size; /* set sizes, then the final label of every root */
+  uint32_t *chunk_base;
+  /* a negative minimum keeps every set, as 0 does */
+  uint32_t min =
+      (min_connected_pixels > 0) ? (uint32_t)min_connected_pixels : 0;
+  int nchunks, t;
+  long i;
+
+  if (npix > UINT32_MAX) {
+    fprintf(stderr, "RelabelRoots(): image too large\n");
+    return -1;
+  }
+  size = (uint32_t *)mget_spc(npix > 0 ? npix : 1, sizeof(uint32_t));
+
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < npix; i++) {
+    size[i] = 0;
+  }
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < npix; i++) {
+    __atomic_fetch_add(&size[root[i]], 1, __ATOMIC_RELAXED);
+  }
+
+  // mark: the kept roots of every chunk
+  nchunks = RELABEL_CHUNKS_PER_THREAD * omp_get_max_threads();
+  chunk_base = (uint32_t *)get_spc(nchunks + 1, sizeof(uint32_t));
+
+#pragma omp parallel for schedule(static)
+  for (t = 0; t < nchunks; t++) {
+    long lo = npix * t / nchunks, hi = npix * (t + 1) / nchunks;
+    uint32_t n = 0;
+    for (long k = lo; k < hi; k++) {
+      n += (root[k] == (uint32_t)k && size[k] > min);
+    }
+    chunk_base[t + 1] = n;
+  }
+
+  // scan: the first label of every chunk
+  for (t = 0; t < nchunks; t++) chunk_base[t + 1] += chunk_base[t];
+
+  // number the kept roots from the first label of their chunk
+#pragma omp parallel for schedule(static)
+  for (t = 0; t < nchunks; t++) {
+    long lo = npix * t / nchunks, hi = npix * (t + 1) / nchunks;
+    uint32_t label = chunk_base[t];
+    for (long k = lo; k < hi; k++) {
+      if (root[k] == (uint32_t)k) size[k] = (size[k] > min) ? ++label : 0;
+    }
+  }
+
+  // rewrite the buffer with the final labels
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < npix; i++) {
+    root[i] = size[root[i]];
+  }
+
+  *nlabels = chunk_base[nchunks];
+  free(chunk_base);
+  free(size);
+  return 0;
+}
+
+int ResolveLabels(uint32_t *parent, long npix, int min_connected_pixels,
+                  unsigned int *nlabels) {
+  long i;
+
+  // flatten: point every pixel at its root
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < npix; i++) {
+    parent[i] = uf_find_atomic(parent, (uint32_t)i);
+  }
+
+  return RelabelRoots(parent, npix, min_connected_pixels, nlabels);
+}
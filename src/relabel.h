@@ -0,0 +1,34 @@
+#ifndef _RELABEL_H_
+#define _RELABEL_H_
+
+#include "typeutil.h"
+
+/* Final relabeling shared by the labeling engines.
+ *
+ * An engine labels the pixels provisionally with the raster index of a
+ * root, the first pixel of their set in raster order.  The relabel stage
+ * counts the pixels of every root, keeps the roots of sets with more than
+ * min_connected_pixels pixels, and numbers them 1, 2, ... in raster order
+ * with an exclusive prefix sum: the image is cut into chunks, every chunk
+ * counts its kept roots in parallel, the counts are summed into the first
+ * label of each chunk, and the chunks then number their roots in parallel.
+ * A last parallel pass rewrites every pixel with the label of its root,
+ * or 0 if the root was not kept.
+ *
+ * The labels depend only on the sets, not on the order in which the
+ * threads run or on their number, so every engine gives the same labels
+ * as every other. */
+
+/* root[i] is the root of pixel i, and root[r] == r for every root r.  The
+ * roots are replaced in place by the final labels and the number of labels
+ * is returned in *nlabels.  A negative min_connected_pixels is taken as 0.
+ * Returns 0 on success. */
+int RelabelRoots(uint32_t *root, long npix, int min_connected_pixels,
+                 unsigned int *nlabels);
+
+/* The same from a union-find forest over npix pixels (see unionfind.h)
+ * whose roots are the first pixels of their sets, flattened first */
+int ResolveLabels(uint32_t *parent, long npix, int min_connected_pixels,
+                  unsigned int *nlabels);
+
+#endif /* _RELABEL_H_ */
@@ -0,0 +1,394 @@
+#include "rtree.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "mapfile.h"
+
+#define RTREE_MAGIC "RTR1"
+#define RTREE_BYTE_ORDER 0x01020304u
+#define RTREE_HEADER 24 /* magic, byte order, nentries, nnodes, nleaves, 0 */
+
+/* (F - 1) children per level on top of the root, and no more than
+ * log_F(2^32) + 1 levels */
+#define RTREE_STACK (RTREE_FANOUT * 16)
+
+/* An item to pack, by twice the center of its box */
+struct str_key {
+  int64_t x, y;
+  uint32_t index;
+};
+
+static int CompareX(const void *p, const void *q) {
+  const struct str_key *a = (const struct str_key *)p;
+  const struct str_key *b = (const struct str_key *)q;
+
+  if (a->x != b->x) return (a->x < b->x) ? -1 : 1;
+  if (a->y != b->y) return (a->y < b->y) ? -1 : 1;
+  return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+static int CompareY(const void *p, const void *q) {
+  const struct str_key *a = (const struct str_key *)p;
+  const struct str_key *b = (const struct str_key *)q;
+
+  if (a->y != b->y) return (a->y < b->y) ? -1 : 1;
+  if (a->x != b->x) return (a->x < b->x) ? -1 : 1;
+  return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+/* Sorts n keys into Sort-Tile-Recursive order: by x, then by y within
+ * each of the ceil(sqrt(P)) slices, P = ceil(n / RTREE_FANOUT) being the
+ * number of parents.  Consecutive runs of RTREE_FANOUT keys are then the
+ * children of one parent. */
+static void STROrder(struct str_key *keys, uint32_t n) {
+  uint32_t parents = (n + RTREE_FANOUT - 1) / RTREE_FANOUT;
+  uint32_t slices = (uint32_t)ceil(sqrt((double)parents));
+  uint64_t slice = (uint64_t)((parents + slices - 1) / slices) * RTREE_FANOUT;
+
+  qsort(keys, n, sizeof(struct str_key), CompareX);
+  for (uint64_t s = 0; s < n; s += slice) {
+    uint64_t m = (n - s < slice) ? n - s : slice;
+    qsort(keys + s, m, sizeof(struct str_key), CompareY);
+  }
+}
+
+static inline void SetKey(struct str_key *k, int32_t x0, int32_t y0,
+                          int32_t x1, int32_t y1, uint32_t index) {
+  k->x = (int64_t)x0 + x1;
+  k->y = (int64_t)y0 + y1;
+  k->index = index;
+}
+
+/* Number of nodes of a tree of n entries */
+static uint32_t CountNodes(uint32_t n) {
+  uint32_t total = 0;
+
+  while (n > 1 || (n == 1 && total == 0)) {
+    n = (n + RTREE_FANOUT - 1) / RTREE_FANOUT;
+    total += n;
+  }
+  return total;
+}
+
+/* Makes the parents of the n children at child, stride bytes apart, in
+ * parent[0 ..].  Entries and nodes both start with their box.  first is
+ * the index of the first child. */
+static void MakeParents(struct rtree_node *parent, const void *child,
+                        size_t stride, uint32_t n, uint32_t first) {
+  for (uint32_t c = 0; c < n; c += RTREE_FANOUT, parent++) {
+    uint32_t m = (n - c < RTREE_FANOUT) ? n - c : RTREE_FANOUT;
+    parent->x0 = parent->y0 = INT32_MAX;
+    parent->x1 = parent->y1 = INT32_MIN;
+    parent->first = first + c;
+    parent->count = m;
+    for (uint32_t k = c; k < c + m; k++) {
+      const int32_t *b = (const int32_t *)((const char *)child + k * stride);
+      if (b[0] < parent->x0) parent->x0 = b[0];
+      if (b[1] < parent->y0) parent->y0 = b[1];
+      if (b[2] > parent->x1) parent->x1 = b[2];
+      if (b[3] > parent->y1) parent->y1 = b[3];
+    }
+  }
+}
+
+int BuildRTree(const struct region_box *boxes,
+               const struct region_stats *stats, uint32_t nlabels,
+               struct rtree *t) {
+  struct rtree_entry *tmp;
+  struct str_key *keys;
+  uint32_t n = 0, nnodes, lo, hi;
+
+  memset(t, 0, sizeof(*t));
+  for (uint32_t l = 1; l <= nlabels; l++)
+    if (boxes[l].width > 0 && boxes[l].height > 0) n++;
+  nnodes = CountNodes(n);
+  t->nentries = n;
+  t->nnodes = nnodes;
+  t->nleaves = (n + RTREE_FANOUT - 1) / RTREE_FANOUT;
+  t->entries =
+      (struct rtree_entry *)mget_spc(n ? n : 1, sizeof(struct rtree_entry));
+  t->nodes = (struct rtree_node *)mget_spc(nnodes ? nnodes : 1,
+                                           sizeof(struct rtree_node));
+  if (n == 0) return 0;
+
+  // the entries, in STR order
+  tmp = (struct rtree_entry *)mget_spc(n, sizeof(struct rtree_entry));
+  keys = (struct str_key *)mget_spc(n, sizeof(struct str_key));
+  n = 0;
+  for (uint32_t l = 1; l <= nlabels; l++) {
+    const struct region_box *b = boxes + l;
+    struct rtree_entry *e = tmp + n;
+    if (b->width <= 0 || b->height <= 0) continue;
+    e->x0 = b->x0;
+    e->y0 = b->y0;
+    e->x1 = b->x0 + b->width - 1;
+    e->y1 = b->y0 + b->height - 1;
+    e->label = l;
+    e->cx = (float)stats[l].cx;
+    e->cy = (float)stats[l].cy;
+    SetKey(keys + n, e->x0, e->y0, e->x1, e->y1, n);
+    n++;
+  }
+  STROrder(keys, n);
+  for (uint32_t k = 0; k < n; k++) t->entries[k] = tmp[keys[k].index];
+  free(tmp);
+  MakeParents(t->nodes, t->entries, sizeof(struct rtree_entry), n, 0);
+
+  // every level above, from the one below it put in STR order
+  lo = 0;
+  hi = t->nleaves;
+  while (hi - lo > 1) {
+    uint32_t m = hi - lo;
+    struct rtree_node *level =
+        (struct rtree_node *)mget_spc(m, sizeof(struct rtree_node));
+    for (uint32_t k = 0; k < m; k++) {
+      const struct rtree_node *q = t->nodes + lo + k;
+      SetKey(keys + k, q->x0, q->y0, q->x1, q->y1, k);
+    }
+    STROrder(keys, m);
+    for (uint32_t k = 0; k < m; k++) level[k] = t->nodes[lo + keys[k].index];
+    memcpy(t->nodes + lo, level, m * sizeof(struct rtree_node));
+    free(level);
+    MakeParents(t->nodes + hi, t->nodes + lo, sizeof(struct rtree_node), m,
+                lo);
+    lo = hi;
+    hi += (m + RTREE_FANOUT - 1) / RTREE_FANOUT;
+  }
+  free(keys);
+  return 0;
+}
+
+static inline int Meets(const struct rtree_node *q, int32_t x0, int32_t y0,
+                        int32_t x1, int32_t y1) {
+  return q->x0 <= x1 && x0 <= q->x1 && q->y0 <= y1 && y0 <= q->y1;
+}
+
+uint32_t RTreeQueryRect(const struct rtree *t, const struct region_box *r,
+                        uint32_t *labels, uint32_t max) {
+  uint32_t stack[RTREE_STACK], top = 0, found = 0;
+  int32_t x0 = r->x0, y0 = r->y0;
+  int32_t x1 = r->x0 + r->width - 1, y1 = r->y0 + r->height - 1;
+
+  if (t->nentries == 0 || r->width <= 0 || r->height <= 0) return 0;
+  stack[top++] = t->nnodes - 1;
+  while (top > 0) {
+    const struct rtree_node *q = t->nodes + stack[--top];
+    if (!Meets(q, x0, y0, x1, y1)) continue;
+    if (q - t->nodes < (ptrdiff_t)t->nleaves) {
+      for (uint32_t k = q->first; k < q->first + q->count; k++) {
+        const struct rtree_entry *e = t->entries + k;
+        if (e->x0 <= x1 && x0 <= e->x1 && e->y0 <= y1 && y0 <= e->y1) {
+          if (found < max) labels[found] = e->label;
+          found++;
+        }
+      }
+    } else {
+      for (uint32_t k = q->first + q->count; k > q->first; k--)
+        stack[top++] = k - 1;
+    }
+  }
+  return found;
+}
+
+uint32_t RTreeQueryPoint(const struct rtree *t, int x, int y,
+                         uint32_t *labels, uint32_t max) {
+  struct region_box r = {x, y, 1, 1};
+
+  return RTreeQueryRect(t, &r, labels, max);
+}
+
+/* A node or entry to visit in order of its least possible distance */
+struct visit {
+  double d2;
+  uint32_t id;
+  int entry;
+};
+
+struct heap {
+  struct visit *v;
+  size_t n, cap;
+};
+
+/* Entries before nodes of the same distance, so they come out first */
+static inline int Before(const struct visit *p, const struct visit *q) {
+  if (p->d2 != q->d2) return p->d2 < q->d2;
+  if (p->entry != q->entry) return p->entry > q->entry;
+  return p->id < q->id;
+}
+
+static void HeapPush(struct heap *h, struct visit c) {
+  size_t i;
+
+  if (h->n == h->cap) {
+    h->cap = h->cap ? 2 * h->cap : 256;
+    h->v = (struct visit *)realloc(h->v, h->cap * sizeof(*h->v));
+    if (h->v == NULL) {
+      fprintf(stderr, "HeapPush(): realloc() error\n");
+      exit(-1);
+    }
+  }
+  for (i = h->n++; i > 0 && Before(&c, &h->v[(i - 1) / 2]); i = (i - 1) / 2)
+    h->v[i] = h->v[(i - 1) / 2];
+  h->v[i] = c;
+}
+
+static struct visit HeapPop(struct heap *h) {
+  struct visit top = h->v[0], c;
+  size_t i = 0, k;
+
+  c = h->v[--h->n];
+  while ((k = 2 * i + 1) < h->n) {
+    if (k + 1 < h->n && Before(&h->v[k + 1], &h->v[k])) k++;
+    if (!Before(&h->v[k], &c)) break;
+    h->v[i] = h->v[k];
+    i = k;
+  }
+  h->v[i] = c;
+  return top;
+}
+
+/* Squared distance from (x, y) to the box of q.  A centroid lies within
+ * the bounding box of its region, so no centroid under q is nearer. */
+static inline double BoxDistance2(const struct rtree_node *q, double x,
+                                  double y) {
+  double dx = (x < q->x0) ? q->x0 - x : (x > q->x1) ? x - q->x1 : 0.0;
+  double dy = (y < q->y0) ? q->y0 - y : (y > q->y1) ? y - q->y1 : 0.0;
+
+  return dx * dx + dy * dy;
+}
+
+uint32_t RTreeNearest(const struct rtree *t, double x, double y, uint32_t k,
+                      uint32_t *labels, double *dist) {
+  struct heap h = {NULL, 0, 0};
+  struct visit root;
+  uint32_t found = 0;
+
+  if (t->nentries == 0 || k == 0) return 0;
+  root.id = t->nnodes - 1;
+  root.entry = 0;
+  root.d2 = BoxDistance2(t->nodes + root.id, x, y);
+  HeapPush(&h, root);
+
+  // best first: an entry that comes out is nearer than all that remain
+  while (h.n > 0 && found < k) {
+    struct visit c = HeapPop(&h);
+    const struct rtree_node *q;
+    int leaf;
+
+    if (c.entry) {
+      labels[found] = t->entries[c.id].label;
+      if (dist) dist[found] = sqrt(c.d2);
+      found++;
+      continue;
+    }
+    q = t->nodes + c.id;
+    leaf = c.id < t->nleaves;
+    for (uint32_t i = q->first; i < q->first + q->count; i++) {
+      struct visit v;
+      v.id = i;
+      v.entry = leaf;
+      if (leaf) {
+        double dx = t->entries[i].cx - x, dy = t->entries[i].cy - y;
+        v.d2 = dx * dx + dy * dy;
+      } else {
+        v.d2 = BoxDistance2(t->nodes + i, x, y);
+      }
+      HeapPush(&h, v);
+    }
+  }
+  free(h.v);
+  return found;
+}
+
+int WriteRTree(FILE *fp, const struct rtree *t) {
+  uint32_t head[5] = {RTREE_BYTE_ORDER, t->nentries, t->nnodes, t->nleaves,
+                      0};
+
+  if (fwrite(RTREE_MAGIC, 1, 4, fp) != 4 || fwrite(head, 4, 5, fp) != 5 ||
+      fwrite(t->nodes, sizeof(struct rtree_node), t->nnodes, fp) !=
+          t->nnodes ||
+      fwrite(t->entries, sizeof(struct rtree_entry), t->nentries, fp) !=
+          t->nentries) {
+    fprintf(stderr, "WriteRTree(): fwrite() error\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* Checks that the nodes are the levels BuildRTree makes, with the
+ * children of every node within the level below, since the queries follow
+ * them without looking */
+static int ValidateTree(const struct rtree *t) {
+  uint32_t lo = 0, hi = t->nleaves, below = 0, nbelow = t->nentries;
+
+  if (t->nnodes != CountNodes(t->nentries) ||
+      t->nleaves != (t->nentries + RTREE_FANOUT - 1) / RTREE_FANOUT)
+    return -1;
+  while (lo < hi) {
+    for (uint32_t i = lo; i < hi; i++) {
+      const struct rtree_node *q = t->nodes + i;
+      if (q->count == 0 || q->count > RTREE_FANOUT || q->first < below ||
+          (uint64_t)q->first + q->count > (uint64_t)below + nbelow)
+        return -1;
+    }
+    below = lo;
+    nbelow = hi - lo;
+    lo = hi;
+    hi += (nbelow > 1) ? (nbelow + RTREE_FANOUT - 1) / RTREE_FANOUT : 0;
+  }
+  return hi == t->nnodes ? 0 : -1;
+}
+
+int MapRTree(const char *path, struct rtree *t) {
+  const uint32_t *head;
+  size_t size;
+  void *map;
+
+  memset(t, 0, sizeof(*t));
+  if ((map = MapFile(path, &size)) == NULL) return -1;
+  t->map = map;
+  t->map_size = size;
+
+  head = (const uint32_t *)map;
+  if (size < RTREE_HEADER || memcmp(map, RTREE_MAGIC, 4) != 0) {
+    fprintf(stderr, "MapRTree(): not an R-tree\n");
+    FreeRTree(t);
+    return -1;
+  }
+  if (head[1] != RTREE_BYTE_ORDER) {
+    fprintf(stderr, "MapRTree(): tree written in another byte order\n");
+    FreeRTree(t);
+    return -1;
+  }
+  t->nentries = head[2];
+  t->nnodes = head[3];
+  t->nleaves = head[4];
+  if (size != RTREE_HEADER + (uint64_t)t->nnodes * sizeof(struct rtree_node) +
+                  (uint64_t)t->nentries * sizeof(struct rtree_entry)) {
+    fprintf(stderr, "MapRTree(): truncated tree\n");
+    FreeRTree(t);
+    return -1;
+  }
+  t->nodes = (struct rtree_node *)((char *)map + RTREE_HEADER);
+  t->entries = (struct rtree_entry *)(t->nodes + t->nnodes);
+
+  if (ValidateTree(t) != 0) {
+    fprintf(stderr, "MapRTree(): bad tree\n");
+    FreeRTree(t);
+    return -1;
+  }
+  return 0;
+}
+
+void FreeRTree(struct rtree *t) {
+  if (t->map) {
+    UnmapFile(t->map, t->map_size);
+  } else {
+    free(t->nodes);
+    free(t->entries);
+  }
+  memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,80 @@
+#ifndef _RTREE_H_
+#define _RTREE_H_
+
+#include <stdio.h>
+
+#include "labelfile.h"
+#include "pixelindex.h"
+#include "typeutil.h"
+
+/* Spatial index of the regions of a label image, an R-tree over their
+ * bounding boxes packed by Sort-Tile-Recursive.
+ *
+ * The regions are sorted by the x of their box centers and cut into
+ * about sqrt(n / RTREE_FANOUT) vertical slices; every slice is sorted by
+ * y and cut into leaves of RTREE_FANOUT regions.  The leaves are packed
+ * into parents the same way, level by level up to a single root, so every
+ * node but the last of a level is full and nodes hardly overlap.  The
+ * tree is built once, in O(n log n), and is never updated.
+ *
+ * The nodes are stored bottom up, leaves first and the root last, and the
+ * children of every node are consecutive, so the tree is two flat arrays
+ * that are written as they are and used in place by MapRTree.
+ *
+ * Rectangle queries return the regions whose bounding box meets the
+ * rectangle.  A point query returns those whose box holds the point;
+ * the region that holds it is among them, and the label image (see
+ * LabelFileAt) tells which.  Nearest-neighbor queries rank the regions
+ * by the distance of their centroid from a point. */
+
+#define RTREE_FANOUT 16
+
+struct rtree_entry {
+  int32_t x0, y0, x1, y1; /* bounding box, inclusive */
+  uint32_t label;
+  float cx, cy;           /* centroid                */
+};
+
+struct rtree_node {
+  int32_t x0, y0, x1, y1; /* bounds of the children                  */
+  uint32_t first;         /* first child, an entry if the node is a   */
+  uint32_t count;         /* leaf, a node otherwise                   */
+};
+
+struct rtree {
+  uint32_t nentries;
+  uint32_t nnodes;
+  uint32_t nleaves;            /* nodes 0 .. nleaves - 1 are leaves */
+  struct rtree_entry *entries; /* in leaf order                     */
+  struct rtree_node *nodes;    /* root last                         */
+  void *map;                   /* the mapped file, read-only, or NULL */
+  size_t map_size;
+};
+
+/* Indexes the regions 1 .. nlabels that have pixels, from their boxes
+ * and statistics (see labelfile.h).  Returns 0 on success. */
+int BuildRTree(const struct region_box *boxes,
+               const struct region_stats *stats, uint32_t nlabels,
+               struct rtree *t);
+
+/* Writes the labels of the regions whose box meets r to labels, at most
+ * max of them.  Returns the number of such regions, which may be larger
+ * than max. */
+uint32_t RTreeQueryRect(const struct rtree *t, const struct region_box *r,
+                        uint32_t *labels, uint32_t max);
+/* The same for the regions whose box holds pixel (x, y) */
+uint32_t RTreeQueryPoint(const struct rtree *t, int x, int y,
+                         uint32_t *labels, uint32_t max);
+/* Writes the labels of the k regions whose centroids are nearest to
+ * (x, y) to labels, nearest first, and their distances to dist if it is
+ * not NULL.  Returns the number found, less than k only if the tree has
+ * fewer regions. */
+uint32_t RTreeNearest(const struct rtree *t, double x, double y, uint32_t k,
+                      uint32_t *labels, double *dist);
+
+int WriteRTree(FILE *fp, const struct rtree *t);
+/* Maps a file written by WriteRTree.  Returns 0 on success. */
+int MapRTree(const char *path, struct rtree *t);
+void FreeRTree(struct rtree *t);
+
+#endif /* _RTREE_H_ */
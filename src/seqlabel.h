@@ -0,0 +1,50 @@
+#ifndef _SEQLABEL_H_
+#define _SEQLABEL_H_
+
+#include "typeutil.h"
+
+/* Single-threaded labeling engines.
+ *
+ * LabelDFS is the depth-first flood fill of ConnectedSet run from every
+ * unlabeled pixel, with its stack on the heap.  Each fill follows the
+ * region wherever it goes, so once the image no longer fits in cache
+ * almost every step misses.
+ *
+ * LabelTiled labels the image one tile_size x tile_size tile at a time.
+ * A tile is labeled completely with a tile-local union-find whose parent
+ * array, together with the tile's pixels and labels, stays in L2 cache.
+ * A second phase merges the sets across the tile borders with a global
+ * union-find over the label buffer.  The default 128 x 128 tile needs
+ * about 144 KB.
+ *
+ * Both engines produce the labels of LabelParallel and GetAllConnectedSets.
+ * neighborhood is a symmetric mask of NB_* offsets (see neighborhood.h).
+ * seg must be a height x width array allocated with get_img().  The number
+ * of labels is returned in *nlabels.  Return 0 on success. */
+
+#define TILE_SIZE 128
+
+int LabelDFS(unsigned char **img, int width, int height, double threshold,
+             unsigned int neighborhood, int min_connected_pixels,
+             unsigned int **seg, unsigned int *nlabels);
+
+/* tile_size <= 0 selects TILE_SIZE. */
+int LabelTiled(unsigned char **img, int width, int height, double threshold,
+               unsigned int neighborhood, int min_connected_pixels,
+               int tile_size, unsigned int **seg, unsigned int *nlabels);
+
+/* The same for 16-bit and floating-point images */
+int LabelDFS_u16(uint16_t **img, int width, int height, double threshold,
+                 unsigned int neighborhood, int min_connected_pixels,
+                 unsigned int **seg, unsigned int *nlabels);
+int LabelDFS_f32(float **img, int width, int height, double threshold,
+                 unsigned int neighborhood, int min_connected_pixels,
+                 unsigned int **seg, unsigned int *nlabels);
+int LabelTiled_u16(uint16_t **img, int width, int height, double threshold,
+                   unsigned int neighborhood, int min_connected_pixels,
+                   int tile_size, unsigned int **seg, unsigned int *nlabels);
+int LabelTiled_f32(float **img, int width, int height, double threshold,
+                   unsigned int neighborhood, int min_connected_pixels,
+                   int tile_size, unsigned int **seg, unsigned int *nlabels);
+
+#endif /* _SEQLABEL_H_ */
@@ -1,5 +1,6 @@
 #include "solve.h"
 
+#include <float.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,6 +8,8 @@
 
 #include "typeutil.h"
 
+static int check_bracket(double fa, double fb, int *code);
+
 double
 solve(/* pointer to function to be solved */
       double (*f)(double x, void *pblock),
@@ -24,32 +27,38 @@ solve(/* pointer to function to be solved */
 /* Returns code=-1 if signs are both negative.                      */
 /* Returns code=-2 if a NAN or infinity creeps into computation.    */
 {
-  int signa, signb, signc;
+  return (solve_bisection(f, pblock, a, b, err, code, NULL));
+}
+
+double solve_bisection(double (*f)(double x, void *pblock), void *pblock,
+                       double a, double b, double err, int *code,
+                       struct solve_stats *stats)
+/* Same as solve(), and records the work done in *stats if stats != NULL. */
+{
+  int signa, signc;
   double fa, fb, fc, c;
   double dist;
+  int nevals = 2, niter = 0;
 
   fa = f(a, pblock);
   signa = fa > 0;
   fb = f(b, pblock);
-  signb = fb > 0;
   if (!isfinite(fa)) goto err;
   if (!isfinite(fb)) goto err;
 
   /* check starting conditions */
-  if (signa == signb) {
-    if (signa == 1)
-      *code = 1;
-    else
-      *code = -1;
-    return (0.0);
-  } else
-    *code = 0;
+  if (check_bracket(fa, fb, code)) {
+    c = 0.0;
+    goto done;
+  }
 
   /* half interval search */
   if ((dist = b - a) < 0) dist = -dist;
   while (dist > err) {
     c = (b + a) / 2;
     fc = f(c, pblock);
+    nevals++;
+    niter++;
     signc = fc > 0;
     if (!isfinite(fc)) goto err;
 
@@ -65,13 +74,399 @@ solve(/* pointer to function to be solved */
 
   /* linear interpolation */
   if ((fb - fa) == 0)
-    return (a);
-  else {
+    c = a;
+  else
     c = (a * fb - b * fa) / (fb - fa);
-    return (c);
+  goto done;
+
+err:
+  *code = -2;
+  c = a;
+
+done:
+  if (stats != NULL) {
+    stats->evaluations = nevals;
+    stats->iterations = niter;
+  }
+  return (c);
+}
+
+static int check_bracket(double fa, double fb, int *code)
+/* Sets *code from the signs of f at the two ends of the interval, using */
+/* the same convention as solve().  Returns 1 if there is no sign change. */
+{
+  int signa = fa > 0, signb = fb > 0;
+
+  if (signa == signb) {
+    if (signa == 1)
+      *code = 1;
+    else
+      *code = -1;
+    return (1);
+  }
+  *code = 0;
+  return (0);
+}
+
+/* Number of consecutive interpolation steps allowed without halving the */
+/* bracket before a bisection step is forced.  Plain Brent can take many  */
+/* more evaluations than bisection near a multiple root; this bounds it.  */
+#define BRENT_MAX_SLOW 2
+
+/* Brent's method.  The iteration is split into brent_step(), which picks  */
+/* the next point to evaluate, and brent_update(), which takes f at that   */
+/* point, so that the batched solver can interleave many problems.         */
+
+void brent_init(struct brent_state *s, double a, double b, double fa,
+                double fb, double err)
+/* Starts an iteration on [a,b]; fa and fb must have opposite signs. */
+{
+  s->a = a;
+  s->b = b;
+  s->c = a;
+  s->fa = fa;
+  s->fb = fb;
+  s->fc = fa;
+  s->d = s->e = b - a;
+  s->err = err;
+  s->width = fabs(b - a);
+  s->slow = 0;
+  if (fabs(s->fc) < fabs(s->fb)) { /* keep the best estimate in b */
+    s->a = s->b;
+    s->b = s->c;
+    s->c = s->a;
+    s->fa = s->fb;
+    s->fb = s->fc;
+    s->fc = s->fa;
+  }
+}
+
+int brent_step(struct brent_state *s, double *x)
+/* Returns 1 if the iteration has converged to s->b.  Otherwise returns 0 */
+/* and the next point at which f must be evaluated in *x.                 */
+{
+  double tol1, xm, p, q, r, t, min1, min2;
+
+  tol1 = 2.0 * DBL_EPSILON * fabs(s->b) + 0.5 * s->err;
+  xm = 0.5 * (s->c - s->b);
+  if (fabs(xm) <= tol1 || s->fb == 0.0) return (1);
+
+  if (s->slow >= BRENT_MAX_SLOW) { /* bracket not halving, force bisection */
+    s->d = xm;
+    s->e = s->d;
+    s->slow = 0;
+  } else if (fabs(s->e) >= tol1 && fabs(s->fa) > fabs(s->fb)) {
+    /* attempt inverse quadratic interpolation (secant if a == c) */
+    t = s->fb / s->fa;
+    if (s->a == s->c) {
+      p = 2.0 * xm * t;
+      q = 1.0 - t;
+    } else {
+      q = s->fa / s->fc;
+      r = s->fb / s->fc;
+      p = t * (2.0 * xm * q * (q - r) - (s->b - s->a) * (r - 1.0));
+      q = (q - 1.0) * (r - 1.0) * (t - 1.0);
+    }
+    if (p > 0) q = -q;
+    p = fabs(p);
+    min1 = 3.0 * xm * q - fabs(tol1 * q);
+    min2 = fabs(s->e * q);
+    if (2.0 * p < (min1 < min2 ? min1 : min2)) { /* accept interpolation */
+      s->e = s->d;
+      s->d = p / q;
+    } else { /* interpolation failed, use bisection */
+      s->d = xm;
+      s->e = s->d;
+    }
+  } else { /* bounds decreasing too slowly, use bisection */
+    s->d = xm;
+    s->e = s->d;
+  }
+
+  s->a = s->b;
+  s->fa = s->fb;
+  if (fabs(s->d) > tol1)
+    *x = s->b + s->d;
+  else
+    *x = s->b + (xm > 0 ? tol1 : -tol1);
+  return (0);
+}
+
+void brent_update(struct brent_state *s, double x, double fx)
+/* Incorporates fx = f(x) for the point x returned by brent_step() */
+{
+  s->b = x;
+  s->fb = fx;
+  if ((s->fb > 0 && s->fc > 0) || (s->fb < 0 && s->fc < 0)) {
+    s->c = s->a; /* re-establish the bracket [b,c] */
+    s->fc = s->fa;
+    s->e = s->d = s->b - s->a;
+  }
+  if (fabs(s->fc) < fabs(s->fb)) {
+    s->a = s->b;
+    s->b = s->c;
+    s->c = s->a;
+    s->fa = s->fb;
+    s->fb = s->fc;
+    s->fc = s->fa;
+  }
+  if (fabs(s->c - s->b) <= 0.5 * s->width) {
+    s->width = fabs(s->c - s->b);
+    s->slow = 0;
+  } else
+    s->slow++;
+}
+
+double solve_brent(double (*f)(double x, void *pblock), void *pblock,
+                   double a, double b, double err, int *code,
+                   struct solve_stats *stats)
+/* Solves (*f)(x) = 0 on [a,b] by Brent's method: inverse quadratic     */
+/* interpolation safeguarded by bisection.  Error codes are the same as  */
+/* for solve().                                                          */
+{
+  struct brent_state s;
+  double fa, fb, x, fx;
+  int nevals = 2, niter = 0;
+
+  fa = f(a, pblock);
+  fb = f(b, pblock);
+  if (!isfinite(fa) || !isfinite(fb)) {
+    *code = -2;
+    x = a;
+    goto done;
+  }
+  if (check_bracket(fa, fb, code)) {
+    x = 0.0;
+    goto done;
+  }
+
+  brent_init(&s, a, b, fa, fb, err);
+  while (!brent_step(&s, &x)) {
+    fx = f(x, pblock);
+    nevals++;
+    niter++;
+    if (!isfinite(fx)) {
+      *code = -2;
+      x = s.a;
+      goto done;
+    }
+    brent_update(&s, x, fx);
+  }
+  x = s.b;
+
+done:
+  if (stats != NULL) {
+    stats->evaluations = nevals;
+    stats->iterations = niter;
+  }
+  return (x);
+}
+
+double solve_illinois(double (*f)(double x, void *pblock), void *pblock,
+                      double a, double b, double err, int *code,
+                      struct solve_stats *stats)
+/* Solves (*f)(x) = 0 on [a,b] by the Illinois variant of regula falsi: */
+/* when the same end of the bracket is retained twice in a row, its      */
+/* function value is halved, which prevents the one-sided convergence of */
+/* plain false position.  Error codes are the same as for solve().       */
+{
+  double fa, fb, sfa, sfb, c, fc, dist;
+  int side = 0; /* -1: a was retained last time; +1: b was retained */
+  int nevals = 2, niter = 0;
+
+  fa = f(a, pblock);
+  fb = f(b, pblock);
+  if (!isfinite(fa) || !isfinite(fb)) goto err;
+  if (check_bracket(fa, fb, code)) {
+    c = 0.0;
+    goto done;
+  }
+
+  sfa = fa; /* scaled function values used for interpolation */
+  sfb = fb;
+  if ((dist = b - a) < 0) dist = -dist;
+  while (dist > err) {
+    c = (a * sfb - b * sfa) / (sfb - sfa);
+
+    /* step at least err/2 from either end so the bracket collapses */
+    /* once the root is within tolerance of one of them             */
+    if (fabs(c - a) < 0.5 * err) c = a + ((b > a) ? 0.5 : -0.5) * err;
+    if (fabs(c - b) < 0.5 * err) c = b - ((b > a) ? 0.5 : -0.5) * err;
+
+    fc = f(c, pblock);
+    nevals++;
+    niter++;
+    if (!isfinite(fc)) goto err;
+    if (fc == 0.0) goto done;
+
+    if ((fc > 0) == (fa > 0)) {
+      a = c;
+      fa = sfa = fc;
+      if (side == +1) sfb /= 2;
+      side = +1;
+    } else {
+      b = c;
+      fb = sfb = fc;
+      if (side == -1) sfa /= 2;
+      side = -1;
+    }
+    if ((dist = b - a) < 0) dist = -dist;
   }
 
+  /* linear interpolation */
+  if ((fb - fa) == 0)
+    c = a;
+  else
+    c = (a * fb - b * fa) / (fb - fa);
+  goto done;
+
 err:
   *code = -2;
-  return a;
+  c = a;
+
+done:
+  if (stats != NULL) {
+    stats->evaluations = nevals;
+    stats->iterations = niter;
+  }
+  return (c);
+}
+
+/* Batched solver.  Problems are processed SOLVE_BATCH at a time; within a */
+/* batch every active lane advances one iteration per call of (*f), which */
+/* receives only the lanes that have not converged yet.  Batches are      */
+/* distributed over threads.                                              */
+
+static void solve_lanes(void (*f)(const double *x, double *fx, const int *idx,
+                                  int K, void *pblock),
+                        void *pblock, const double *a, const double *b,
+                        int first, int K, double err, int method, double *root,
+                        int *code, struct solve_stats *stats)
+/* Solves problems first, ..., first+K-1 in lockstep */
+{
+  struct brent_state bs[SOLVE_BATCH];
+  double lo[SOLVE_BATCH], hi[SOLVE_BATCH], flo[SOLVE_BATCH], fhi[SOLVE_BATCH];
+  double x[SOLVE_BATCH], fx[SOLVE_BATCH];
+  int lane[SOLVE_BATCH], idx[SOLVE_BATCH], active[SOLVE_BATCH];
+  int i, k, m, nactive = 0;
+
+  if (K <= 0) return;
+
+  /* evaluate f at both ends of every bracket */
+  for (i = 0; i < K; i++) {
+    idx[i] = first + i;
+    x[i] = a[first + i];
+  }
+  f(x, flo, idx, K, pblock);
+  for (i = 0; i < K; i++) x[i] = b[first + i];
+  f(x, fhi, idx, K, pblock);
+  stats->evaluations += 2 * K;
+  stats->iterations += 2;
+
+  for (i = 0; i < K; i++) {
+    k = first + i;
+    lo[i] = a[k];
+    hi[i] = b[k];
+    active[i] = 0;
+    if (!isfinite(flo[i]) || !isfinite(fhi[i])) {
+      code[k] = -2;
+      root[k] = lo[i];
+    } else if (check_bracket(flo[i], fhi[i], &code[k])) {
+      root[k] = 0.0;
+    } else {
+      active[i] = 1;
+      nactive++;
+      if (method == SOLVE_BRENT)
+        brent_init(&bs[i], lo[i], hi[i], flo[i], fhi[i], err);
+    }
+  }
+
+  while (nactive > 0) {
+    /* gather the next point of every active lane */
+    for (i = 0, m = 0; i < K; i++) {
+      if (!active[i]) continue;
+      if (method == SOLVE_BRENT) {
+        if (brent_step(&bs[i], &x[m])) {
+          root[first + i] = bs[i].b;
+          active[i] = 0;
+          nactive--;
+          continue;
+        }
+      } else {
+        if (fabs(hi[i] - lo[i]) <= err) {
+          root[first + i] = ((fhi[i] - flo[i]) == 0)
+                                ? lo[i]
+                                : (lo[i] * fhi[i] - hi[i] * flo[i]) /
+                                      (fhi[i] - flo[i]);
+          active[i] = 0;
+          nactive--;
+          continue;
+        }
+        x[m] = (lo[i] + hi[i]) / 2;
+      }
+      lane[m] = i;
+      idx[m] = first + i;
+      m++;
+    }
+    if (m == 0) break;
+
+    f(x, fx, idx, m, pblock);
+    stats->evaluations += m;
+    stats->iterations++;
+
+    /* scatter the results back to the lanes */
+    for (k = 0; k < m; k++) {
+      i = lane[k];
+      if (!isfinite(fx[k])) {
+        code[first + i] = -2;
+        root[first + i] = (method == SOLVE_BRENT) ? bs[i].a : lo[i];
+        active[i] = 0;
+        nactive--;
+      } else if (method == SOLVE_BRENT) {
+        brent_update(&bs[i], x[k], fx[k]);
+      } else if ((fx[k] > 0) == (flo[i] > 0)) {
+        lo[i] = x[k];
+        flo[i] = fx[k];
+      } else {
+        hi[i] = x[k];
+        fhi[i] = fx[k];
+      }
+    }
+  }
+}
+
+int solve_batch(void (*f)(const double *x, double *fx, const int *idx, int K,
+                          void *pblock),
+                void *pblock, const double *a, const double *b, int n,
+                double err, int method, double *root, int *code,
+                struct solve_stats *stats)
+/* Solves n independent equations f_i(x) = 0 on [a[i],b[i]].             */
+/* (*f) evaluates K problems at once: fx[k] = f_{idx[k]}(x[k]).           */
+/* method is SOLVE_BISECTION or SOLVE_BRENT.  Roots are returned in      */
+/* root[i] and error codes, with the same meaning as for solve(), in     */
+/* code[i].  If stats != NULL it receives the total number of scalar     */
+/* evaluations and of calls to (*f).  Returns the number of problems     */
+/* with code != 0.                                                       */
+{
+  int nbatch = (n + SOLVE_BATCH - 1) / SOLVE_BATCH;
+  int t, i, nfail = 0;
+  long evaluations = 0, calls = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+ : evaluations, calls)
+  for (t = 0; t < nbatch; t++) {
+    struct solve_stats local = {0, 0};
+    int first = t * SOLVE_BATCH;
+    int K = (n - first < SOLVE_BATCH) ? n - first : SOLVE_BATCH;
+
+    solve_lanes(f, pblock, a, b, first, K, err, method, root, code, &local);
+    evaluations += local.evaluations;
+    calls += local.iterations;
+  }
+
+  for (i = 0; i < n; i++) nfail += (code[i] != 0);
+  if (stats != NULL) {
+    stats->evaluations = evaluations;
+    stats->iterations = calls;
+  }
+  return (nfail);
 }
@@ -20,4 +20,68 @@ solve(/* pointer to function to be solved */
       int *code     /* error code */
 );
 
+/* Work done by a solver call; pass NULL to the solvers if not needed */
+struct solve_stats {
+  long evaluations; /* number of calls to (*f), including the two ends */
+  long iterations;  /* number of iterations after the bracket check     */
+};
+
+/* The following solvers take the same arguments and return the same
+ * error codes as solve(), plus an optional stats out-parameter.
+ *
+ * solve_bisection: the half interval method used by solve()
+ * solve_brent:     Brent's method (inverse quadratic interpolation
+ *                  safeguarded by bisection)
+ * solve_illinois:  regula falsi with the Illinois modification
+ *
+ * See SolveBenchmark.c */
+
+double solve_bisection(double (*f)(double x, void *pblock), void *pblock,
+                       double a, double b, double err, int *code,
+                       struct solve_stats *stats);
+double solve_brent(double (*f)(double x, void *pblock), void *pblock,
+                   double a, double b, double err, int *code,
+                   struct solve_stats *stats);
+double solve_illinois(double (*f)(double x, void *pblock), void *pblock,
+                      double a, double b, double err, int *code,
+                      struct solve_stats *stats);
+
+/* Resumable Brent iteration, for callers that evaluate f themselves.
+ * brent_step() returns 1 when converged (the root is s->b), otherwise
+ * it returns 0 and the point x at which f must be evaluated next; the
+ * value is then passed back through brent_update(). */
+struct brent_state {
+  double a, b, c;    /* b: best estimate; [b,c] brackets the root */
+  double fa, fb, fc; /* function values at a, b, c                */
+  double d, e;       /* last and second-to-last step sizes        */
+  double err;        /* accuracy of solution                      */
+  double width;      /* bracket width when it last halved         */
+  int slow;          /* steps since the bracket last halved       */
+};
+
+void brent_init(struct brent_state *s, double a, double b, double fa,
+                double fb, double err);
+int brent_step(struct brent_state *s, double *x);
+void brent_update(struct brent_state *s, double x, double fx);
+
+/* Batched solver for n independent equations f_i(x) = 0 on [a[i],b[i]].
+ * The callback evaluates K problems at once, fx[k] = f_{idx[k]}(x[k]),
+ * so it can be written as a vectorizable loop.  All problems of a batch
+ * advance in lockstep; converged problems are dropped from subsequent
+ * calls.  Batches are spread over OpenMP threads, so the callback must
+ * be reentrant.  Returns the number of problems with code[i] != 0.
+ *
+ * For solve_batch, stats->evaluations counts scalar evaluations and
+ * stats->iterations counts calls to the callback. */
+
+#define SOLVE_BISECTION 0
+#define SOLVE_BRENT 1
+#define SOLVE_BATCH 64 /* problems per batch */
+
+int solve_batch(void (*f)(const double *x, double *fx, const int *idx, int K,
+                          void *pblock),
+                void *pblock, const double *a, const double *b, int n,
+                double err, int method, double *root, int *code,
+                struct solve_stats *stats);
+
 #endif /* _SOLVE_H_ */
@@ -0,0 +1,144 @@
+#include "streamlabel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "unionfind.h"
+
+#define NONE 0xffffffffu
+
+static void Finalize(struct count_stream *cs, unsigned long n) {
+  int bin = 0;
+
+  cs->counts.nregions++;
+  if (n > cs->counts.max_size) cs->counts.max_size = n;
+  if (n <= cs->min_size) return;
+  cs->counts.nkept++;
+  while (bin < COUNT_HIST_BINS - 1 && (n >> (bin + 1)) != 0) bin++;
+  cs->counts.histogram[bin]++;
+}
+
+int CountStreamInit(struct count_stream *cs, int width, double threshold,
+                    unsigned long min_size) {
+  memset(cs, 0, sizeof(*cs));
+  cs->width = width;
+  cs->threshold = threshold;
+  cs->min_size = min_size;
+  cs->prev = (uint8_t *)mget_spc(width, sizeof(uint8_t));
+  cs->prev_lab = (uint32_t *)mget_spc(width, sizeof(uint32_t));
+  cs->cur_lab = (uint32_t *)mget_spc(width, sizeof(uint32_t));
+  cs->parent = (uint32_t *)mget_spc(2 * width, sizeof(uint32_t));
+  cs->size = (unsigned long *)mget_spc(2 * width, sizeof(unsigned long));
+  cs->mark = (uint32_t *)mget_spc(2 * width, sizeof(uint32_t));
+  cs->newid = (uint32_t *)mget_spc(2 * width, sizeof(uint32_t));
+  cs->live_size = (unsigned long *)mget_spc(width, sizeof(unsigned long));
+  return 0;
+}
+
+/**
+ * @brief Adds one row to the stream
+ *
+ * Components of the previous row have ids 0 .. nprev-1; every pixel of the
+ * new row starts as its own component nprev + x and is merged with its
+ * left and upper neighbors when they are within the threshold.  Afterwards
+ * previous-row components that do not reach the new row are finalized,
+ * and the surviving components are renumbered 0, 1, ...
+ */
+void CountStreamRow(struct count_stream *cs, const uint8_t *row) {
+  int width = cs->width, x;
+  uint32_t base = cs->nprev, i, r, k = 0;
+  uint32_t *parent = cs->parent;
+  double T = cs->threshold;
+
+  for (x = 0; x < width; x++) {
+    uint32_t id = base + x, a, b;
+    parent[id] = id;
+    cs->size[id] = 1;
+    if (x > 0 && abs(row[x] - row[x - 1]) <= T) {
+      a = uf_find(parent, id);
+      b = uf_find(parent, base + x - 1);
+      if (a != b) {
+        r = uf_union(parent, a, b);
+        cs->size[r] = cs->size[a] + cs->size[b];
+      }
+    }
+    if (cs->nrows > 0 && abs(row[x] - cs->prev[x]) <= T) {
+      a = uf_find(parent, id);
+      b = uf_find(parent, cs->prev_lab[x]);
+      if (a != b) {
+        r = uf_union(parent, a, b);
+        cs->size[r] = cs->size[a] + cs->size[b];
+      }
+    }
+  }
+
+  // mark the roots that reach the new row
+  for (i = 0; i < base + width; i++) cs->mark[i] = 0;
+  for (x = 0; x < width; x++) {
+    cs->cur_lab[x] = uf_find(parent, base + x);
+    cs->mark[cs->cur_lab[x]] = 1;
+  }
+
+  // previous-row components that do not reach this row are complete
+  for (i = 0; i < base; i++) {
+    r = uf_find(parent, i);
+    if (cs->mark[r] == 0) {
+      Finalize(cs, cs->size[r]);
+      cs->mark[r] = 2;
+    }
+  }
+
+  // renumber the live components 0 .. k-1
+  for (i = 0; i < base + width; i++) cs->newid[i] = NONE;
+  for (x = 0; x < width; x++) {
+    r = cs->cur_lab[x];
+    if (cs->newid[r] == NONE) {
+      cs->newid[r] = k;
+      cs->live_size[k] = cs->size[r];
+      k++;
+    }
+    cs->cur_lab[x] = cs->newid[r];
+  }
+  for (i = 0; i < k; i++) {
+    parent[i] = i;
+    cs->size[i] = cs->live_size[i];
+  }
+
+  uint32_t *t = cs->prev_lab;
+  cs->prev_lab = cs->cur_lab;
+  cs->cur_lab = t;
+  memcpy(cs->prev, row, width);
+  cs->nprev = k;
+  cs->nrows++;
+}
+
+void CountStreamFinish(struct count_stream *cs, struct component_counts *cc) {
+  for (uint32_t i = 0; i < cs->nprev; i++) Finalize(cs, cs->size[i]);
+  cs->nprev = 0;
+  *cc = cs->counts;
+}
+
+void CountStreamFree(struct count_stream *cs) {
+  free(cs->prev);
+  free(cs->prev_lab);
+  free(cs->cur_lab);
+  free(cs->parent);
+  free(cs->size);
+  free(cs->mark);
+  free(cs->newid);
+  free(cs->live_size);
+}
+
+int CountConnectedSets(unsigned char **img, int width, int height,
+                       double threshold, int min_connected_pixels,
+                       struct component_counts *cc) {
+  struct count_stream cs;
+
+  CountStreamInit(&cs, width, threshold, min_connected_pixels);
+  for (int y = 0; y < height; y++) CountStreamRow(&cs, img[y]);
+  CountStreamFinish(&cs, cc);
+  CountStreamFree(&cs);
+  return 0;
+}
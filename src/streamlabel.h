@@ -0,0 +1,48 @@
+#ifndef _STREAMLABEL_H_
+#define _STREAMLABEL_H_
+
+#include "typeutil.h"
+
+/* Count-only labeling.  Rows are fed one at a time; only the previous row
+ * of pixels and two rows of provisional labels are kept, together with a
+ * union-find over the components that touch the current row.  A component
+ * that does not reach the newest row can no longer grow, so it is
+ * finalized and its storage reused.  Memory is O(width). */
+
+#define COUNT_HIST_BINS 32 /* bin k holds sizes in [2^k, 2^(k+1)) */
+
+struct component_counts {
+  unsigned long nregions;  /* number of connected sets                 */
+  unsigned long nkept;     /* sets with more than min_size pixels      */
+  unsigned long max_size;  /* size of the largest set                  */
+  unsigned long histogram[COUNT_HIST_BINS]; /* sizes of the kept sets  */
+};
+
+struct count_stream {
+  int width;
+  double threshold;
+  unsigned long min_size;
+  int nrows;        /* rows processed so far                  */
+  uint32_t nprev;   /* components touching the previous row   */
+  uint8_t *prev;    /* previous row of pixels                 */
+  uint32_t *prev_lab, *cur_lab;   /* provisional labels        */
+  uint32_t *parent;               /* union-find, 2 * width     */
+  unsigned long *size;            /* pixels per component      */
+  uint32_t *mark, *newid;         /* per-row scratch           */
+  unsigned long *live_size;       /* per-row scratch           */
+  struct component_counts counts;
+};
+
+int CountStreamInit(struct count_stream *cs, int width, double threshold,
+                    unsigned long min_size);
+void CountStreamRow(struct count_stream *cs, const uint8_t *row);
+/* Finalizes the components of the last row and returns the counts */
+void CountStreamFinish(struct count_stream *cs, struct component_counts *cc);
+void CountStreamFree(struct count_stream *cs);
+
+/* Counts the connected sets of a whole image by streaming its rows */
+int CountConnectedSets(unsigned char **img, int width, int height,
+                       double threshold, int min_connected_pixels,
+                       struct component_counts *cc);
+
+#endif /* _STREAMLABEL_H_ */
@@ -92,16 +92,20 @@ static int32_t WriteRational(FILE *fp, struct Rational *Rat);
 static int32_t WriteUnsignedLong(FILE *fp, uint32_t *UnsignedLong);
 static int32_t WriteUnsignedShort(FILE *fp, uint16_t *UnsignedShort);
 static int32_t WriteUnsignedChar(FILE *fp, uint8_t *UnsignedChar);
+static int32_t WriteTIFFFrom(FILE *fp, struct TIFF_img *img,
+                            uint32_t **narrow);
 static int32_t WriteImageData(FILE *fp, struct TIFF_img *img,
+                              uint32_t **narrow,
                               struct DataLocation *DataLoc);
 static void FreeStripBuffer(uint8_t *buffer);
 static void AllocateStripBuffer(uint8_t **buffer, struct DataLocation *DataLoc,
                                 int32_t width);
-static int32_t PutStrip(FILE *fp, struct TIFF_img *img,
+static int32_t PutStrip(FILE *fp, struct TIFF_img *img, uint32_t **narrow,
                         struct DataLocation *DataLoc, uint8_t *strip_buf,
                         uint32_t strip_index);
-static int32_t PackStrip(struct TIFF_img *img, struct DataLocation *DataLoc,
-                         uint8_t *buffer, uint32_t strip_index);
+static int32_t PackStrip(struct TIFF_img *img, uint32_t **narrow,
+                         struct DataLocation *DataLoc, uint8_t *buffer,
+                         uint32_t strip_index);
 static int32_t WriteStrip(FILE *fp, struct DataLocation *DataLoc,
                           uint8_t *strip_buf, uint32_t strip_index);
 static int32_t MakeImageDataLocInfo(struct TIFF_img *img,
@@ -121,6 +125,7 @@ static int32_t PrepareIFD(struct TIFF_img *img, struct IFD *ifd,
                           struct DataLocation *DataLoc);
 static int32_t AddSpecialFieldEntries(struct TIFF_img *img, struct IFD *ifd);
 static int32_t AddGrayscaleFields(struct IFD *ifd, char TIFF_type);
+static int32_t MakeSampleFormatField(struct IFD *ifd, char TIFF_type);
 static int32_t AddPaletteColorFields(struct TIFF_img *img, struct IFD *ifd);
 static int32_t AddColorFields(struct IFD *ifd, char TIFF_type);
 static int32_t SortFields(struct IFD *ifd);
@@ -180,6 +185,7 @@ static int32_t GetImageType(struct IFD *ifd, char *TIFF_type);
 static int32_t IsImageFullColor(struct IFD *ifd);
 static int32_t IsImagePaletteColor(struct IFD *ifd);
 static int32_t IsImageGrayscale(struct IFD *ifd);
+static int32_t GetGrayscaleType(struct IFD *ifd, char *TIFF_type);
 static struct TIFF_field *GetFieldStructure(struct IFD *ifd, uint16_t Tag);
 static int32_t CheckForCoreFields(struct IFD *ifd);
 static int32_t WhatAboutCoreField(struct IFD *ifd, uint16_t Tag);
@@ -187,10 +193,11 @@ static int32_t AddDefaultField(struct IFD *ifd, uint16_t Tag);
 static void TellUserACoreFieldIsNecessary(uint16_t Tag);
 static int32_t IsThereADefaultFor(uint16_t Tag);
 static int32_t IsThereAFieldFor(struct IFD *ifd, uint16_t Tag);
-static int32_t ReadIFD(FILE *fp, struct IFD *ifd, struct TIFF_header *header,
-                       char *TIFF_type);
+static int32_t ReadIFD(FILE *fp, struct IFD *ifd, uint32_t OffsetOfIFD,
+                       char *TIFF_type, uint32_t *OffsetOfNextIFD);
 static int32_t SeeIfThereAreOtherIFDs(FILE *fp, uint32_t OffsetOfIFD,
-                                      uint16_t MaxNumberOfFields);
+                                      uint16_t MaxNumberOfFields,
+                                      uint32_t *OffsetOfNextIFD);
 static int32_t SetFilePositionAtFirstByteOfIthField(FILE *fp,
                                                     uint32_t OffsetOfIFD,
                                                     uint16_t i);
@@ -292,6 +299,11 @@ static void free_img(void **pt);
 #define Inch 2 /* (this is the default)  */
 #define Centimeter 3
 
+#define SampleFormat 339    /* interpretation of each */
+#define UnsignedInteger 1   /* sample (16- and 32-bit */
+#define IEEEFloatingPoint 3 /* grayscale is unsigned  */
+                            /* or floating point)     */
+
 #define ColorMap 320 /* color map for palette- */
                      /* color images           */
                      /* (the count for this    */
@@ -332,6 +344,13 @@ uint8_t *charsequence = (uint8_t *)longsequence;
 uint16_t FileByteOrder = BigEndian;
 
 int32_t write_TIFF(FILE *fp, struct TIFF_img *img) {
+  return (WriteTIFFFrom(fp, img, NULL));
+}
+
+/* writes img; if narrow is not NULL, the data of 'g' and 'w' */
+/* images is taken from this 32-bit array and narrowed        */
+static int32_t WriteTIFFFrom(FILE *fp, struct TIFF_img *img,
+                             uint32_t **narrow) {
   struct IFD ifd;
   struct TIFF_header header;
   struct DataLocation DataLoc;
@@ -342,7 +361,7 @@ int32_t write_TIFF(FILE *fp, struct TIFF_img *img) {
 
   /* write image data, store information about */
   /* location of the data in DataLoc structure */
-  if (WriteImageData(fp, img, &(DataLoc)) == ERROR) return (ERROR);
+  if (WriteImageData(fp, img, narrow, &(DataLoc)) == ERROR) return (ERROR);
 
   /* prepare header and image file directory */
   if (PrepareHeaderAndIFD(img, &(ifd), &(header), &(DataLoc)) == ERROR)
@@ -358,6 +377,31 @@ int32_t write_TIFF(FILE *fp, struct TIFF_img *img) {
   return (NO_ERROR);
 }
 
+int32_t write_TIFF_u32(FILE *fp, uint32_t **data, int32_t height,
+                       int32_t width, int32_t bits_per_sample) {
+  struct TIFF_img img;
+
+  if (bits_per_sample == 8)
+    img.TIFF_type = 'g';
+  else if (bits_per_sample == 16)
+    img.TIFF_type = 'w';
+  else if (bits_per_sample == 32)
+    img.TIFF_type = 'l';
+  else {
+    fprintf(stderr, "tiff.c:  function write_TIFF_u32:\n");
+    fprintf(stderr, "%d bits per sample is not supported\n",
+            bits_per_sample);
+    return (ERROR);
+  }
+  img.height = height;
+  img.width = width;
+  img.compress_type = 'u';
+  img.mono32 = data;
+
+  /* 'l' images are written from mono32 as they are */
+  return (WriteTIFFFrom(fp, &img, (img.TIFF_type != 'l') ? data : NULL));
+}
+
 int32_t get_TIFF(struct TIFF_img *img, int32_t height, int32_t width,
                  char TIFF_type) {
   int32_t i;
@@ -381,6 +425,26 @@ int32_t get_TIFF(struct TIFF_img *img, int32_t height, int32_t width,
     return (NO_ERROR);
   }
 
+  /* if image is 16-bit grayscale */
+  if (img->TIFF_type == 'w') {
+    img->mono16 =
+        (uint16_t **)get_img(img->width, img->height, sizeof(uint16_t));
+    return (NO_ERROR);
+  }
+
+  /* if image is 32-bit grayscale */
+  if (img->TIFF_type == 'l') {
+    img->mono32 =
+        (uint32_t **)get_img(img->width, img->height, sizeof(uint32_t));
+    return (NO_ERROR);
+  }
+
+  /* if image is floating-point grayscale */
+  if (img->TIFF_type == 'f') {
+    img->monof = (float **)get_img(img->width, img->height, sizeof(float));
+    return (NO_ERROR);
+  }
+
   /* if image is palette-color */
   if (img->TIFF_type == 'p') {
     img->mono = (uint8_t **)get_img(img->width, img->height, sizeof(uint8_t));
@@ -411,6 +475,17 @@ void free_TIFF(struct TIFF_img *img) {
     free_img((void **)(img->mono));
   }
 
+  /* 16-bit, 32-bit and floating-point grayscale */
+  if (img->TIFF_type == 'w') {
+    free_img((void **)(img->mono16));
+  }
+  if (img->TIFF_type == 'l') {
+    free_img((void **)(img->mono32));
+  }
+  if (img->TIFF_type == 'f') {
+    free_img((void **)(img->monof));
+  }
+
   /* palette-color */
   if (img->TIFF_type == 'p') {
     free_img((void **)(img->mono));
@@ -420,6 +495,7 @@ void free_TIFF(struct TIFF_img *img) {
   /* full color */
   if (img->TIFF_type == 'c') {
     for (i = 0; i < 3; i++) free_img((void **)(img->color[i]));
+    free((void *)(img->color));
   }
 }
 
@@ -716,6 +792,7 @@ static int32_t WriteUnsignedChar(FILE *fp, uint8_t *UnsignedChar) {
 }
 
 static int32_t WriteImageData(FILE *fp, struct TIFF_img *img,
+                              uint32_t **narrow,
                               struct DataLocation *DataLoc) {
   uint8_t *strip_buf;
   uint32_t strip_index;
@@ -729,7 +806,7 @@ static int32_t WriteImageData(FILE *fp, struct TIFF_img *img,
 
   /* write down one strip at a time */
   for (strip_index = 0; strip_index < DataLoc->StripsPerImage; strip_index++)
-    if (PutStrip(fp, img, DataLoc, strip_buf, strip_index) == ERROR)
+    if (PutStrip(fp, img, narrow, DataLoc, strip_buf, strip_index) == ERROR)
       return (ERROR);
 
   FreeStripBuffer(strip_buf);
@@ -755,11 +832,11 @@ static void AllocateStripBuffer(uint8_t **buffer, struct DataLocation *DataLoc,
                                 sizeof(uint8_t));
 }
 
-static int32_t PutStrip(FILE *fp, struct TIFF_img *img,
+static int32_t PutStrip(FILE *fp, struct TIFF_img *img, uint32_t **narrow,
                         struct DataLocation *DataLoc, uint8_t *strip_buf,
                         uint32_t strip_index) {
   if (img->compress_type == 'u') {
-    if (PackStrip(img, DataLoc, strip_buf, strip_index) == ERROR)
+    if (PackStrip(img, narrow, DataLoc, strip_buf, strip_index) == ERROR)
       return (ERROR);
   } else {
     fprintf(stderr, "tiff.c:  function PutStrip:\n");
@@ -773,8 +850,9 @@ static int32_t PutStrip(FILE *fp, struct TIFF_img *img,
   return (NO_ERROR);
 }
 
-static int32_t PackStrip(struct TIFF_img *img, struct DataLocation *DataLoc,
-                         uint8_t *buffer, uint32_t strip_index) {
+static int32_t PackStrip(struct TIFF_img *img, uint32_t **narrow,
+                         struct DataLocation *DataLoc, uint8_t *buffer,
+                         uint32_t strip_index) {
   uint32_t i, first_row, bytes_packed, current_row;
   int32_t j;
 
@@ -788,8 +866,26 @@ static int32_t PackStrip(struct TIFF_img *img, struct DataLocation *DataLoc,
     if (current_row < (uint32_t)img->height)
       for (j = 0; j < img->width; j++) {
         if ((img->TIFF_type == 'g') || (img->TIFF_type == 'p'))
-          buffer[bytes_packed++] = img->mono[current_row][j];
-        else if (img->TIFF_type == 'c') {
+          buffer[bytes_packed++] =
+              (narrow != NULL) ? (uint8_t)narrow[current_row][j]
+                               : img->mono[current_row][j];
+        else if (img->TIFF_type == 'w') {
+          /* the writer stores multi-byte samples big-endian */
+          uint16_t us = (narrow != NULL) ? (uint16_t)narrow[current_row][j]
+                                         : img->mono16[current_row][j];
+          buffer[bytes_packed++] = (uint8_t)(us >> 8);
+          buffer[bytes_packed++] = (uint8_t)us;
+        } else if ((img->TIFF_type == 'l') || (img->TIFF_type == 'f')) {
+          uint32_t ul;
+          if (img->TIFF_type == 'l')
+            ul = img->mono32[current_row][j];
+          else
+            memcpy(&ul, &(img->monof[current_row][j]), 4);
+          buffer[bytes_packed++] = (uint8_t)(ul >> 24);
+          buffer[bytes_packed++] = (uint8_t)(ul >> 16);
+          buffer[bytes_packed++] = (uint8_t)(ul >> 8);
+          buffer[bytes_packed++] = (uint8_t)ul;
+        } else if (img->TIFF_type == 'c') {
           buffer[bytes_packed++] = img->color[0][current_row][j];
           buffer[bytes_packed++] = img->color[1][current_row][j];
           buffer[bytes_packed++] = img->color[2][current_row][j];
@@ -859,6 +955,9 @@ static int32_t MakeImageDataLocInfo(struct TIFF_img *img,
   DataLoc->strip_offsets =
       (uint32_t *)mget_spc((int32_t)DataLoc->StripsPerImage, sizeof(uint32_t));
 
+  /* set by WriteStrip; PrepareHeader rejects it if no strip is written */
+  DataLoc->offset_of_byte_after_data = 0;
+
   return (NO_ERROR);
 }
 
@@ -914,11 +1013,17 @@ static int32_t DetermineRowsPerStrip(struct TIFF_img *img,
 static int32_t DetermineBytesPerRow(struct TIFF_img *img,
                                     struct DataLocation *DataLoc) {
   /* grayscale image data:  1 byte per pixel     */
+  /* 16-bit grayscale data:  2 bytes per pixel   */
+  /* 32-bit grayscale data:  4 bytes per pixel   */
   /* palette-color image data:  1 byte per pixel */
   /* full-color image data:  3 bytes per pixel   */
 
   if ((img->TIFF_type == 'g') || (img->TIFF_type == 'p')) {
     DataLoc->bytes_per_row = (uint32_t)(img->width);
+  } else if (img->TIFF_type == 'w') {
+    DataLoc->bytes_per_row = (uint32_t)(2 * img->width);
+  } else if ((img->TIFF_type == 'l') || (img->TIFF_type == 'f')) {
+    DataLoc->bytes_per_row = (uint32_t)(4 * img->width);
   } else if (img->TIFF_type == 'c') {
     DataLoc->bytes_per_row = (uint32_t)(3 * img->width);
   } else {
@@ -994,7 +1099,9 @@ static int32_t PrepareIFD(struct TIFF_img *img, struct IFD *ifd,
 
 static int32_t AddSpecialFieldEntries(struct TIFF_img *img, struct IFD *ifd) {
   /* for grayscale image */
-  if (img->TIFF_type == 'g') return (AddGrayscaleFields(ifd, img->TIFF_type));
+  if ((img->TIFF_type == 'g') || (img->TIFF_type == 'w') ||
+      (img->TIFF_type == 'l') || (img->TIFF_type == 'f'))
+    return (AddGrayscaleFields(ifd, img->TIFF_type));
 
   /* for palette-color image */
   if (img->TIFF_type == 'p') return (AddPaletteColorFields(img, ifd));
@@ -1012,6 +1119,29 @@ static int32_t AddGrayscaleFields(struct IFD *ifd, char TIFF_type) {
   /* add MakeBitsPerSample field */
   if (MakeBitsPerSampleField(ifd, TIFF_type) == ERROR) return (ERROR);
 
+  /* add SampleFormat field for wider than 8-bit samples */
+  if (TIFF_type != 'g')
+    if (MakeSampleFormatField(ifd, TIFF_type) == ERROR) return (ERROR);
+
+  return (NO_ERROR);
+}
+
+static int32_t MakeSampleFormatField(struct IFD *ifd, char TIFF_type) {
+  struct TIFF_field *field;
+
+  /* increment NumberOfFields in IFD struct */
+  ifd->NumberOfFields++;
+
+  /* allocate field structure */
+  if (AllocateNewField(ifd) == ERROR) return (ERROR);
+  field = &(ifd->Fields[ifd->NumberOfFields - 1]);
+
+  field->Tag = SampleFormat;
+  field->Type = SHORT;
+  field->Count = 1;
+  field->Value.UShort =
+      (TIFF_type == 'f') ? IEEEFloatingPoint : UnsignedInteger;
+
   return (NO_ERROR);
 }
 
@@ -1143,6 +1273,13 @@ static int32_t MakeBitsPerSampleField(struct IFD *ifd, char TIFF_type) {
     return (NO_ERROR);
   }
 
+  /* if image is 16-bit or 32-bit grayscale */
+  if ((TIFF_type == 'w') || (TIFF_type == 'l') || (TIFF_type == 'f')) {
+    field->Count = 1;
+    field->Value.UShort = (TIFF_type == 'w') ? 16 : 32;
+    return (NO_ERROR);
+  }
+
   /* if image is color */
   if (TIFF_type == 'c') {
     field->Count = 3;
@@ -1330,7 +1467,8 @@ static int32_t MakePhotometricInterpretationField(struct IFD *ifd,
   field->Type = SHORT;
   field->Count = 1;
 
-  if (TIFF_type == 'g')
+  if ((TIFF_type == 'g') || (TIFF_type == 'w') || (TIFF_type == 'l') ||
+      (TIFF_type == 'f'))
     field->Value.UShort = BlackIsZero;
   else if (TIFF_type == 'p')
     field->Value.UShort = PaletteColor;
@@ -1487,6 +1625,7 @@ static uint32_t GetMaxValUL(uint32_t *array, uint32_t n_elements) {
 int32_t read_TIFF(FILE *fp, struct TIFF_img *img) {
   struct IFD ifd;
   struct TIFF_header header;
+  uint32_t OffsetOfNextIFD;
 
   /* ensure that each type will be stored */
   /* in the expected number of bytes      */
@@ -1497,9 +1636,19 @@ int32_t read_TIFF(FILE *fp, struct TIFF_img *img) {
 
   /* read image file directory; also infer the */
   /* "TIFF_type" of the image from the IFD     */
-  if (ReadIFD(fp, &(ifd), &(header), &(img->TIFF_type)) == ERROR)
+  if (ReadIFD(fp, &(ifd), header.OffsetOfFirstIFD, &(img->TIFF_type),
+              &OffsetOfNextIFD) == ERROR)
     return (ERROR);
 
+  /* if this isn't the last IFD, inform */
+  /* user that the others are ignored   */
+  if (OffsetOfNextIFD != 0) {
+    fprintf(stderr, "WARNING:  this TIFF file ");
+    fprintf(stderr, "contains multiple images;\n");
+    fprintf(stderr, "all but the first image will be ");
+    fprintf(stderr, "ignored by read_TIFF\n");
+  }
+
   /* read image data */
   if (GetImageData(fp, img, &(ifd)) == ERROR) return (ERROR);
 
@@ -1509,6 +1658,68 @@ int32_t read_TIFF(FILE *fp, struct TIFF_img *img) {
   return (NO_ERROR);
 }
 
+int32_t open_TIFF_pages(FILE *fp, struct TIFF_pages *pages) {
+  struct TIFF_header header;
+
+  /* ensure that each type will be stored */
+  /* in the expected number of bytes      */
+  if (CheckTypeSizes() == ERROR) return (ERROR);
+
+  /* read header; the first page is at the first IFD */
+  if (ReadHeader(fp, &(header)) == ERROR) return (ERROR);
+
+  pages->fp = fp;
+  pages->byte_order = header.ByteOrder;
+  pages->next_ifd = header.OffsetOfFirstIFD;
+  pages->mark_ifd = 0;
+  pages->steps = 0;
+  pages->span = 1;
+
+  return (NO_ERROR);
+}
+
+int32_t read_TIFF_page(struct TIFF_pages *pages, struct TIFF_img *img) {
+  struct IFD ifd;
+
+  if (pages->next_ifd == 0) {
+    fprintf(stderr, "tiff.c:  function read_TIFF_page:\n");
+    fprintf(stderr, "there are no more pages in the file\n");
+    return (ERROR);
+  }
+
+  /* a chain that comes back to an IFD would be read forever;  */
+  /* Brent's method finds the loop within twice its length by  */
+  /* comparing each offset with one marked at doubling spans   */
+  if (pages->next_ifd == pages->mark_ifd) {
+    fprintf(stderr, "tiff.c:  function read_TIFF_page:\n");
+    fprintf(stderr, "the IFD chain of the file loops\n");
+    return (ERROR);
+  }
+  if (pages->steps == pages->span) {
+    pages->mark_ifd = pages->next_ifd;
+    pages->span *= 2;
+    pages->steps = 0;
+  }
+  pages->steps++;
+
+  /* other files may have been read since the last page */
+  FileByteOrder = pages->byte_order;
+
+  /* read image file directory of the page, */
+  /* and find the IFD of the next page      */
+  if (ReadIFD(pages->fp, &(ifd), pages->next_ifd, &(img->TIFF_type),
+              &(pages->next_ifd)) == ERROR)
+    return (ERROR);
+
+  /* read image data */
+  if (GetImageData(pages->fp, img, &(ifd)) == ERROR) return (ERROR);
+
+  /* free arrays in IFD structure */
+  if (FreeIFD(&(ifd)) == ERROR) return (ERROR);
+
+  return (NO_ERROR);
+}
+
 static int32_t GetImageData(FILE *fp, struct TIFF_img *img, struct IFD *ifd) {
   /* ensure compression scheme is recognized; */
   /* if it is, record compress_type           */
@@ -1630,7 +1841,25 @@ static int32_t UnpackStrip(struct TIFF_img *img, struct DataLocation *DataLoc,
       for (j = 0; j < img->width; j++) {
         if ((img->TIFF_type == 'g') || (img->TIFF_type == 'p'))
           img->mono[current_row][j] = buffer[bytes_unpacked++];
-        else if (img->TIFF_type == 'c') {
+        else if (img->TIFF_type == 'w') {
+          uint16_t us;
+          memcpy(&us, buffer + bytes_unpacked, 2);
+          bytes_unpacked += 2;
+          if (FileByteOrder != HostByteOrder) us = ShortReverse(us);
+          img->mono16[current_row][j] = us;
+        } else if (img->TIFF_type == 'l') {
+          uint32_t ul;
+          memcpy(&ul, buffer + bytes_unpacked, 4);
+          bytes_unpacked += 4;
+          if (FileByteOrder != HostByteOrder) ul = LongReverse(ul);
+          img->mono32[current_row][j] = ul;
+        } else if (img->TIFF_type == 'f') {
+          uint32_t ul;
+          memcpy(&ul, buffer + bytes_unpacked, 4);
+          bytes_unpacked += 4;
+          if (FileByteOrder != HostByteOrder) ul = LongReverse(ul);
+          memcpy(&(img->monof[current_row][j]), &ul, 4);
+        } else if (img->TIFF_type == 'c') {
           img->color[0][current_row][j] = buffer[bytes_unpacked++];
           img->color[1][current_row][j] = buffer[bytes_unpacked++];
           img->color[2][current_row][j] = buffer[bytes_unpacked++];
@@ -1822,6 +2051,26 @@ static int32_t AllocateImageDataArray(struct TIFF_img *img, struct IFD *ifd) {
     return (NO_ERROR);
   }
 
+  /* if image is 16-bit grayscale */
+  if (img->TIFF_type == 'w') {
+    img->mono16 =
+        (uint16_t **)get_img(img->width, img->height, sizeof(uint16_t));
+    return (NO_ERROR);
+  }
+
+  /* if image is 32-bit grayscale */
+  if (img->TIFF_type == 'l') {
+    img->mono32 =
+        (uint32_t **)get_img(img->width, img->height, sizeof(uint32_t));
+    return (NO_ERROR);
+  }
+
+  /* if image is floating-point grayscale */
+  if (img->TIFF_type == 'f') {
+    img->monof = (float **)get_img(img->width, img->height, sizeof(float));
+    return (NO_ERROR);
+  }
+
   /* if image is palette-color */
   if (img->TIFF_type == 'p') {
     /* colormap */
@@ -1954,11 +2203,8 @@ static int32_t VerifyIFD(struct IFD *ifd, char *TIFF_type) {
 }
 
 static int32_t GetImageType(struct IFD *ifd, char *TIFF_type) {
-  /* grayscale */
-  if (IsImageGrayscale(ifd) == YES) {
-    *TIFF_type = 'g';
-    return (NO_ERROR);
-  }
+  /* grayscale; 8-bit, 16-bit, or floating point */
+  if (IsImageGrayscale(ifd) == YES) return (GetGrayscaleType(ifd, TIFF_type));
 
   /* palette-color */
   if (IsImagePaletteColor(ifd) == YES) {
@@ -2087,9 +2333,11 @@ static int32_t IsImageGrayscale(struct IFD *ifd) {
       (field->Value.UShort != Inch) && (field->Value.UShort != Centimeter))
     return (NO);
 
-  /* BitsPerSample must have 4 or 8 as a value */
+  /* BitsPerSample must have 4, 8, 16 or 32 as a value */
   if ((field = GetFieldStructure(ifd, BitsPerSample)) == NULL) return (NO);
-  if ((field->Value.UShort != 4) && (field->Value.UShort != 8)) return (NO);
+  if ((field->Value.UShort != 4) && (field->Value.UShort != 8) &&
+      (field->Value.UShort != 16) && (field->Value.UShort != 32))
+    return (NO);
 
   /* four BitsPerSample not supported */
   if ((field = GetFieldStructure(ifd, BitsPerSample)) == NULL) return (NO);
@@ -2103,6 +2351,41 @@ static int32_t IsImageGrayscale(struct IFD *ifd) {
   return (YES);
 }
 
+static int32_t GetGrayscaleType(struct IFD *ifd, char *TIFF_type) {
+  uint16_t bits_per_sample, sample_format = UnsignedInteger;
+
+  if (GetUShortValueFromField(ifd, BitsPerSample, &bits_per_sample) == ERROR)
+    return (ERROR);
+
+  /* SampleFormat is optional; it defaults to unsigned integer */
+  if (IsThereAFieldFor(ifd, SampleFormat) == YES)
+    if (GetUShortValueFromField(ifd, SampleFormat, &sample_format) == ERROR)
+      return (ERROR);
+
+  if ((bits_per_sample == 8) && (sample_format == UnsignedInteger)) {
+    *TIFF_type = 'g';
+    return (NO_ERROR);
+  }
+  if ((bits_per_sample == 16) && (sample_format == UnsignedInteger)) {
+    *TIFF_type = 'w';
+    return (NO_ERROR);
+  }
+  if ((bits_per_sample == 32) && (sample_format == UnsignedInteger)) {
+    *TIFF_type = 'l';
+    return (NO_ERROR);
+  }
+  if ((bits_per_sample == 32) && (sample_format == IEEEFloatingPoint)) {
+    *TIFF_type = 'f';
+    return (NO_ERROR);
+  }
+
+  fprintf(stderr, "tiff.c:  function GetGrayscaleType:\n");
+  fprintf(stderr, "grayscale image with %d bits per sample ", bits_per_sample);
+  fprintf(stderr, "and sample format %d\n", sample_format);
+  fprintf(stderr, "is not supported by this reader\n");
+  return (ERROR);
+}
+
 static struct TIFF_field *GetFieldStructure(struct IFD *ifd, uint16_t Tag) {
   uint16_t i;
 
@@ -2174,8 +2457,8 @@ static int32_t IsThereAFieldFor(struct IFD *ifd, uint16_t Tag) {
   return (NO);
 }
 
-static int32_t ReadIFD(FILE *fp, struct IFD *ifd, struct TIFF_header *header,
-                       char *TIFF_type) {
+static int32_t ReadIFD(FILE *fp, struct IFD *ifd, uint32_t OffsetOfIFD,
+                       char *TIFF_type, uint32_t *OffsetOfNextIFD) {
   uint16_t i, NumFieldsInInputFile;
 
   /* initialize IFD structure */
@@ -2183,26 +2466,25 @@ static int32_t ReadIFD(FILE *fp, struct IFD *ifd, struct TIFF_header *header,
   ifd->Fields = NULL;
 
   /* get number of fields in IFD of input file */
-  if (GetNumberOfFieldsInInput(fp, header->OffsetOfFirstIFD,
-                               &NumFieldsInInputFile) == ERROR)
+  if (GetNumberOfFieldsInInput(fp, OffsetOfIFD, &NumFieldsInInputFile) ==
+      ERROR)
     return (ERROR);
 
   /* loop through fields in IFD */
   for (i = 0; i < NumFieldsInInputFile; i++) {
     /* set file-position at first byte in field */
-    if (SetFilePositionAtFirstByteOfIthField(fp, header->OffsetOfFirstIFD, i) ==
-        ERROR)
+    if (SetFilePositionAtFirstByteOfIthField(fp, OffsetOfIFD, i) == ERROR)
       return (ERROR);
 
     /* if tag is recognized, copy field into a structure */
     if (CopyFieldIfTagIsRecognized(fp, ifd) == ERROR) return (ERROR);
   }
 
-  /* check to see if this is the last   */
-  /* IFD; if it isn't, inform user that */
-  /* the others will be ignored         */
-  if (SeeIfThereAreOtherIFDs(fp, header->OffsetOfFirstIFD,
-                             NumFieldsInInputFile) == ERROR)
+  /* check to see if this is the last IFD; */
+  /* if it isn't, get the offset of the    */
+  /* next one                              */
+  if (SeeIfThereAreOtherIFDs(fp, OffsetOfIFD, NumFieldsInInputFile,
+                             OffsetOfNextIFD) == ERROR)
     return (ERROR);
 
   /* verify that IFD is complete; fill in for    */
@@ -2214,7 +2496,8 @@ static int32_t ReadIFD(FILE *fp, struct IFD *ifd, struct TIFF_header *header,
 }
 
 static int32_t SeeIfThereAreOtherIFDs(FILE *fp, uint32_t OffsetOfIFD,
-                                      uint16_t NumFieldsInInputFile) {
+                                      uint16_t NumFieldsInInputFile,
+                                      uint32_t *OffsetOfNextIFD) {
   uint32_t PositionValue, ZeroOrOffset;
 
   /* compute offset of first byte after end of last IFD */
@@ -2235,15 +2518,8 @@ static int32_t SeeIfThereAreOtherIFDs(FILE *fp, uint32_t OffsetOfIFD,
   }
 
   /* either this number is zero or   */
-  /* it is an offset to another IFD; */
-  /* if so, warn user that the other */
-  /* IFD(s) will be ignored          */
-  if (ZeroOrOffset != 0) {
-    fprintf(stderr, "WARNING:  this TIFF file ");
-    fprintf(stderr, "contains multiple images;\n");
-    fprintf(stderr, "all but the first image will be ");
-    fprintf(stderr, "ignored by the TIFF reader\n");
-  }
+  /* it is an offset to another IFD  */
+  *OffsetOfNextIFD = ZeroOrOffset;
 
   return (NO_ERROR);
 }
@@ -2375,6 +2651,9 @@ static int32_t IsTypeExpectedWithTag(uint16_t Tag, uint16_t Type) {
   if (Tag == ColorMap)
     if (Type == SHORT) return (YES);
 
+  if (Tag == SampleFormat)
+    if (Type == SHORT) return (YES);
+
   WrongValueType("IsTypeExpectedWithTag", Tag, Type);
   fprintf(stderr, "field will be ignored\n");
   return (NO);
@@ -2598,6 +2877,7 @@ static int32_t IsTagRecognized(uint16_t TempTag) {
   if (TempTag == YResolution) return (YES);
   if (TempTag == ResolutionUnit) return (YES);
   if (TempTag == ColorMap) return (YES);
+  if (TempTag == SampleFormat) return (YES);
 
   return (NO);
 }
@@ -13,6 +13,9 @@ struct TIFF_img {
   int32_t height;
   int32_t width;
   char TIFF_type; /* 'g' = grayscale;               */
+                  /* 'w' = 16-bit grayscale;        */
+                  /* 'l' = 32-bit grayscale;        */
+                  /* 'f' = 32-bit float grayscale;  */
                   /* 'p' = palette-color;           */
                   /* 'c' = RGB full color           */
 
@@ -20,6 +23,16 @@ struct TIFF_img {
                   /* into color-map; indexed as     */
                   /* mono[row][col]                 */
 
+  uint16_t **mono16; /* 16-bit grayscale data ('w');   */
+                     /* indexed as mono16[row][col]    */
+
+  uint32_t **mono32; /* 32-bit grayscale data ('l');   */
+                     /* indexed as mono32[row][col]    */
+
+  float **monof; /* 32-bit IEEE float grayscale    */
+                 /* data ('f'); indexed as         */
+                 /* monof[row][col]                */
+
   uint8_t ***color; /* full-color RGB data; indexed   */
                     /* as color[plane][row][col],     */
                     /* with planes 0, 1, 2 being red, */
@@ -33,14 +46,39 @@ struct TIFF_img {
                   /* height=256 and width=3         */
 };
 
+/* Cursor over the pages (IFDs) of a multi-page TIFF file */
+struct TIFF_pages {
+  FILE *fp;
+  uint16_t byte_order; /* byte order of the file        */
+  uint32_t next_ifd;   /* offset of the IFD of the next */
+                       /* page; 0 after the last page   */
+  uint32_t mark_ifd;   /* loop check: an IFD offset     */
+  uint32_t steps;      /* seen steps ago, up to a span  */
+  uint32_t span;       /* that doubles                  */
+};
+
 /* For the following routines: 1 = error reading file; 0 = success  */
 
 /* This routine allocates space and reads TIFF image */
 int32_t read_TIFF(FILE *fp, struct TIFF_img *img);
 
+/* This routine reads the header of a multi-page TIFF file */
+int32_t open_TIFF_pages(FILE *fp, struct TIFF_pages *pages);
+
+/* This routine allocates space and reads the next page;    */
+/* pages->next_ifd is 0 once the last page has been read.   */
+/* A chain of IFDs that loops back is an error.             */
+int32_t read_TIFF_page(struct TIFF_pages *pages, struct TIFF_img *img);
+
 /* This routine writes out a valid TIFF image */
 int32_t write_TIFF(FILE *fp, struct TIFF_img *img);
 
+/* This routine writes 32-bit unsigned data as a grayscale  */
+/* image with 8, 16 or 32 bits per sample, narrowing every   */
+/* value as it is written; the values must fit in that width */
+int32_t write_TIFF_u32(FILE *fp, uint32_t **data, int32_t height,
+                       int32_t width, int32_t bits_per_sample);
+
 /* This routine allocates a TIFF image.     */
 /* height, width, TIFF_type must be defined */
 int32_t get_TIFF(struct TIFF_img *img, int32_t height, int32_t width,
@@ -0,0 +1,65 @@
+#ifndef _UNIONFIND_H_
+#define _UNIONFIND_H_
+
+#include "typeutil.h"
+
+/* Union-find over an array of parents, where parent[x] == x marks a root.
+ * Union links the larger root to the smaller one (link-by-index), so the
+ * root of every set is its smallest element.
+ *
+ * The uf_*_atomic variants may be called concurrently by several threads
+ * on the same array: links are made with compare-and-swap and find uses
+ * path halving with relaxed atomic loads and stores. */
+
+static inline uint32_t uf_find(uint32_t *parent, uint32_t x) {
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]]; /* path halving */
+    x = parent[x];
+  }
+  return x;
+}
+
+static inline uint32_t uf_union(uint32_t *parent, uint32_t a, uint32_t b) {
+  a = uf_find(parent, a);
+  b = uf_find(parent, b);
+  if (a < b) {
+    parent[b] = a;
+    return a;
+  }
+  parent[a] = b;
+  return b;
+}
+
+static inline uint32_t uf_find_atomic(uint32_t *parent, uint32_t x) {
+  uint32_t p, gp;
+
+  for (;;) {
+    p = __atomic_load_n(&parent[x], __ATOMIC_RELAXED);
+    if (p == x) return x;
+    gp = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+    if (gp != p) __atomic_compare_exchange_n(&parent[x], &p, gp, 0,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    x = gp;
+  }
+}
+
+static inline void uf_union_atomic(uint32_t *parent, uint32_t a, uint32_t b) {
+  uint32_t t;
+
+  for (;;) {
+    a = uf_find_atomic(parent, a);
+    b = uf_find_atomic(parent, b);
+    if (a == b) return;
+    if (a < b) { /* link the larger root below the smaller one */
+      t = a;
+      a = b;
+      b = t;
+    }
+    t = a;
+    if (__atomic_compare_exchange_n(&parent[a], &t, b, 0, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED))
+      return;
+  }
+}
+
+#endif /* _UNIONFIND_H_ */
@@ -0,0 +1,150 @@
+#include "volumelabel.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocate.h"
+#include "neighborhood.h"
+#include "unionfind.h"
+
+#define NONE 0xffffffffu
+
+static uint32_t NewLabel(struct volume_stream *vs) {
+  uint32_t l = vs->nlabels++;
+
+  if (l == vs->cap) {
+    vs->cap = vs->cap ? 2 * vs->cap : 1024;
+    vs->parent = (uint32_t *)realloc(vs->parent, vs->cap * sizeof(uint32_t));
+    vs->size = (unsigned long *)realloc(vs->size,
+                                        vs->cap * sizeof(unsigned long));
+    if (vs->parent == NULL || vs->size == NULL) {
+      fprintf(stderr, "NewLabel(): realloc() error\n");
+      exit(-1);
+    }
+  }
+  vs->parent[l] = l;
+  vs->size[l] = 0;
+  return l;
+}
+
+/* Gives the voxel with label *l the label of a neighbor, or merges the
+ * two labels if it already has one */
+static inline void Join(struct volume_stream *vs, uint32_t *l, uint32_t n) {
+  if (*l == NONE)
+    *l = n;
+  else if (*l != n)
+    uf_union(vs->parent, *l, n);
+}
+
+/* Appends the labels of the current slice to the spill file, which then
+ * become the labels of the previous slice */
+static void SpillSlice(struct volume_stream *vs) {
+  size_t n = (size_t)vs->width * vs->height;
+  uint32_t *t = vs->prev_lab;
+
+  fwrite(vs->cur_lab, sizeof(uint32_t), n, vs->spill);
+  vs->prev_lab = vs->cur_lab;
+  vs->cur_lab = t;
+  vs->nslices++;
+}
+
+#define PIXEL_T unsigned char
+#define PIXEL_DIFF(a, b) abs((int)(a) - (int)(b))
+#define PIXEL_NAME(f) f
+#include "volumelabel.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+#define PIXEL_T uint16_t
+#define PIXEL_DIFF(a, b) abs((int)(a) - (int)(b))
+#define PIXEL_NAME(f) f##_u16
+#include "volumelabel.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+#define PIXEL_T float
+#define PIXEL_DIFF(a, b) fabs((double)(a) - (double)(b))
+#define PIXEL_NAME(f) f##_f32
+#include "volumelabel.inc"
+#undef PIXEL_T
+#undef PIXEL_DIFF
+#undef PIXEL_NAME
+
+int VolumeStreamInit(struct volume_stream *vs, int width, int height,
+                     double threshold, int connectivity) {
+  memset(vs, 0, sizeof(*vs));
+  if (connectivity != VOL_6 && connectivity != VOL_18 &&
+      connectivity != VOL_26) {
+    fprintf(stderr, "VolumeStreamInit(): connectivity must be 6, 18 or 26\n");
+    return -1;
+  }
+  if ((vs->spill = tmpfile()) == NULL) {
+    fprintf(stderr, "VolumeStreamInit(): cannot create a temporary file\n");
+    return -1;
+  }
+  vs->width = width;
+  vs->height = height;
+  vs->threshold = threshold;
+  vs->connectivity = connectivity;
+  vs->prev_lab = (uint32_t *)mget_spc((long)width * height, sizeof(uint32_t));
+  vs->cur_lab = (uint32_t *)mget_spc((long)width * height, sizeof(uint32_t));
+  return 0;
+}
+
+int VolumeStreamFinish(struct volume_stream *vs, unsigned long min_size,
+                       unsigned int *nlabels) {
+  uint32_t l, r, n = 0;
+
+  if (fflush(vs->spill) != 0 || ferror(vs->spill)) {
+    fprintf(stderr, "VolumeStreamFinish(): error writing temporary file\n");
+    return -1;
+  }
+
+  // roots are the smallest provisional label of their set, which is the
+  // label of its first voxel, so numbering them in order gives the final
+  // labels in raster order of first appearance
+  for (l = 0; l < vs->nlabels; l++) {
+    r = uf_find(vs->parent, l);
+    if (r != l) vs->size[r] += vs->size[l];
+  }
+  vs->final = (uint32_t *)mget_spc(vs->nlabels ? vs->nlabels : 1,
+                                   sizeof(uint32_t));
+  for (l = 0; l < vs->nlabels; l++) {
+    r = uf_find(vs->parent, l);
+    if (r == l)
+      vs->final[l] = (vs->size[l] > min_size) ? ++n : 0;
+    else
+      vs->final[l] = vs->final[r];
+  }
+
+  rewind(vs->spill);
+  vs->nread = 0;
+  *nlabels = n;
+  return 0;
+}
+
+int VolumeStreamLabels(struct volume_stream *vs, unsigned int **labels) {
+  size_t n = (size_t)vs->width * vs->height, k;
+  unsigned int *out = labels[0];
+
+  if (vs->nread == vs->nslices) return -1;
+  if (fread(out, sizeof(uint32_t), n, vs->spill) != n) {
+    fprintf(stderr, "VolumeStreamLabels(): error reading temporary file\n");
+    return -1;
+  }
+  for (k = 0; k < n; k++) out[k] = vs->final[out[k]];
+  vs->nread++;
+  return 0;
+}
+
+void VolumeStreamFree(struct volume_stream *vs) {
+  if (vs->spill != NULL) fclose(vs->spill);
+  free(vs->prev_lab);
+  free(vs->cur_lab);
+  free(vs->parent);
+  free(vs->size);
+  free(vs->final);
+}
@@ -0,0 +1,64 @@
+#ifndef _VOLUMELABEL_H_
+#define _VOLUMELABEL_H_
+
+#include <stdio.h>
+
+#include "typeutil.h"
+
+/* 3-D labeling of a volume that is fed one slice at a time.
+ *
+ * The first pass gives every voxel a provisional label: the label of a
+ * backward neighbor within the threshold in the current or the previous
+ * slice, or a new one, and records the labels that meet in a union-find.
+ * Only the provisional labels of the current and the previous slice are
+ * kept in memory; every finished slice is spilled to a temporary file.
+ * VolumeStreamFinish resolves the union-find, and the second pass reads
+ * the slices back with their final labels, numbered 1, 2, ... in raster
+ * order (slice, row, column) of first appearance for the sets with more
+ * than min_size voxels; all other voxels get label 0.  A single slice is
+ * labeled exactly like GetAllConnectedSets with 4 or 8 neighbors.
+ *
+ * Besides two slices, memory holds one union-find entry per provisional
+ * label, which is far fewer than the voxels of the volume. */
+
+/* connectivity: voxels sharing a face, also an edge, also a corner */
+#define VOL_6 6
+#define VOL_18 18
+#define VOL_26 26
+
+struct volume_stream {
+  int width, height;
+  double threshold;
+  int connectivity;
+  int nslices, nread;            /* slices fed, slices read back        */
+  uint32_t *prev_lab, *cur_lab;  /* provisional labels of two slices    */
+  uint32_t *parent;              /* union-find over provisional labels  */
+  unsigned long *size;           /* voxels per provisional label        */
+  uint32_t nlabels, cap;         /* provisional labels, allocated       */
+  uint32_t *final;               /* final label of each provisional one */
+  FILE *spill;                   /* provisional labels of every slice   */
+};
+
+int VolumeStreamInit(struct volume_stream *vs, int width, int height,
+                     double threshold, int connectivity);
+
+/* Adds slice cur of the volume; prev is the slice fed before it, or NULL
+ * for the first slice.  There is one function per pixel type. */
+void VolumeStreamSlice(struct volume_stream *vs, unsigned char **prev,
+                       unsigned char **cur);
+void VolumeStreamSlice_u16(struct volume_stream *vs, uint16_t **prev,
+                           uint16_t **cur);
+void VolumeStreamSlice_f32(struct volume_stream *vs, float **prev,
+                           float **cur);
+
+/* Ends the first pass and returns the number of final labels */
+int VolumeStreamFinish(struct volume_stream *vs, unsigned long min_size,
+                       unsigned int *nlabels);
+
+/* Reads the final labels of the next slice into labels, a height x width
+ * array allocated with get_img().  Returns 0 on success. */
+int VolumeStreamLabels(struct volume_stream *vs, unsigned int **labels);
+
+void VolumeStreamFree(struct volume_stream *vs);
+
+#endif /* _VOLUMELABEL_H_ */
@@ -0,0 +1,85 @@
+#include "zlayout.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ZL_TILE_PIXELS (ZL_TILE * ZL_TILE)
+
+void zl_init(struct zlayout *zl, int width, int height) {
+  zl->width = width;
+  zl->height = height;
+  zl->tiles_x = (width + ZL_TILE - 1) / ZL_TILE;
+  zl->tiles_y = (height + ZL_TILE - 1) / ZL_TILE;
+  zl->size = (size_t)zl->tiles_x * zl->tiles_y * ZL_TILE_PIXELS;
+}
+
+/* Morton offset of every (row, col) of a tile */
+static void TileOffsets(uint16_t offset[ZL_TILE_PIXELS]) {
+  for (uint32_t k = 0; k < ZL_TILE_PIXELS; k++)
+    offset[k] = (uint16_t)zl_morton(k % ZL_TILE, k / ZL_TILE);
+}
+
+/* Both directions walk the rows of a tile through the offsets of the
+ * table, reading or writing ZL_TILE row segments and one tile that stays
+ * in L1.  The extent of a tile is computed once; it is a full ZL_TILE x
+ * ZL_TILE for all tiles but those of the last tile row and column, so the
+ * inner loop of an interior tile has a constant trip count. */
+#define ZL_CONVERT(NAME_FROM, NAME_TO, ROW_T, Z_T)                          \
+  void NAME_FROM(const struct zlayout *zl, ROW_T **rows, Z_T *z) {          \
+    uint16_t offset[ZL_TILE_PIXELS];                                        \
+    TileOffsets(offset);                                                    \
+    for (int ty = 0; ty < zl->tiles_y; ty++) {                              \
+      int y0 = ty * ZL_TILE;                                                \
+      int ny = (zl->height - y0 < ZL_TILE) ? zl->height - y0 : ZL_TILE;     \
+      for (int tx = 0; tx < zl->tiles_x; tx++) {                            \
+        Z_T *tile = z + ((size_t)ty * zl->tiles_x + tx) * ZL_TILE_PIXELS;   \
+        int x0 = tx * ZL_TILE;                                              \
+        int nx = (zl->width - x0 < ZL_TILE) ? zl->width - x0 : ZL_TILE;     \
+        if (nx == ZL_TILE && ny == ZL_TILE) {                               \
+          for (int ly = 0; ly < ZL_TILE; ly++) {                            \
+            const ROW_T *src = rows[y0 + ly] + x0;                          \
+            const uint16_t *off = offset + ly * ZL_TILE;                    \
+            for (int lx = 0; lx < ZL_TILE; lx++) tile[off[lx]] = src[lx];   \
+          }                                                                 \
+          continue;                                                         \
+        }                                                                   \
+        memset(tile, 0, ZL_TILE_PIXELS * sizeof(Z_T));                      \
+        for (int ly = 0; ly < ny; ly++) {                                   \
+          const ROW_T *src = rows[y0 + ly] + x0;                            \
+          const uint16_t *off = offset + ly * ZL_TILE;                      \
+          for (int lx = 0; lx < nx; lx++) tile[off[lx]] = src[lx];          \
+        }                                                                   \
+      }                                                                     \
+    }                                                                       \
+  }                                                                         \
+                                                                            \
+  void NAME_TO(const struct zlayout *zl, const Z_T *z, ROW_T **rows) {      \
+    uint16_t offset[ZL_TILE_PIXELS];                                        \
+    TileOffsets(offset);                                                    \
+    for (int ty = 0; ty < zl->tiles_y; ty++) {                              \
+      int y0 = ty * ZL_TILE;                                                \
+      int ny = (zl->height - y0 < ZL_TILE) ? zl->height - y0 : ZL_TILE;     \
+      for (int tx = 0; tx < zl->tiles_x; tx++) {                            \
+        const Z_T *tile =                                                   \
+            z + ((size_t)ty * zl->tiles_x + tx) * ZL_TILE_PIXELS;           \
+        int x0 = tx * ZL_TILE;                                              \
+        int nx = (zl->width - x0 < ZL_TILE) ? zl->width - x0 : ZL_TILE;     \
+        if (nx == ZL_TILE && ny == ZL_TILE) {                               \
+          for (int ly = 0; ly < ZL_TILE; ly++) {                            \
+            ROW_T *dst = rows[y0 + ly] + x0;                                \
+            const uint16_t *off = offset + ly * ZL_TILE;                    \
+            for (int lx = 0; lx < ZL_TILE; lx++) dst[lx] = tile[off[lx]];   \
+          }                                                                 \
+          continue;                                                         \
+        }                                                                   \
+        for (int ly = 0; ly < ny; ly++) {                                   \
+          ROW_T *dst = rows[y0 + ly] + x0;                                  \
+          const uint16_t *off = offset + ly * ZL_TILE;                      \
+          for (int lx = 0; lx < nx; lx++) dst[lx] = tile[off[lx]];          \
+        }                                                                   \
+      }                                                                     \
+    }                                                                       \
+  }
+
+ZL_CONVERT(zl_from_rows_u8, zl_to_rows_u8, unsigned char, uint8_t)
+ZL_CONVERT(zl_from_rows_u32, zl_to_rows_u32, unsigned int, uint32_t)
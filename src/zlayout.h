@@ -0,0 +1,131 @@
+#ifndef _ZLAYOUT_H_
+#define _ZLAYOUT_H_
+
+#include <stddef.h>
+
+#include "typeutil.h"
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+/* Tiled Z-order image layout.
+ *
+ * The image is cut into ZL_TILE x ZL_TILE tiles that are stored one after
+ * the other in row-major tile order, and the pixels of every tile are
+ * stored in Morton (Z) order.  All four neighbors of a pixel inside a tile
+ * are then within ZL_TILE * ZL_TILE elements of it instead of one being a
+ * full row away.  The last tile row and column are padded; padding is
+ * never read as a pixel.
+ *
+ * No labeling engine uses the layout.  A flood fill and union-find
+ * labeling run on it were measured slower than on row-major images of the
+ * same size (0.57x and 0.64x at 4096 x 4096), apart from some fills of
+ * images far larger than the last-level cache.  The conversion kernels,
+ * timed by LayoutBenchmark, and the neighbor steps are kept for callers
+ * whose access pattern does favor the layout.
+ *
+ * Buffers in this layout are flat arrays of zl->size elements.  Morton
+ * codes use pdep/pext when the compiler targets BMI2 (-mbmi2 or
+ * -march=native) and bit interleaving otherwise. */
+
+#define ZL_TILE_LOG2 4
+#define ZL_TILE (1 << ZL_TILE_LOG2)
+
+struct zlayout {
+  int width, height;
+  int tiles_x, tiles_y;
+  size_t size; /* elements including padding */
+};
+
+void zl_init(struct zlayout *zl, int width, int height);
+
+/* Interleaves the low 16 bits of x (even bits) and y (odd bits) */
+static inline uint32_t zl_morton(uint32_t x, uint32_t y) {
+#ifdef __BMI2__
+  return _pdep_u32(x, 0x55555555u) | _pdep_u32(y, 0xaaaaaaaau);
+#else
+  x &= 0xffff;
+  y &= 0xffff;
+  x = (x | (x << 8)) & 0x00ff00ffu;
+  x = (x | (x << 4)) & 0x0f0f0f0fu;
+  x = (x | (x << 2)) & 0x33333333u;
+  x = (x | (x << 1)) & 0x55555555u;
+  y = (y | (y << 8)) & 0x00ff00ffu;
+  y = (y | (y << 4)) & 0x0f0f0f0fu;
+  y = (y | (y << 2)) & 0x33333333u;
+  y = (y | (y << 1)) & 0x55555555u;
+  return x | (y << 1);
+#endif
+}
+
+static inline void zl_unmorton(uint32_t m, uint32_t *x, uint32_t *y) {
+#ifdef __BMI2__
+  *x = _pext_u32(m, 0x55555555u);
+  *y = _pext_u32(m, 0xaaaaaaaau);
+#else
+  uint32_t v[2] = {m & 0x55555555u, (m >> 1) & 0x55555555u};
+  for (int k = 0; k < 2; k++) {
+    v[k] = (v[k] | (v[k] >> 1)) & 0x33333333u;
+    v[k] = (v[k] | (v[k] >> 2)) & 0x0f0f0f0fu;
+    v[k] = (v[k] | (v[k] >> 4)) & 0x00ff00ffu;
+    v[k] = (v[k] | (v[k] >> 8)) & 0x0000ffffu;
+  }
+  *x = v[0];
+  *y = v[1];
+#endif
+}
+
+/* Position of pixel (col x, row y) in a buffer with layout zl */
+static inline size_t zl_index(const struct zlayout *zl, int x, int y) {
+  size_t tile = (size_t)(y >> ZL_TILE_LOG2) * zl->tiles_x +
+                (x >> ZL_TILE_LOG2);
+  return (tile << (2 * ZL_TILE_LOG2)) |
+         zl_morton(x & (ZL_TILE - 1), y & (ZL_TILE - 1));
+}
+
+/* Neighbors of pixel (x, y) at index j.  Inside a tile the step is done
+ * on the Morton code with dilated integer arithmetic; only steps across a
+ * tile border recompute the index.  The neighbor must be in the image. */
+#define ZL_XBITS (0x55555555u & (ZL_TILE * ZL_TILE - 1))
+#define ZL_YBITS (0xaaaaaaaau & (ZL_TILE * ZL_TILE - 1))
+
+static inline size_t zl_left(const struct zlayout *zl, size_t j, int x,
+                             int y) {
+  uint32_t m = j & (ZL_XBITS | ZL_YBITS);
+  if ((x & (ZL_TILE - 1)) == 0) return zl_index(zl, x - 1, y);
+  return (j - m) | (((m & ZL_XBITS) - 1) & ZL_XBITS) | (m & ZL_YBITS);
+}
+
+static inline size_t zl_right(const struct zlayout *zl, size_t j, int x,
+                              int y) {
+  uint32_t m = j & (ZL_XBITS | ZL_YBITS);
+  if ((x & (ZL_TILE - 1)) == ZL_TILE - 1) return zl_index(zl, x + 1, y);
+  return (j - m) | (((m | ZL_YBITS) + 1) & ZL_XBITS) | (m & ZL_YBITS);
+}
+
+static inline size_t zl_up(const struct zlayout *zl, size_t j, int x, int y) {
+  uint32_t m = j & (ZL_XBITS | ZL_YBITS);
+  if ((y & (ZL_TILE - 1)) == 0) return zl_index(zl, x, y - 1);
+  return (j - m) | (((m & ZL_YBITS) - 1) & ZL_YBITS) | (m & ZL_XBITS);
+}
+
+static inline size_t zl_down(const struct zlayout *zl, size_t j, int x,
+                             int y) {
+  uint32_t m = j & (ZL_XBITS | ZL_YBITS);
+  if ((y & (ZL_TILE - 1)) == ZL_TILE - 1) return zl_index(zl, x, y + 1);
+  return (j - m) | (((m | ZL_XBITS) + 1) & ZL_YBITS) | (m & ZL_XBITS);
+}
+
+/* Conversion kernels between height x width get_img() arrays and flat
+ * buffers of zl->size elements.  Padding is set to 0. */
+void zl_from_rows_u8(const struct zlayout *zl, unsigned char **rows,
+                     uint8_t *z);
+void zl_to_rows_u8(const struct zlayout *zl, const uint8_t *z,
+                   unsigned char **rows);
+void zl_from_rows_u32(const struct zlayout *zl, unsigned int **rows,
+                      uint32_t *z);
+void zl_to_rows_u32(const struct zlayout *zl, const uint32_t *z,
+                    unsigned int **rows);
+
+#endif /* _ZLAYOUT_H_ */